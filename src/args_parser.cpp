@@ -1,4 +1,7 @@
 #include "vanitas/args_parser.hpp"
+#include <cctype>
+#include <csignal>
+#include <cstdint>
 #include <stdexcept>
 
 namespace vanitas {
@@ -13,6 +16,288 @@ static void parse_profile_opt(int &i, int argc, char *const *argv, Args &out)
     i += 1;
 }
 
+static std::vector<std::string> split_list(const std::string &s)
+{
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (pos <= s.size()) {
+        size_t comma = s.find(',', pos);
+        if (comma == std::string::npos)
+            comma = s.size();
+        if (comma > pos)
+            out.push_back(s.substr(pos, comma - pos));
+        pos = comma + 1;
+    }
+    return out;
+}
+
+// std::stoull takes "-1" as 2^64 - 1, so only digits are accepted.
+static size_t parse_size_opt(int &i, int argc, char *const *argv, const std::string &flag,
+                             size_t max = SIZE_MAX)
+{
+    if (i + 1 >= argc)
+        throw std::runtime_error("Usage: " + flag + " <N>");
+
+    const std::string v = argv[i + 1];
+    size_t used = 0;
+    unsigned long long n = 0;
+    try {
+        if (!v.empty() && std::isdigit((unsigned char)v[0]))
+            n = std::stoull(v, &used);
+    } catch (...) {
+        used = 0;
+    }
+    if (used == 0 || used != v.size())
+        throw std::runtime_error("Invalid number for " + flag + ": '" + v + "'");
+    if (n > max)
+        throw std::runtime_error("Usage: " + flag + " <N> (N <= " + std::to_string(max) + ")");
+
+    i += 1;
+    return (size_t)n;
+}
+
+// 4096, 64K, 512M, 2G
+static uint64_t parse_bytes(const std::string &v, const std::string &flag)
+{
+    size_t used = 0;
+    unsigned long long n = 0;
+    try {
+        if (!v.empty() && std::isdigit((unsigned char)v[0]))
+            n = std::stoull(v, &used);
+    } catch (...) {
+        used = 0;
+    }
+    if (used == 0)
+        throw std::runtime_error("Invalid size for " + flag + ": '" + v + "'");
+
+    const std::string unit = v.substr(used);
+    int shift = 0;
+    if (unit == "K" || unit == "k")
+        shift = 10;
+    else if (unit == "M" || unit == "m")
+        shift = 20;
+    else if (unit == "G" || unit == "g")
+        shift = 30;
+    else if (!unit.empty())
+        throw std::runtime_error("Invalid size for " + flag + ": '" + v + "'");
+    if (n > (UINT64_MAX >> shift))
+        throw std::runtime_error("Size too large for " + flag + ": '" + v + "'");
+    return n << shift;
+}
+
+// START:END, START: or :END
+static std::pair<uint64_t, uint64_t> parse_range(const std::string &v)
+{
+    const size_t colon = v.find(':');
+    if (colon == std::string::npos)
+        throw std::runtime_error("Usage: --range START:END (bytes, K/M/G suffixes; either side may be empty)");
+    const std::string a = v.substr(0, colon);
+    const std::string b = v.substr(colon + 1);
+    const uint64_t begin = a.empty() ? 0 : parse_bytes(a, "--range");
+    const uint64_t end = b.empty() ? UINT64_MAX : parse_bytes(b, "--range");
+    if (end < begin)
+        throw std::runtime_error("Invalid --range: END is before START");
+    return {begin, end};
+}
+
+// Options shared by the analyzing commands (file, pipe, run).
+static bool parse_analysis_opt(int &i, int argc, char *const *argv, Args &out)
+{
+    std::string a = argv[i];
+
+    if (a == "--only") {
+        if (i + 1 >= argc)
+            throw std::runtime_error("Usage: --only <error,warn,tests,info>");
+        out.only = split_list(argv[i + 1]);
+        i += 1;
+        return true;
+    }
+    if (a == "--min-severity") {
+        if (i + 1 >= argc)
+            throw std::runtime_error("Usage: --min-severity <error|warn|tests|info>");
+        out.min_severity = std::string(argv[i + 1]);
+        i += 1;
+        return true;
+    }
+    if (a == "--count") {
+        out.count = true;
+        return true;
+    }
+    if (a == "-B") {
+        out.context_before = parse_size_opt(i, argc, argv, a, max_context);
+        return true;
+    }
+    if (a == "-A") {
+        out.context_after = parse_size_opt(i, argc, argv, a, max_context);
+        return true;
+    }
+    if (a == "-C") {
+        out.context_before = out.context_after = parse_size_opt(i, argc, argv, a, max_context);
+        return true;
+    }
+    if (a == "--context-lines") {
+        out.context_lines = true;
+        return true;
+    }
+    if (a == "--format") {
+        if (i + 1 >= argc)
+            throw std::runtime_error("Usage: --format <text|json|quickfix>");
+        out.format = std::string(argv[i + 1]);
+        i += 1;
+        return true;
+    }
+    if (a == "-n" || a == "--line-number") {
+        out.line_numbers = true;
+        return true;
+    }
+    if (a == "--watch") {
+        out.watch = true;
+        return true;
+    }
+    if (a == "--encoding") {
+        if (i + 1 >= argc)
+            throw std::runtime_error("Usage: --encoding <auto|utf-8|utf-16le|utf-16be|latin1>");
+        out.encoding = parse_encoding(argv[i + 1]);
+        i += 1;
+        return true;
+    }
+    return false;
+}
+
+// --baseline / --save-baseline (file, pipe, run).
+static bool parse_baseline_opt(int &i, int argc, char *const *argv, Args &out)
+{
+    std::string a = argv[i];
+    if (a != "--baseline" && a != "--save-baseline")
+        return false;
+    if (i + 1 >= argc)
+        throw std::runtime_error("Usage: " + a + " <file.vfp>");
+    (a == "--baseline" ? out.baseline : out.save_baseline) = std::string(argv[++i]);
+    return true;
+}
+
+static int parse_signal(const std::string &v)
+{
+    static const std::pair<const char *, int> names[] = {{"HUP", SIGHUP}, {"INT", SIGINT},   {"QUIT", SIGQUIT},
+                                                         {"KILL", SIGKILL}, {"USR1", SIGUSR1}, {"USR2", SIGUSR2},
+                                                         {"TERM", SIGTERM}};
+    const std::string name = v.starts_with("SIG") ? v.substr(3) : v;
+    for (const auto &[n, sig] : names)
+        if (name == n)
+            return sig;
+
+    size_t used = 0;
+    int sig = 0;
+    try {
+        sig = std::stoi(v, &used);
+    } catch (...) {
+        used = 0;
+    }
+    if (used == 0 || used != v.size() || sig <= 0 || sig >= NSIG)
+        throw std::runtime_error("Unknown signal: '" + v + "' (e.g. TERM, INT, KILL or a number)");
+    return sig;
+}
+
+// --fail-fast[=N] / --fail-signal / --exit-on-error (file, pipe, run).
+static bool parse_stop_opt(int &i, int argc, char *const *argv, Args &out)
+{
+    std::string a = argv[i];
+
+    if (a == "--fail-fast") {
+        out.fail_fast = 1;
+        return true;
+    }
+    if (a.starts_with("--fail-fast=")) {
+        const std::string v = a.substr(12);
+        size_t used = 0;
+        try {
+            if (!v.empty() && std::isdigit((unsigned char)v[0]))
+                out.fail_fast = std::stoul(v, &used);
+        } catch (...) {
+            used = 0;
+        }
+        if (used == 0 || used != v.size() || out.fail_fast == 0)
+            throw std::runtime_error("Usage: --fail-fast[=N] (N >= 1 errors)");
+        return true;
+    }
+    if (a == "--fail-signal") {
+        if (i + 1 >= argc)
+            throw std::runtime_error("Usage: --fail-signal <TERM|INT|KILL|...|number>");
+        out.fail_signal = parse_signal(argv[++i]);
+        return true;
+    }
+    if (a == "--exit-on-error") {
+        out.exit_on_error = true;
+        return true;
+    }
+    return false;
+}
+
+// --since / --until / --histogram (file, pipe, run); the values are parsed by the command.
+static bool parse_time_opt(int &i, int argc, char *const *argv, Args &out)
+{
+    std::string a = argv[i];
+    std::optional<std::string> *dst = nullptr;
+    if (a == "--since")
+        dst = &out.since;
+    else if (a == "--until")
+        dst = &out.until;
+    else if (a == "--histogram")
+        dst = &out.histogram;
+    else
+        return false;
+    if (i + 1 >= argc)
+        throw std::runtime_error("Usage: " + a + (a == "--histogram" ? " <interval, e.g. 5m>" : " <time>"));
+    *dst = std::string(argv[++i]);
+    return true;
+}
+
+// --test-summary (file, pipe, run).
+static bool parse_tests_opt(int &i, int, char *const *argv, Args &out)
+{
+    if (std::string(argv[i]) != "--test-summary")
+        return false;
+    out.test_summary = true;
+    return true;
+}
+
+// --shed-after <s>[,<s>,<s>,<s>] (pipe, run).
+static bool parse_shed_opt(int &i, int argc, char *const *argv, Args &out)
+{
+    if (std::string(argv[i]) != "--shed-after")
+        return false;
+    const char *usage = "Usage: --shed-after <seconds>[,<seconds>,<seconds>,<seconds>]";
+    if (i + 1 >= argc)
+        throw std::runtime_error(usage);
+    out.shed_after.clear();
+    for (const auto &v : split_list(argv[++i])) {
+        size_t used = 0;
+        double s = 0;
+        try {
+            s = std::stod(v, &used);
+        } catch (...) {
+            used = 0;
+        }
+        if (used == 0 || used != v.size() || !(s > 0))
+            throw std::runtime_error(usage);
+        out.shed_after.push_back(s);
+    }
+    if (out.shed_after.size() != 1 && out.shed_after.size() != 4)
+        throw std::runtime_error(usage);
+    return true;
+}
+
+// --tee-clean (file, pipe, run, replay).
+static bool parse_tee_opt(int &i, int argc, char *const *argv, Args &out)
+{
+    if (std::string(argv[i]) != "--tee-clean")
+        return false;
+    if (i + 1 >= argc)
+        throw std::runtime_error("Usage: --tee-clean <file>");
+    out.tee_clean = std::string(argv[++i]);
+    return true;
+}
+
 static bool is_global_flag(const std::string &a)
 {
     return a == "--profile" || a == "--dump-config" || a == "--dump-profile" || a == "-h" || a == "--help";
@@ -81,6 +366,18 @@ Args ArgsParser::parse()
         return parse_pipe(i + 1, std::move(out));
     if (cmd == "profile")
         return parse_profile(i + 1, std::move(out));
+    if (cmd == "serve")
+        return parse_serve(i + 1, std::move(out));
+    if (cmd == "client")
+        return parse_client(i + 1, std::move(out));
+    if (cmd == "tui")
+        return parse_tui(i + 1, std::move(out));
+    if (cmd == "replay")
+        return parse_replay(i + 1, std::move(out));
+    if (cmd == "clean")
+        return parse_clean(i + 1, std::move(out));
+    if (cmd == "grep")
+        return parse_grep(i + 1, std::move(out));
     if (cmd == "help") {
         out.mode = Mode::Help;
         return out;
@@ -100,6 +397,10 @@ Args ArgsParser::parse_file(int start, Args out)
             parse_profile_opt(i, argc_, argv_, out);
             continue;
         }
+        if (parse_analysis_opt(i, argc_, argv_, out) || parse_baseline_opt(i, argc_, argv_, out) ||
+            parse_stop_opt(i, argc_, argv_, out) || parse_time_opt(i, argc_, argv_, out) ||
+            parse_tests_opt(i, argc_, argv_, out) || parse_tee_opt(i, argc_, argv_, out))
+            continue;
         if (a == "--dump-config") {
             out.dump_config = true;
             continue;
@@ -108,6 +409,26 @@ Args ArgsParser::parse_file(int start, Args out)
             out.dump_profile = true;
             continue;
         }
+        if (a == "--tail-bytes") {
+            if (i + 1 >= argc_)
+                throw std::runtime_error("Usage: --tail-bytes <size, e.g. 64K>");
+            out.tail_bytes = parse_bytes(argv_[++i], a);
+            if (out.tail_bytes == 0)
+                throw std::runtime_error("Usage: --tail-bytes <size> (size >= 1)");
+            continue;
+        }
+        if (a == "--tail-blocks") {
+            out.tail_blocks = parse_size_opt(i, argc_, argv_, a);
+            if (out.tail_blocks == 0)
+                throw std::runtime_error("Usage: --tail-blocks <N> (N >= 1)");
+            continue;
+        }
+        if (a == "--range") {
+            if (i + 1 >= argc_)
+                throw std::runtime_error("Usage: --range START:END (bytes, K/M/G suffixes; either side may be empty)");
+            out.range = parse_range(argv_[++i]);
+            continue;
+        }
 
         out.file = argv_[i];
         break;
@@ -116,6 +437,8 @@ Args ArgsParser::parse_file(int start, Args out)
     if (out.file.empty()) {
         throw std::runtime_error("Usage: vanitas [global opts] file [opts] <path>");
     }
+    if ((out.tail_bytes > 0) + (out.tail_blocks > 0) + out.range.has_value() + (out.since || out.until) > 1)
+        throw std::runtime_error("Use only one of --tail-bytes, --tail-blocks, --range, --since/--until");
     return out;
 }
 
@@ -129,6 +452,11 @@ Args ArgsParser::parse_pipe(int start, Args out)
             parse_profile_opt(i, argc_, argv_, out);
             continue;
         }
+        if (parse_analysis_opt(i, argc_, argv_, out) || parse_baseline_opt(i, argc_, argv_, out) ||
+            parse_stop_opt(i, argc_, argv_, out) || parse_time_opt(i, argc_, argv_, out) ||
+            parse_tests_opt(i, argc_, argv_, out) || parse_tee_opt(i, argc_, argv_, out) ||
+            parse_shed_opt(i, argc_, argv_, out))
+            continue;
         if (a == "--dump-config") {
             out.dump_config = true;
             continue;
@@ -156,6 +484,11 @@ Args ArgsParser::parse_run(int start, Args out)
             continue;
         }
 
+        if (parse_analysis_opt(i, argc_, argv_, out) || parse_baseline_opt(i, argc_, argv_, out) ||
+            parse_stop_opt(i, argc_, argv_, out) || parse_time_opt(i, argc_, argv_, out) ||
+            parse_tests_opt(i, argc_, argv_, out) || parse_tee_opt(i, argc_, argv_, out) ||
+            parse_shed_opt(i, argc_, argv_, out))
+            continue;
         if (a == "--dump-config") {
             out.dump_config = true;
             continue;
@@ -165,6 +498,27 @@ Args ArgsParser::parse_run(int start, Args out)
             continue;
         }
 
+        if (a == "--record") {
+            if (i + 1 >= argc_)
+                throw std::runtime_error("Usage: --record <file.vrec>");
+            out.record = std::string(argv_[++i]);
+            continue;
+        }
+
+        if (a == "-j" || a == "--jobs") {
+            out.jobs = parse_size_opt(i, argc_, argv_, a);
+            if (out.jobs == 0)
+                throw std::runtime_error("Usage: " + a + " <N> (N >= 1 commands at once)");
+            continue;
+        }
+
+        if (a == "--job-file") {
+            if (i + 1 >= argc_)
+                throw std::runtime_error("Usage: --job-file <path> (one shell command per line, - for stdin)");
+            out.job_file = std::string(argv_[++i]);
+            continue;
+        }
+
         if (a == "--") {
             ++i;
             break;
@@ -173,6 +527,31 @@ Args ArgsParser::parse_run(int start, Args out)
         throw std::runtime_error("Usage: vanitas run [--profile <name>] -- <cmd> [args...]");
     }
 
+    if (out.jobs) {
+        // every further `--` starts the next command
+        std::vector<std::string> cmd;
+        for (; i <= argc_; ++i) {
+            if (i == argc_ || std::string(argv_[i]) == "--") {
+                if (!cmd.empty())
+                    out.job_cmds.push_back(std::move(cmd));
+                cmd.clear();
+                continue;
+            }
+            cmd.push_back(argv_[i]);
+        }
+
+        if (out.job_cmds.empty() && !out.job_file)
+            throw std::runtime_error(
+                "Usage: vanitas run -j <N> [opts] [--job-file <path>] [-- <cmd> [args...]] [-- <cmd> ...]");
+        if (out.record || out.baseline || out.save_baseline || out.since || out.until || out.histogram ||
+            out.test_summary || out.tee_clean || !out.shed_after.empty())
+            throw std::runtime_error("run -j: --record, --baseline, --save-baseline, --since, --until, --histogram, "
+                                     "--test-summary, --tee-clean and --shed-after need a single command");
+        return out;
+    }
+    if (out.job_file)
+        throw std::runtime_error("--job-file needs -j <N>");
+
     for (; i < argc_; ++i) {
         out.cmd.push_back(argv_[i]);
     }
@@ -207,4 +586,201 @@ Args ArgsParser::parse_profile(int start, Args out)
     throw std::runtime_error("Unknown subcommand: profile " + sub + "\nUsage: vanitas profile list");
 }
 
+Args ArgsParser::parse_serve(int start, Args out)
+{
+    out.mode = Mode::Serve;
+
+    for (int i = start; i < argc_; ++i) {
+        std::string a = argv_[i];
+
+        if (a == "--profile") {
+            parse_profile_opt(i, argc_, argv_, out);
+            continue;
+        }
+        if (a == "--socket" && i + 1 < argc_) {
+            out.socket = argv_[++i];
+            continue;
+        }
+        if (a == "--workers") {
+            out.workers = parse_size_opt(i, argc_, argv_, a);
+            continue;
+        }
+        throw std::runtime_error("Usage: vanitas serve [--socket <path>] [--workers <N>] [--profile <name>]");
+    }
+    return out;
+}
+
+Args ArgsParser::parse_client(int start, Args out)
+{
+    out.mode = Mode::Client;
+
+    for (int i = start; i < argc_; ++i) {
+        std::string a = argv_[i];
+
+        if (a == "--profile") {
+            parse_profile_opt(i, argc_, argv_, out);
+            continue;
+        }
+        if (parse_analysis_opt(i, argc_, argv_, out))
+            continue;
+        if (a == "--socket" && i + 1 < argc_) {
+            out.socket = argv_[++i];
+            continue;
+        }
+        if (a == "--bench") {
+            out.bench = parse_size_opt(i, argc_, argv_, a);
+            continue;
+        }
+        if (out.bench > 0 && out.file.empty() && !a.starts_with("-")) {
+            out.file = a;
+            continue;
+        }
+        throw std::runtime_error("Usage: vanitas client [--socket <path>] [opts]\n"
+                                 "       vanitas client [--socket <path>] [opts] --bench <N> <file>");
+    }
+
+    if (out.bench > 0 && out.file.empty())
+        throw std::runtime_error("Usage: vanitas client [--socket <path>] [opts] --bench <N> <file>");
+    return out;
+}
+
+Args ArgsParser::parse_tui(int start, Args out)
+{
+    out.mode = Mode::Tui;
+
+    for (int i = start; i < argc_; ++i) {
+        std::string a = argv_[i];
+
+        if (a == "--profile") {
+            parse_profile_opt(i, argc_, argv_, out);
+            continue;
+        }
+        if (parse_analysis_opt(i, argc_, argv_, out))
+            continue;
+
+        out.file = argv_[i];
+        break;
+    }
+
+    if (out.file.empty())
+        throw std::runtime_error("Usage: vanitas tui [--profile <name>] [--only <types>] <path>");
+    return out;
+}
+
+Args ArgsParser::parse_replay(int start, Args out)
+{
+    out.mode = Mode::Replay;
+
+    for (int i = start; i < argc_; ++i) {
+        std::string a = argv_[i];
+
+        if (a == "--profile") {
+            parse_profile_opt(i, argc_, argv_, out);
+            continue;
+        }
+        if (parse_analysis_opt(i, argc_, argv_, out) || parse_baseline_opt(i, argc_, argv_, out) ||
+            parse_stop_opt(i, argc_, argv_, out) || parse_time_opt(i, argc_, argv_, out) ||
+            parse_tests_opt(i, argc_, argv_, out) || parse_tee_opt(i, argc_, argv_, out))
+            continue;
+        if (a == "--as-fast-as-possible") {
+            out.replay_speed = 0;
+            continue;
+        }
+        if (a == "--speed") {
+            if (i + 1 >= argc_)
+                throw std::runtime_error("Usage: --speed <X> (1 = as recorded, 2 = twice as fast)");
+            const std::string v = argv_[++i];
+            size_t used = 0;
+            try {
+                out.replay_speed = std::stod(v, &used);
+            } catch (...) {
+                used = 0;
+            }
+            if (used == 0 || used != v.size() || !(out.replay_speed > 0))
+                throw std::runtime_error("Invalid --speed: '" + v + "'");
+            continue;
+        }
+
+        out.file = argv_[i];
+        if (i + 1 < argc_)
+            throw std::runtime_error("Usage: vanitas replay [opts] <file.vrec>");
+        break;
+    }
+
+    if (out.file.empty())
+        throw std::runtime_error("Usage: vanitas replay [--speed <X>|--as-fast-as-possible] [opts] <file.vrec>");
+    return out;
+}
+
+Args ArgsParser::parse_clean(int start, Args out)
+{
+    out.mode = Mode::Clean;
+
+    for (int i = start; i < argc_; ++i) {
+        std::string a = argv_[i];
+
+        if (a == "--encoding") {
+            if (i + 1 >= argc_)
+                throw std::runtime_error("Usage: --encoding <auto|utf-8|utf-16le|utf-16be|latin1>");
+            out.encoding = parse_encoding(argv_[++i]);
+            continue;
+        }
+        if (a == "-o" || a == "--output") {
+            if (i + 1 >= argc_)
+                throw std::runtime_error("Usage: " + a + " <file>");
+            out.clean_output = std::string(argv_[++i]);
+            continue;
+        }
+        if (!out.file.empty() || (a.starts_with("-") && a != "-"))
+            throw std::runtime_error("Usage: vanitas clean [--encoding <enc>] [-o <file>] [<path>|-]");
+        out.file = a;
+    }
+    return out;
+}
+
+Args ArgsParser::parse_grep(int start, Args out)
+{
+    out.mode = Mode::Grep;
+
+    for (int i = start; i < argc_; ++i) {
+        std::string a = argv_[i];
+
+        if (a == "--profile") {
+            parse_profile_opt(i, argc_, argv_, out);
+            continue;
+        }
+        if (parse_analysis_opt(i, argc_, argv_, out))
+            continue;
+        if (a == "-i" || a == "--ignore-case") {
+            out.ignore_case = true;
+            continue;
+        }
+        if (a == "--no-index") {
+            out.no_index = true;
+            continue;
+        }
+        if (a == "--reindex") {
+            out.reindex = true;
+            continue;
+        }
+        if (a == "-e" && i + 1 < argc_) {
+            out.pattern = argv_[++i];
+            continue;
+        }
+
+        if (out.pattern.empty()) {
+            out.pattern = a;
+            continue;
+        }
+        out.file = a;
+        if (i + 1 < argc_)
+            throw std::runtime_error("Usage: vanitas grep [opts] <pattern> <path>");
+        break;
+    }
+
+    if (out.pattern.empty() || out.file.empty())
+        throw std::runtime_error("Usage: vanitas grep [-i] [--only <types>] [--no-index|--reindex] <pattern> <path>");
+    return out;
+}
+
 } // namespace vanitas
@@ -0,0 +1,149 @@
+#include "vanitas/baseline.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace vanitas {
+
+static constexpr char vfp_magic[8] = {'V', 'A', 'N', 'F', 'P', '0', '2', '\n'};
+static constexpr size_t vfp_header = 24; // magic, u64 count, u64 item types
+static constexpr unsigned radix_bits = 16;
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static bool is_hex(char c) { return is_digit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'); }
+
+// FNV-1a over the normalized text: a run of digits (with any hex letters and
+// 0x prefix glued to it) hashes as one '0', a run of blanks as one ' '.
+uint64_t fingerprint(const Item &it)
+{
+    uint64_t h = 14695981039346656037ull;
+    auto mix = [&](unsigned char c) {
+        h ^= c;
+        h *= 1099511628211ull;
+    };
+
+    mix((unsigned char)it.type);
+
+    const std::string_view s = it.details.empty() ? it.text : it.details;
+    for (size_t i = 0; i < s.size();) {
+        const char c = s[i];
+        if (is_digit(c)) {
+            while (i < s.size() && (is_hex(s[i]) || s[i] == 'x' || s[i] == 'X'))
+                ++i;
+            mix('0');
+        } else if (c == ' ' || c == '\t') {
+            while (i < s.size() && (s[i] == ' ' || s[i] == '\t'))
+                ++i;
+            mix(' ');
+        } else {
+            mix((unsigned char)c);
+            ++i;
+        }
+    }
+    return h;
+}
+
+Baseline::Baseline(const std::string &path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open baseline " + path + ": " + std::strerror(errno));
+
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < vfp_header) {
+        close(fd);
+        throw std::runtime_error("Not a baseline file: " + path);
+    }
+
+    map_size_ = (size_t)st.st_size;
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        throw std::runtime_error("Cannot map baseline " + path + ": " + std::strerror(errno));
+    }
+
+    const char *base = static_cast<const char *>(map_);
+    uint64_t count = 0, types = 0;
+    std::memcpy(&count, base + sizeof(vfp_magic), sizeof(count));
+    std::memcpy(&types, base + sizeof(vfp_magic) + sizeof(count), sizeof(types));
+    types_ = (unsigned)types;
+    if (std::memcmp(base, vfp_magic, sizeof(vfp_magic)) != 0 || count > UINT32_MAX ||
+        map_size_ != vfp_header + count * sizeof(uint64_t)) {
+        munmap(map_, map_size_);
+        map_ = nullptr;
+        throw std::runtime_error("Not a baseline file: " + path);
+    }
+
+    fps_ = reinterpret_cast<const uint64_t *>(base + vfp_header);
+    n_ = (size_t)count;
+    madvise(map_, map_size_, MADV_RANDOM);
+
+    radix_.resize((1u << radix_bits) + 1);
+    for (uint64_t b = 0; b < (1u << radix_bits); ++b)
+        radix_[b] = (uint32_t)(std::lower_bound(fps_, fps_ + n_, b << (64 - radix_bits)) - fps_);
+    radix_.back() = (uint32_t)n_;
+}
+
+Baseline::~Baseline()
+{
+    if (map_)
+        munmap(map_, map_size_);
+}
+
+bool Baseline::contains(uint64_t fp)
+{
+    const size_t b = fp >> (64 - radix_bits);
+    const uint64_t *first = fps_ + radix_[b];
+    const uint64_t *last = fps_ + radix_[b + 1];
+    const uint64_t *at = std::lower_bound(first, last, fp);
+    if (at == last || *at != fp)
+        return false;
+
+    if (seen_.empty())
+        seen_.resize(n_ / 64 + 1);
+    const size_t i = (size_t)(at - fps_);
+    uint64_t &word = seen_[i / 64];
+    const uint64_t bit = 1ull << (i % 64);
+    if (!(word & bit)) {
+        word |= bit;
+        ++seen_count_;
+    }
+    return true;
+}
+
+// Written next to the target and renamed over it, so a baseline being read
+// by another run is never seen half written.
+void Baseline::save(const std::string &path, std::vector<uint64_t> &fps, unsigned types)
+{
+    std::sort(fps.begin(), fps.end());
+    fps.erase(std::unique(fps.begin(), fps.end()), fps.end());
+
+    const std::string tmp = path + ".tmp";
+    FILE *f = std::fopen(tmp.c_str(), "wb");
+    if (!f)
+        throw std::runtime_error("Cannot write baseline " + tmp + ": " + std::strerror(errno));
+
+    const uint64_t count = fps.size();
+    const uint64_t types64 = types;
+    bool ok = std::fwrite(vfp_magic, sizeof(vfp_magic), 1, f) == 1 && std::fwrite(&count, sizeof(count), 1, f) == 1 &&
+              std::fwrite(&types64, sizeof(types64), 1, f) == 1 &&
+              std::fwrite(fps.data(), sizeof(uint64_t), fps.size(), f) == fps.size();
+    ok = std::fclose(f) == 0 && ok;
+
+    if (!ok || std::rename(tmp.c_str(), path.c_str()) != 0) {
+        const int e = errno;
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Cannot write baseline " + path + ": " + std::strerror(e));
+    }
+}
+
+} // namespace vanitas
@@ -2,72 +2,136 @@
 
 #include "vanitas/normalizer.hpp"
 #include "vanitas/profile.hpp"
+#include "vanitas/structured.hpp"
 
 namespace vanitas {
 
-bool BlockBuilder::is_firstline(std::string_view s) { return any_match(p_.firstline, s); }
-bool BlockBuilder::is_continuation(std::string_view s) { return any_match(p_.continuation, s); }
+static constexpr size_t batch_initial_bytes = 64 * 1024;
 
-BlockBuilder::BlockBuilder(const Profile &p) : p_(p), current_(Block{}), has_current_(false) {}
+BlockBatch::BlockBatch() : initial_(batch_initial_bytes), arena_(initial_.data(), initial_.size()), blocks_(&arena_) {}
 
-std::vector<Block> BlockBuilder::push(const std::vector<Event> &events)
+void BlockBatch::recycle()
 {
-    std::vector<Block> out;
-
-    auto flush_current = [&]() {
-        if (has_current_ && !current_.lines.empty()) {
-            out.push_back(std::move(current_));
-            current_ = Block{};
-            has_current_ = false;
-        }
-    };
-
-    for (const auto &ev : events) {
-        if (ev.kind == EvKind::Status) {
-            if (has_current_)
-                current_.has_status = true;
-            continue;
-        }
-
-        std::string_view line = ev.text;
-        if (line.empty())
-            continue;
-
-        if (!has_current_) {
-            current_.lines.emplace_back(line);
-            has_current_ = true;
-            continue;
-        }
-
-        if (is_firstline(line)) {
-            flush_current();
-            current_.lines.emplace_back(line);
-            has_current_ = true;
-            continue;
-        }
-
-        if (is_continuation(line)) {
-            current_.lines.emplace_back(line);
-            continue;
-        }
-
-        flush_current();
-        current_.lines.emplace_back(line);
-        has_current_ = true;
+    blocks_.clear();
+    blocks_.shrink_to_fit();
+    arena_.release();
+}
+
+bool BlockBuilder::starts_block(const Profile &p, std::string_view line)
+{
+    if (p.structured.enabled())
+        return is_record(p.structured, line) || any_match(p.firstline, line);
+    return any_match(p.firstline, line) || !any_match(p.continuation, line);
+}
+
+void Correlator::push(const Profile &p, const Block &b, BlockBatch &out)
+{
+    const Correlation &c = p.correlate;
+    if (!c.enabled()) {
+        flush(out);
+        out.blocks().emplace_back(b, out.resource());
+        return;
+    }
+
+    const std::string_view head = b.head();
+    if (any_search(c.lead, head)) {
+        if (state_ == State::Owner || leads_ >= c.max_lead)
+            flush(out);
+        if (state_ == State::Empty)
+            chain_ = b;
+        else
+            chain_.append(b);
+        state_ = State::Leads;
+        ++leads_;
+        return;
+    }
+
+    if (state_ == State::Owner && follows_ < c.max_follow && any_search(c.follow, head)) {
+        chain_.append(b);
+        ++follows_;
+        return;
+    }
+
+    // b is a diagnostic of its own (or a follow block past the limit)
+    if (state_ == State::Leads) {
+        chain_.head_index = chain_.size();
+        chain_.append(b);
+    } else {
+        flush(out);
+        chain_ = b;
+    }
+    state_ = State::Owner;
+    follows_ = 0;
+    if (c.follow.empty())
+        flush(out);
+}
+
+void Correlator::flush(BlockBatch &out)
+{
+    if (state_ == State::Empty)
+        return;
+    out.blocks().emplace_back(chain_, out.resource());
+    chain_.clear();
+    state_ = State::Empty;
+    leads_ = 0;
+    follows_ = 0;
+}
+
+BlockBuilder::BlockBuilder(ProfilePtr p, std::string_view source) : p_(std::move(p)), current_(Block{}), has_current_(false)
+{
+    current_.source = source;
+}
+
+void BlockBuilder::push(const std::vector<Event> &events, BlockBatch &out)
+{
+    for (const auto &ev : events)
+        push(ev, out);
+}
+
+// current_ lives on the heap across batches and keeps its capacity;
+// finished blocks are copied once into the batch arena.
+void BlockBuilder::push(const Event &ev, BlockBatch &out)
+{
+    if (ev.kind == EvKind::Status) {
+        if (has_current_)
+            current_.has_status = true;
+        return;
+    }
+
+    std::string_view line = ev.text;
+    if (line.empty())
+        return;
+
+    if (has_current_ && !starts_block(*p_, line)) {
+        current_.add_line(line);
+        return;
     }
 
-    return out;
+    finish_block(out);
+    current_.offset = ev.offset;
+    current_.first_line = ev.line;
+    if (p_->timestamp.enabled()) {
+        if (const auto t = find_timestamp(p_->timestamp, line))
+            last_time_ = *t;
+        current_.time = last_time_;
+    }
+    current_.add_line(line);
+    has_current_ = true;
 }
 
-std::vector<Block> BlockBuilder::flush()
+void BlockBuilder::finish_block(BlockBatch &out)
 {
-    std::vector<Block> out;
-    if (has_current_ && !current_.lines.empty()) {
-        out.push_back(std::move(current_));
-        current_ = Block{};
+    if (has_current_ && !current_.empty()) {
+        correlate_.push(*p_, current_, out);
+        current_.clear();
         has_current_ = false;
     }
-    return out;
+}
+
+void BlockBuilder::flush(BlockBatch &out)
+{
+    finish_block(out);
+    correlate_.flush(out);
 }
 
 } // namespace vanitas
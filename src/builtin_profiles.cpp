@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <cstddef>
+
+#include "vanitas/builtin_profiles.hpp"
+
+namespace vanitas {
+
+// Each matcher below is the exact equivalent of the pattern next to it as
+// std::regex (ECMAScript, no multiline) reads it: ^ and $ hold at the ends of
+// the text only, . and \S do not cross a newline, \s does.
+namespace {
+
+// a string literal as a template argument
+template <size_t N>
+struct Lit
+{
+        char s[N];
+        constexpr Lit(const char (&a)[N]) { std::copy_n(a, N, s); }
+        constexpr std::string_view view() const { return {s, N - 1}; }
+};
+
+constexpr bool is_space(char c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+constexpr bool is_digit(char c) { return c >= '0' && c <= '9'; }
+constexpr bool is_word(char c) { return is_digit(c) || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_'; }
+
+// \b at i
+constexpr bool boundary(std::string_view s, size_t i)
+{
+    const bool before = i > 0 && is_word(s[i - 1]);
+    const bool after = i < s.size() && is_word(s[i]);
+    return before != after;
+}
+
+// past the run of digits (spaces) starting at i
+constexpr size_t skip_digits(std::string_view s, size_t i)
+{
+    while (i < s.size() && is_digit(s[i]))
+        ++i;
+    return i;
+}
+
+constexpr size_t skip_spaces(std::string_view s, size_t i)
+{
+    while (i < s.size() && is_space(s[i]))
+        ++i;
+    return i;
+}
+
+// ^L
+template <Lit L>
+bool starts(std::string_view s)
+{
+    return s.starts_with(L.view());
+}
+
+// ^L\b, L ending in a word character
+template <Lit L>
+bool starts_word(std::string_view s)
+{
+    return s.starts_with(L.view()) && boundary(s, L.view().size());
+}
+
+// ^L\s
+template <Lit L>
+bool starts_space(std::string_view s)
+{
+    return s.size() > L.view().size() && s.starts_with(L.view()) && is_space(s[L.view().size()]);
+}
+
+// L
+template <Lit L>
+bool contains(std::string_view s)
+{
+    return s.find(L.view()) != std::string_view::npos;
+}
+
+// \bL\b, L starting and ending in word characters
+template <Lit L>
+bool word(std::string_view s)
+{
+    const std::string_view l = L.view();
+    for (size_t i = s.find(l); i != std::string_view::npos; i = s.find(l, i + 1)) {
+        if (boundary(s, i) && boundary(s, i + l.size()))
+            return true;
+    }
+    return false;
+}
+
+// ^\s+
+bool leading_space(std::string_view s) { return !s.empty() && is_space(s[0]); }
+
+// ^H\d+(:\d+){N-1}T
+template <Lit H, int N, Lit T>
+bool starts_numbers(std::string_view s)
+{
+    if (!s.starts_with(H.view()))
+        return false;
+    size_t i = H.view().size();
+    for (int n = 0; n < N; ++n) {
+        if (n > 0) {
+            if (i >= s.size() || s[i] != ':')
+                return false;
+            ++i;
+        }
+        const size_t end = skip_digits(s, i);
+        if (end == i)
+            return false;
+        i = end;
+    }
+    return s.substr(i).starts_with(T.view());
+}
+
+// ^H(\[C\d+\])?T
+template <Lit H, Lit C, Lit T>
+bool starts_code(std::string_view s)
+{
+    if (!s.starts_with(H.view()))
+        return false;
+    s.remove_prefix(H.view().size());
+    if (s.starts_with(T.view()))
+        return true;
+    if (!s.starts_with("[") || !s.substr(1).starts_with(C.view()))
+        return false;
+    const size_t i = 1 + C.view().size();
+    const size_t end = skip_digits(s, i);
+    return end > i && end < s.size() && s[end] == ']' && s.substr(end + 1).starts_with(T.view());
+}
+
+// ^C{3,} (a rule of C, then a space)
+template <char C>
+bool rule_line(std::string_view s)
+{
+    size_t i = 0;
+    while (i < s.size() && s[i] == C)
+        ++i;
+    return i >= 3 && i < s.size() && s[i] == ' ';
+}
+
+// ^P.*S$
+template <Lit P, Lit S>
+bool starts_ends(std::string_view s)
+{
+    const std::string_view p = P.view();
+    const std::string_view x = S.view();
+    if (s.size() < p.size() + x.size() || !s.starts_with(p) || !s.ends_with(x))
+        return false;
+    return s.substr(p.size(), s.size() - p.size() - x.size()).find('\n') == std::string_view::npos;
+}
+
+// ^P.*L
+template <Lit P, Lit L>
+bool starts_then(std::string_view s)
+{
+    const std::string_view p = P.view();
+    if (!s.starts_with(p))
+        return false;
+    const size_t at = s.find(L.view(), p.size());
+    return at != std::string_view::npos && s.substr(p.size(), at - p.size()).find('\n') == std::string_view::npos;
+}
+
+// ^\S+ followed by what M matches at the start
+template <RuleMatcher M>
+bool after_token(std::string_view s)
+{
+    for (size_t k = 1; k <= s.size() && !is_space(s[k - 1]); ++k) {
+        if (M(s.substr(k)))
+            return true;
+    }
+    return false;
+}
+
+// :\d+:\d+:\s+ followed by what M matches at the start, M's match starting
+// with a non-space character
+template <RuleMatcher M>
+bool diagnostic(std::string_view s)
+{
+    for (size_t i = s.find(':'); i != std::string_view::npos; i = s.find(':', i + 1)) {
+        size_t at = i + 1;
+        size_t end = skip_digits(s, at);
+        if (end == at || end >= s.size() || s[end] != ':')
+            continue;
+        at = end + 1;
+        end = skip_digits(s, at);
+        if (end == at || end >= s.size() || s[end] != ':')
+            continue;
+        at = end + 1;
+        end = skip_spaces(s, at);
+        if (end > at && M(s.substr(end)))
+            return true;
+    }
+    return false;
+}
+
+// ^(fatal\s+)?error:
+bool fatal_error(std::string_view s)
+{
+    if (s.starts_with("error:"))
+        return true;
+    if (!s.starts_with("fatal"))
+        return false;
+    const size_t end = skip_spaces(s, 5);
+    return end > 5 && s.substr(end).starts_with("error:");
+}
+
+// ^required (from|by)
+bool required_from(std::string_view s) { return s.starts_with("required from ") || s.starts_with("required by "); }
+
+// ^\d+\s+\|
+bool line_number_bar(std::string_view s)
+{
+    const size_t digits = skip_digits(s, 0);
+    if (digits == 0)
+        return false;
+    const size_t end = skip_spaces(s, digits);
+    return end > digits && end < s.size() && s[end] == '|';
+}
+
+// default
+
+constexpr BuiltinRule default_firstline[] = {
+    {R"(^ERR\b)", starts_word<"ERR">},
+    {R"(^WRN\b)", starts_word<"WRN">},
+    {R"(^ERROR:)", starts<"ERROR:">},
+    {R"(^WARN:)", starts<"WARN:">},
+};
+constexpr BuiltinRule default_continuation[] = {
+    {R"(^\s+)", leading_space},
+    {R"(^stack traceback:)", starts<"stack traceback:">},
+};
+constexpr BuiltinRule default_err[] = {
+    {R"(^ERR\b)", starts_word<"ERR">},
+    {R"(\berror\b)", word<"error">},
+};
+constexpr BuiltinRule default_wrn[] = {
+    {R"(^WRN\b)", starts_word<"WRN">},
+    {R"(\bwarning\b)", word<"warning">},
+};
+constexpr BuiltinRule default_tests[] = {
+    {R"(\bPASSED\b)", word<"PASSED">},
+    {R"(\bFAILED\b)", word<"FAILED">},
+    {R"(short test summary info)", contains<"short test summary info">},
+};
+
+// gcc
+
+constexpr BuiltinRule gcc_err[] = {
+    {R"(:\d+:\d+:\s+(fatal\s+)?error:)", diagnostic<fatal_error>},
+    {R"(undefined reference to )", contains<"undefined reference to ">},
+    {R"(^collect2: error: )", starts<"collect2: error: ">},
+    {R"(^make(\[\d+\])?: \*\*\*)", starts_code<"make", "", ": ***">},
+    {R"(^FAILED: )", starts<"FAILED: ">},
+    {R"(^ninja: build stopped: )", starts<"ninja: build stopped: ">},
+};
+constexpr BuiltinRule gcc_wrn[] = {
+    {R"(:\d+:\d+:\s+warning:)", diagnostic<starts<"warning:">>},
+};
+constexpr BuiltinRule gcc_lead[] = {
+    {R"(^In file included from )", starts<"In file included from ">},
+    {R"(^\S+: In )", after_token<starts<": In ">>},
+    {R"(:\d+:\d+:\s+required (from|by) )", diagnostic<required_from>},
+};
+constexpr BuiltinRule gcc_follow[] = {
+    {R"(:\d+:\d+:\s+note: )", diagnostic<starts<"note: ">>},
+};
+
+// pytest
+
+constexpr BuiltinRule pytest_firstline[] = {
+    {R"(^={3,} )", rule_line<'='>},
+    {R"(^_{3,} )", rule_line<'_'>},
+};
+constexpr BuiltinRule pytest_continuation[] = {
+    {R"(^\s+)", leading_space},
+    {R"(^E\s)", starts_space<"E">},
+    {R"(^>\s)", starts_space<">">},
+    {R"(^\S+\.py:\d+: )", after_token<starts_numbers<".py:", 1, ": ">>},
+};
+constexpr BuiltinRule pytest_err[] = {
+    {R"(^FAILED )", starts<"FAILED ">},
+    {R"(^ERROR )", starts<"ERROR ">},
+    {R"(^_{3,} )", rule_line<'_'>},
+};
+constexpr BuiltinRule pytest_wrn[] = {
+    {R"(warnings summary)", contains<"warnings summary">},
+    {R"(Warning: )", contains<"Warning: ">},
+};
+
+// lua
+
+constexpr BuiltinRule lua_firstline[] = {
+    {R"(^Error detected while processing )", starts<"Error detected while processing ">},
+    {R"(^lua: )", starts<"lua: ">},
+};
+constexpr BuiltinRule lua_continuation[] = {
+    {R"(^\s+)", leading_space},
+    {R"(^stack traceback:)", starts<"stack traceback:">},
+    {R"(^E\d+: )", starts_numbers<"E", 1, ": ">},
+    {R"(^Error executing )", starts<"Error executing ">},
+};
+constexpr BuiltinRule lua_err[] = {
+    {R"(^Error detected while processing )", starts<"Error detected while processing ">},
+    {R"(^E\d+: )", starts_numbers<"E", 1, ": ">},
+    {R"(^Error executing )", starts<"Error executing ">},
+    {R"(^lua: )", starts<"lua: ">},
+};
+constexpr BuiltinRule lua_wrn[] = {
+    {R"(^W\d+: )", starts_numbers<"W", 1, ": ">},
+    {R"(\bdeprecated\b)", word<"deprecated">},
+};
+
+// go
+
+constexpr BuiltinRule go_firstline[] = {
+    {R"(^panic: )", starts<"panic: ">},
+    {R"(^fatal error: )", starts<"fatal error: ">},
+};
+constexpr BuiltinRule go_continuation[] = {
+    {R"(^\s+)", leading_space},
+    {R"(^goroutine \d+ \[)", starts_numbers<"goroutine ", 1, " [">},
+    {R"(^created by )", starts<"created by ">},
+    {R"(^\S+\(.*\)$)", after_token<starts_ends<"(", ")">>},
+};
+constexpr BuiltinRule go_err[] = {
+    {R"(^panic: )", starts<"panic: ">},
+    {R"(^fatal error: )", starts<"fatal error: ">},
+    {R"(^--- FAIL: )", starts<"--- FAIL: ">},
+    {R"(^FAIL\b)", starts_word<"FAIL">},
+    {R"(^\S+\.go:\d+:\d+: )", after_token<starts_numbers<".go:", 2, ": ">>},
+};
+constexpr BuiltinRule go_wrn[] = {
+    {R"(^WARNING: DATA RACE)", starts<"WARNING: DATA RACE">},
+};
+constexpr BuiltinRule go_tests[] = {
+    {R"(^--- PASS: )", starts<"--- PASS: ">},
+    {R"(^--- SKIP: )", starts<"--- SKIP: ">},
+    {R"(^ok\s)", starts_space<"ok">},
+};
+
+// rust
+
+constexpr BuiltinRule rust_firstline[] = {
+    {R"(^error(\[E\d+\])?: )", starts_code<"error", "E", ": ">},
+    {R"(^warning: )", starts<"warning: ">},
+};
+constexpr BuiltinRule rust_continuation[] = {
+    {R"(^\s+)", leading_space},
+    {R"(^\d+\s+\|)", line_number_bar},
+};
+constexpr BuiltinRule rust_err[] = {
+    {R"(^error(\[E\d+\])?: )", starts_code<"error", "E", ": ">},
+    {R"(^thread '.*' panicked at )", starts_then<"thread '", "' panicked at ">},
+    {R"(^test .* \.\.\. FAILED$)", starts_ends<"test ", " ... FAILED">},
+    {R"(^test result: FAILED\b)", starts_word<"test result: FAILED">},
+};
+constexpr BuiltinRule rust_wrn[] = {
+    {R"(^warning: )", starts<"warning: ">},
+};
+constexpr BuiltinRule rust_tests[] = {
+    {R"(^test .* \.\.\. ok$)", starts_ends<"test ", " ... ok">},
+    {R"(^test result: ok\b)", starts_word<"test result: ok">},
+};
+
+constexpr BuiltinProfile profiles[] = {
+    {
+        .name = "default",
+        .about = "ERR/WRN level tags, error and warning words, test results",
+        .firstline = default_firstline,
+        .continuation = default_continuation,
+        .err = default_err,
+        .wrn = default_wrn,
+        .tests = default_tests,
+    },
+    {
+        .name = "gcc",
+        .about = "GCC and Clang diagnostics with their notes, linker, make and ninja failures",
+        .err = gcc_err,
+        .wrn = gcc_wrn,
+        .lead = gcc_lead,
+        .follow = gcc_follow,
+    },
+    {
+        .name = "pytest",
+        .about = "pytest failure sections, summaries and warnings",
+        .firstline = pytest_firstline,
+        .continuation = pytest_continuation,
+        .err = pytest_err,
+        .wrn = pytest_wrn,
+    },
+    {
+        .name = "lua",
+        .about = "Lua and Neovim errors with their stack tracebacks",
+        .firstline = lua_firstline,
+        .continuation = lua_continuation,
+        .err = lua_err,
+        .wrn = lua_wrn,
+    },
+    {
+        .name = "go",
+        .about = "Go panics with their goroutines, go test and build errors",
+        .firstline = go_firstline,
+        .continuation = go_continuation,
+        .err = go_err,
+        .wrn = go_wrn,
+        .tests = go_tests,
+    },
+    {
+        .name = "rust",
+        .about = "rustc diagnostics with their source excerpts, panics, cargo test",
+        .firstline = rust_firstline,
+        .continuation = rust_continuation,
+        .err = rust_err,
+        .wrn = rust_wrn,
+        .tests = rust_tests,
+    },
+};
+
+} // namespace
+
+std::span<const BuiltinProfile> builtin_profiles() { return profiles; }
+
+const BuiltinProfile *find_builtin_profile(std::string_view name)
+{
+    for (const auto &p : profiles) {
+        if (p.name == name)
+            return &p;
+    }
+    return nullptr;
+}
+
+RuleMatcher builtin_matcher(std::string_view pattern)
+{
+    for (const auto &p : profiles) {
+        for (const BuiltinRules rules : {p.firstline, p.continuation, p.err, p.wrn, p.tests, p.lead, p.follow}) {
+            for (const auto &r : rules) {
+                if (r.pattern == pattern)
+                    return r.match;
+            }
+        }
+    }
+    return nullptr;
+}
+
+} // namespace vanitas
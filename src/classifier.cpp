@@ -1,69 +1,356 @@
-#include <regex>
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
 
 #include "vanitas/block_builder.hpp"
 #include "vanitas/classifier.hpp"
+#include "vanitas/structured.hpp"
 
 namespace vanitas {
 
-static std::string join_lines(const std::vector<std::string> &lines)
+// the line starts with tag as a word, like ^TAG\b
+static bool level_tag(std::string_view head, std::string_view tag)
 {
-    std::string out;
-    for (size_t i = 0; i < lines.size(); ++i) {
-        out += lines[i];
-        if (i + 1 < lines.size())
-            out += '\n';
+    if (!head.starts_with(tag))
+        return false;
+    if (head.size() == tag.size())
+        return true;
+    const unsigned char c = (unsigned char)head[tag.size()];
+    return !(std::isalnum(c) || c == '_');
+}
+
+unsigned parse_type_names(const std::vector<std::string> &names)
+{
+    unsigned out = 0;
+    for (const auto &n : names) {
+        if (n == "error" || n == "errors" || n == "err")
+            out |= type_bit(Type::Error);
+        else if (n == "warn" || n == "warning" || n == "warnings" || n == "wrn")
+            out |= type_bit(Type::Warn);
+        else if (n == "tests" || n == "test")
+            out |= type_bit(Type::Tests);
+        else if (n == "info")
+            out |= type_bit(Type::Info);
+        else
+            throw std::runtime_error("Unknown item type: '" + n + "' (expected error, warn, tests, info)");
     }
     return out;
 }
 
-Classifier::Classifier(const Profile &p) : p_(p), errors_count(0), warn_count(0) {}
+// severity order: info < tests < warn < error
+unsigned min_severity_types(const std::string &name)
+{
+    const unsigned error = type_bit(Type::Error);
+    const unsigned warn = error | type_bit(Type::Warn);
+    const unsigned tests = warn | type_bit(Type::Tests);
+
+    if (name == "error" || name == "err")
+        return error;
+    if (name == "warn" || name == "warning" || name == "wrn")
+        return warn;
+    if (name == "tests" || name == "test")
+        return tests;
+    if (name == "info")
+        return all_types;
+    throw std::runtime_error("Unknown severity: '" + name + "' (expected error, warn, tests, info)");
+}
 
-std::vector<Item> Classifier::classify(const std::vector<Block> &blocks)
+Classifier::Classifier(ProfilePtr p, Filter f, ContextOptions ctx) : p_(std::move(p)), f_(f), ctx_(ctx), ring_(ctx.before)
 {
-    std::vector<Item> out;
-    out.reserve(blocks.size());
+    if (f_.count_only)
+        ctx_ = ContextOptions{};
+    reset_rules();
+}
 
-    static const std::regex re_level_err(R"(^ERR\b)");
-    static const std::regex re_level_wrn(R"(^WRN\b)");
+void Classifier::set_profile(ProfilePtr p)
+{
+    learn();
+    p_ = std::move(p);
+    reset_rules();
+}
 
-    for (const auto &bl : blocks) {
-        if (bl.lines.empty())
-            continue;
+void Classifier::shed(Shed level)
+{
+    shed_ = level;
+    counts_.shed.worst = std::max(counts_.shed.worst, level);
+}
 
-        const std::string &head = bl.lines.front();
-        std::string all = join_lines(bl.lines);
+void Classifier::reset_rules()
+{
+    auto prior = [&](RuleGroup g, const std::vector<Rule> &rules) {
+        return p_->learner ? p_->learner->prior(g, rules) : std::vector<RuleStat>{};
+    };
+    err_order_.reset(&p_->err, prior(RuleGroup::Err, p_->err));
+    wrn_order_.reset(&p_->wrn, prior(RuleGroup::Wrn, p_->wrn));
+    tests_order_.reset(&p_->tests, prior(RuleGroup::Tests, p_->tests));
+}
 
-        // 1) fast-path
-        if (std::regex_search(head, re_level_err)) {
-            ++errors_count;
-            out.push_back({Type::Error, head, all});
-            continue;
+// hands what the rule orders counted so far to the profile's learner
+void Classifier::learn()
+{
+    if (!p_->learner)
+        return;
+    p_->learner->merge(RuleGroup::Err, p_->err, err_order_.drain());
+    p_->learner->merge(RuleGroup::Wrn, p_->wrn, wrn_order_.drain());
+    p_->learner->merge(RuleGroup::Tests, p_->tests, tests_order_.drain());
+}
+
+static void append_line(std::string &dst, std::string_view line)
+{
+    if (!dst.empty())
+        dst += '\n';
+    dst += line;
+}
+
+std::string_view Classifier::keep(std::string_view s)
+{
+    if (s.empty())
+        return {};
+    char *p = static_cast<char *>(kept_[cur_kept_].allocate(s.size(), 1));
+    std::copy(s.begin(), s.end(), p);
+    return std::string_view(p, s.size());
+}
+
+// Items returned by the previous call have been written out by now; only the
+// held ones (an owner and at most its trailing window) are still needed.
+void Classifier::recycle_kept()
+{
+    auto &old = kept_[cur_kept_];
+    cur_kept_ ^= 1;
+    for (auto &it : held_) {
+        it.text = keep(it.text);
+        it.details = keep(it.details);
+        it.before = keep(it.before);
+        it.after = keep(it.after);
+        it.source = keep(it.source);
+    }
+    old.release();
+}
+
+// Held items outlive the batch they came from, so they get their own copy.
+void Classifier::hold(Item it)
+{
+    it.text = keep(it.text);
+    it.details = keep(it.details);
+    it.source = keep(it.source);
+    held_.push_back(it);
+}
+
+void Classifier::close_owner()
+{
+    if (held_.empty())
+        return;
+    held_[owner_].after = keep(after_buf_);
+    after_buf_.clear();
+}
+
+void Classifier::release_held(std::vector<Item> &out)
+{
+    close_owner();
+    out.insert(out.end(), held_.begin(), held_.end());
+    held_.clear();
+    after_left_ = 0;
+}
+
+// A block that is not reported itself: becomes trailing context of the pending
+// Error/Warn, or is remembered in the ring as leading context for the next one.
+void Classifier::keep_context(const Block &bl, std::vector<Item> &out)
+{
+    if (!ctx_.enabled())
+        return;
+
+    if (ctx_.lines) {
+        for (size_t i = 0; i < bl.size(); ++i) {
+            if (after_left_ > 0) {
+                append_line(after_buf_, bl.line(i));
+                --after_left_;
+            } else if (ring_.capacity() > 0) {
+                ring_.push_slot().assign(bl.line(i));
+            }
         }
-        if (std::regex_search(head, re_level_wrn)) {
-            ++warn_count;
-            out.push_back({Type::Warn, head, all});
+    } else if (after_left_ > 0) {
+        append_line(after_buf_, bl.text);
+        --after_left_;
+    } else if (ring_.capacity() > 0) {
+        ring_.push_slot().assign(bl.text);
+    }
+
+    if (after_left_ == 0 && !held_.empty())
+        release_held(out);
+}
+
+void Classifier::emit(Item it, size_t units, std::vector<Item> &out)
+{
+    if (!ctx_.enabled()) {
+        out.push_back(it);
+        return;
+    }
+
+    const bool owner = it.type == Type::Error || it.type == Type::Warn;
+
+    // Context already attached to an earlier item is gone from the ring, so
+    // overlapping windows are merged instead of repeated.
+    if (owner) {
+        before_buf_.clear();
+        ring_.drain([&](const std::string &s) { append_line(before_buf_, s); });
+        it.before = keep(before_buf_);
+    } else {
+        ring_.clear();
+    }
+
+    after_left_ -= std::min(after_left_, units);
+
+    // a new owner ends the window of the one before, so what is held goes out
+    // now and dense errors do not pile up behind the first one
+    if (owner && ctx_.after > 0) {
+        release_held(out);
+        owner_ = 0;
+        after_left_ = ctx_.after;
+        hold(it);
+        return;
+    }
+
+    if (!held_.empty()) {
+        hold(it);
+        if (after_left_ == 0)
+            release_held(out);
+        return;
+    }
+
+    out.push_back(it);
+}
+
+void Classifier::count(Type t)
+{
+    switch (t) {
+    case Type::Error:
+        ++counts_.errors;
+        break;
+    case Type::Warn:
+        ++counts_.warnings;
+        break;
+    case Type::Tests:
+        ++counts_.tests;
+        break;
+    default:
+        ++counts_.info;
+        break;
+    }
+}
+
+// Returns nullopt as soon as the block can only end up as a type the filter drops,
+// so unwanted blocks skip the remaining rules.
+std::optional<Type> Classifier::detect(const Block &bl)
+{
+    const std::string_view head = bl.head();
+    const unsigned below_err = type_bit(Type::Warn) | type_bit(Type::Tests) | type_bit(Type::Info);
+    const unsigned below_wrn = type_bit(Type::Tests) | type_bit(Type::Info);
+
+    auto pick = [&](Type t) -> std::optional<Type> {
+        if (f_.wants(t))
+            return t;
+        return std::nullopt;
+    };
+
+    // 1) fast-path
+    if (level_tag(head, "ERR"))
+        return pick(Type::Error);
+    if (level_tag(head, "WRN"))
+        return pick(Type::Warn);
+
+    // 2) profile rules, err before wrn before tests; within a group in learned order
+    if (!p_->err.empty() && err_order_.search(head))
+        return pick(Type::Error);
+    if ((f_.types & below_err) == 0)
+        return std::nullopt;
+
+    if (!p_->wrn.empty() && try_warn() && wrn_order_.search(head))
+        return pick(Type::Warn);
+    if ((f_.types & below_wrn) == 0)
+        return std::nullopt;
+
+    // run with tests filtered out too, or tests results would be taken for info
+    if (!p_->tests.empty()) {
+        if (shed_ >= Shed::Tests)
+            ++counts_.shed.tests;
+        else if (tests_order_.search(bl.text))
+            return pick(Type::Tests);
+    }
+
+    // 3) default
+    return pick(Type::Info);
+}
+
+// whether the warn rules run on this block, as shed_ allows
+bool Classifier::try_warn()
+{
+    if (shed_ < Shed::Sample || (shed_ == Shed::Sample && ++sampled_ % shed_sample_every == 0))
+        return true;
+    ++counts_.shed.warn;
+    return false;
+}
+
+// Structured records: the level field decides, no rules run.
+std::optional<Type> Classifier::detect(const Record &r) const
+{
+    const Type t = level_type(p_->structured, r.level);
+    if (f_.wants(t))
+        return t;
+    return std::nullopt;
+}
+
+// The record's message as the item text, decoded only if it has escapes;
+// a multi-line message gives its first line, the block keeps the rest.
+std::string_view Classifier::message(const Record &r, std::string_view head)
+{
+    if (r.message.empty())
+        return head;
+    if (!r.escaped)
+        return r.message;
+    unescaped_.clear();
+    unescape(unescaped_, r.message);
+    return keep(std::string_view(unescaped_).substr(0, unescaped_.find('\n')));
+}
+
+std::vector<Item> Classifier::classify(const BlockBatch &batch)
+{
+    std::vector<Item> out;
+    recycle_kept();
+
+    for (const auto &bl : batch.blocks()) {
+        if (bl.empty())
             continue;
-        }
 
-        // 2) profile rules
-        if (!p_.err.empty() && any_search(p_.err, head)) {
-            ++errors_count;
-            out.push_back({Type::Error, head, all});
+        Record rec;
+        const bool structured = p_->structured.enabled() && rec.parse(p_->structured, bl.head());
+        const auto t = structured ? detect(rec) : detect(bl);
+        if (!t) {
+            keep_context(bl, out);
             continue;
         }
-        if (!p_.wrn.empty() && any_search(p_.wrn, head)) {
-            ++warn_count;
-            out.push_back({Type::Warn, head, all});
+
+        count(*t);
+        if (f_.count_only)
             continue;
-        }
-        if (!p_.tests.empty() && any_search(p_.tests, all)) {
-            out.push_back({Type::Tests, head, all});
+        if (*t == Type::Info && shed_ >= Shed::Info) {
+            ++counts_.shed.info;
+            keep_context(bl, out);
             continue;
         }
 
-        // 3) default
-        out.push_back({Type::Info, head, all});
+        const std::string_view text = structured ? message(rec, bl.head()) : bl.head();
+        emit({*t, text, bl.text, {}, {}, bl.offset, bl.first_line, bl.source, bl.time}, ctx_.lines ? bl.size() : 1, out);
     }
     return out;
 }
+
+std::vector<Item> Classifier::flush()
+{
+    std::vector<Item> out;
+    recycle_kept();
+    release_held(out);
+    ring_.clear();
+    learn();
+    return out;
+}
 } // namespace vanitas
@@ -0,0 +1,91 @@
+#include "vanitas/clean_writer.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace vanitas {
+
+CleanWriter::CleanWriter(const std::string &path) : path_(path), owned_(true)
+{
+    fd_ = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw std::runtime_error("Cannot write " + path + ": " + std::strerror(errno));
+}
+
+CleanWriter::~CleanWriter()
+{
+    if (inflight_.valid())
+        inflight_.wait();
+    if (owned_)
+        close(fd_);
+}
+
+// A status line ("\r" without "\n") only shows until the next one replaces
+// it, so only the last one before a line counts, and only if that line is
+// empty: "text\r\n" ends in an empty line, and the text is what was shown.
+void CleanWriter::push(const std::vector<Event> &events)
+{
+    for (const auto &ev : events) {
+        if (ev.kind == EvKind::Status) {
+            status_.assign(ev.text);
+            has_status_ = true;
+            continue;
+        }
+        line(ev.text.empty() && has_status_ ? std::string_view(status_) : ev.text);
+        has_status_ = false;
+    }
+}
+
+void CleanWriter::finish()
+{
+    if (has_status_) {
+        line(status_);
+        has_status_ = false;
+    }
+    wait();
+    write_all(buf_);
+    buf_.clear();
+}
+
+void CleanWriter::line(std::string_view text)
+{
+    if (buf_.capacity() < buffer_bytes)
+        buf_.reserve(buffer_bytes);
+    buf_.append(text);
+    buf_.push_back('\n');
+    ++lines_;
+    if (buf_.size() >= buffer_bytes) {
+        wait();
+        buf_.swap(spare_);
+        buf_.clear();
+        inflight_ = std::async(std::launch::async, [this] { write_all(spare_); });
+    }
+}
+
+// Rethrows what the last write in flight failed with.
+void CleanWriter::wait()
+{
+    if (inflight_.valid())
+        inflight_.get();
+}
+
+void CleanWriter::write_all(const std::string &s)
+{
+    const char *p = s.data();
+    size_t left = s.size();
+    while (left > 0) {
+        const ssize_t n = write(fd_, p, left);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            throw std::runtime_error("Cannot write " + (path_.empty() ? std::string("output") : path_) + ": " +
+                                     std::strerror(errno));
+        p += n;
+        left -= (size_t)n;
+    }
+}
+
+} // namespace vanitas
@@ -4,16 +4,30 @@
 #include <filesystem>
 #include <iostream>
 #include <optional>
+#include <stdexcept>
 #include <toml.hpp>
 
+#include "commands/include/clean.hpp"
+#include "commands/include/client.hpp"
 #include "commands/include/file.hpp"
+#include "commands/include/grep.hpp"
 #include "commands/include/help.hpp"
 #include "commands/include/pipe.hpp"
 #include "commands/include/profile.hpp"
+#include "commands/include/replay.hpp"
 #include "commands/include/run.hpp"
+#include "commands/include/run_jobs.hpp"
+#include "commands/include/serve.hpp"
+#include "commands/include/tui.hpp"
+#include "options.hpp"
+#include "profile_detector.hpp"
 #include "vanitas/args_parser.hpp"
+#include "vanitas/classifier.hpp"
 #include "vanitas/config.hpp"
+#include "vanitas/profile_detect.hpp"
 #include "vanitas/profile_manager.hpp"
+#include "vanitas/profile_watcher.hpp"
+#include "vanitas/rule_order.hpp"
 
 namespace vanitas::cli {
 namespace fs = std::filesystem;
@@ -64,6 +78,36 @@ static std::optional<toml::value> try_parse_file(const fs::path &p)
     return r.unwrap();
 }
 
+static std::string join_names(const std::vector<std::string> &v)
+{
+    std::string out;
+    for (const auto &s : v) {
+        if (!out.empty())
+            out += ",";
+        out += s;
+    }
+    return out;
+}
+
+// --profile auto: the fallback first, then every other profile that compiles.
+static std::vector<vanitas::ProfileCandidate> auto_candidates(vanitas::ProfileManager &pm,
+                                                              const std::optional<toml::value> &cfgv,
+                                                              const std::string &fallback)
+{
+    std::vector<vanitas::ProfileCandidate> out;
+    out.push_back({fallback, std::make_shared<const vanitas::Profile>(pm.load_effective(fallback, cfgv))});
+    for (const auto &name : pm.profile_names(cfgv)) {
+        if (name == fallback || name == "auto")
+            continue;
+        try {
+            out.push_back({name, std::make_shared<const vanitas::Profile>(pm.load_effective(name, cfgv))});
+        } catch (const std::exception &e) {
+            std::cerr << "profile " << name << " skipped: " << e.what() << "\n";
+        }
+    }
+    return out;
+}
+
 static void print_list(const char *name, const std::vector<std::string> &v)
 {
     std::cout << name << " (" << v.size() << ")\n";
@@ -82,8 +126,17 @@ int CliApp::run(int argc, char *const argv[])
             std::exit(cmd.execute());
         }
 
+        if (args.mode == vanitas::Mode::Client) {
+            ClientCommand cmd(args);
+            std::exit(cmd.execute());
+        }
+
+        if (args.mode == vanitas::Mode::Clean) {
+            CleanCommand cmd(args);
+            std::exit(cmd.execute());
+        }
+
         vanitas::ProfileManager pm;
-        pm.ensure_default_profiles();
 
         if (args.mode == vanitas::Mode::ProfileList) {
             ProfileCommand cmd(args, pm);
@@ -95,12 +148,17 @@ int CliApp::run(int argc, char *const argv[])
         const std::string profile_name = args.profile.value_or(cfg.profile.value_or("default"));
 
         const char *profile_selected_src = args.profile ? "CLI --profile" : (cfg.profile ? "config.profile" : "default");
+        const bool auto_profile = profile_name == "auto";
+        const std::string fallback_name = cfg.profile && *cfg.profile != "auto" ? *cfg.profile : "default";
 
         if (args.dump_config) {
             std::cout << "Effective config\n";
             std::cout << "  profile = " << profile_name << " (source: " << profile_selected_src << ")\n";
             std::cout << "  color  = " << (cfg.color ? "true" : "false") << "\n";
             std::cout << "  format = " << cfg.format << "\n";
+            std::cout << "  only   = " << (args.only ? join_names(*args.only) : join_names(cfg.only)) << "\n";
+            std::cout << "  min_severity = " << args.min_severity.value_or(cfg.min_severity.value_or("")) << "\n";
+            std::cout << "  learn_rule_order = " << (cfg.learn_rule_order ? "true" : "false") << "\n";
             std::exit(0);
         }
 
@@ -108,6 +166,12 @@ int CliApp::run(int argc, char *const argv[])
             std::cout << "Selected profile: " << profile_name << " (source: " << profile_selected_src << ")\n";
 
             try {
+                if (auto_profile) {
+                    const auto candidates = auto_candidates(pm, cfgv, fallback_name);
+                    std::cout << "OK: " << candidates.size() << " candidates resolved and compiled, fallback "
+                              << fallback_name << "\n";
+                    std::exit(0);
+                }
                 (void)pm.load_effective(profile_name, cfgv);
                 std::cout << "OK: resolved and compiled (extends applied)\n";
                 std::exit(0);
@@ -117,24 +181,79 @@ int CliApp::run(int argc, char *const argv[])
             }
         }
 
-        vanitas::Profile prof = pm.load_effective(profile_name, cfgv);
+        if (auto_profile && (args.mode == vanitas::Mode::Serve || args.watch || args.jobs))
+            throw std::runtime_error("--profile auto does not work with serve, --watch or run -j");
+
+        if (args.mode == vanitas::Mode::Serve) {
+            int rc = 0;
+            {
+                vanitas::ProfileWatcher watcher(pm);
+                watcher.start();
+                auto loader = [&](const std::string &name) { return pm.load_effective(name, cfgv); };
+                rc = ServeCommand(args, loader, &watcher, cfg, profile_name).execute();
+            }
+            std::exit(rc);
+        }
+
+        std::shared_ptr<vanitas::ProfileSlot> prof;
+        std::shared_ptr<vanitas::RuleLearner> learner;
+        std::optional<ProfileDetector> detector;
+        if (auto_profile) {
+            auto candidates = auto_candidates(pm, cfgv, fallback_name);
+            prof = std::make_shared<vanitas::ProfileSlot>(candidates.front().profile);
+            detector.emplace(*prof, std::move(candidates));
+        } else {
+            vanitas::Profile p = pm.load_effective(profile_name, cfgv);
+            if (cfg.learn_rule_order) {
+                p.learner = std::make_shared<vanitas::RuleLearner>(
+                    vanitas::RuleLearner::file_for(pm.base_dir(), profile_name));
+                p.learner->load();
+            }
+            learner = p.learner;
+            prof = std::make_shared<vanitas::ProfileSlot>(std::make_shared<const vanitas::Profile>(std::move(p)));
+        }
+        ProfileDetector *detect = detector ? &*detector : nullptr;
+        const vanitas::Filter filter = resolve_filter(args, cfg);
+        const OutputOptions output = resolve_output(args, cfg);
+
+        std::optional<vanitas::ProfileWatcher> watcher;
+        if (args.watch) {
+            watcher.emplace(pm);
+            watcher->track(profile_name, prof);
+            watcher->start();
+        }
 
         int rc = 0;
         switch (args.mode) {
         case vanitas::Mode::File:
-            rc = FileCommand(args, prof).execute();
+            rc = FileCommand(args, *prof, filter, output, detect).execute();
             break;
         case vanitas::Mode::Pipe:
-            rc = PipeCommand(args, prof).execute();
+            rc = PipeCommand(args, *prof, filter, output, detect).execute();
             break;
         case vanitas::Mode::Run:
-            rc = RunCommand(args, prof).execute();
+            if (args.jobs)
+                rc = RunJobsCommand(args, *prof, filter, output).execute();
+            else
+                rc = RunCommand(args, *prof, filter, output, detect).execute();
+            break;
+        case vanitas::Mode::Replay:
+            rc = ReplayCommand(args, *prof, filter, output, detect).execute();
+            break;
+        case vanitas::Mode::Tui:
+            rc = TuiCommand(args, *prof, filter, detect).execute();
+            break;
+        case vanitas::Mode::Grep:
+            rc = GrepCommand(args, *prof, filter, output, pm.base_dir(), profile_name, detect).execute();
             break;
         default:
             rc = 2;
             break;
         }
 
+        watcher.reset();
+        if (learner)
+            learner->save();
         std::exit(rc);
     } catch (const std::exception &e) {
         std::cerr << e.what() << "\n";
@@ -0,0 +1,54 @@
+#include "baseline_diff.hpp"
+#include <iostream>
+#include <stdexcept>
+
+namespace vanitas::cli {
+
+static std::string type_names(unsigned types)
+{
+    std::string out;
+    for (auto [t, name] : {std::pair{vanitas::Type::Error, "error"}, {vanitas::Type::Warn, "warn"},
+                           {vanitas::Type::Tests, "tests"}, {vanitas::Type::Info, "info"}}) {
+        if (types & vanitas::type_bit(t))
+            out += (out.empty() ? "" : ",") + std::string(name);
+    }
+    return out;
+}
+
+BaselineDiff::BaselineDiff(const vanitas::Args &args, unsigned types)
+    : save_path_(args.save_baseline.value_or("")), save_(args.save_baseline), types_(types)
+{
+    if (!args.baseline)
+        return;
+    baseline_ = std::make_unique<vanitas::Baseline>(*args.baseline);
+    if (baseline_->types() != types)
+        throw std::runtime_error("Baseline " + *args.baseline + " holds " + type_names(baseline_->types()) +
+                                 " items, this run reports " + type_names(types) +
+                                 "; use the same --only/--min-severity/--histogram");
+}
+
+bool BaselineDiff::known(const vanitas::Item &it)
+{
+    const uint64_t fp = vanitas::fingerprint(it);
+    if (save_)
+        fps_.push_back(fp);
+
+    if (baseline_ && baseline_->contains(fp)) {
+        ++known_;
+        return true;
+    }
+    ++fresh_;
+    return false;
+}
+
+void BaselineDiff::finish()
+{
+    if (baseline_) {
+        std::cerr << "baseline: " << fresh_ << " new, " << known_ << " known, " << baseline_->unseen() << " gone (of "
+                  << baseline_->size() << ")\n";
+    }
+    if (save_)
+        vanitas::Baseline::save(save_path_, fps_, types_);
+}
+
+} // namespace vanitas::cli
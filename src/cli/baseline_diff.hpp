@@ -0,0 +1,41 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "vanitas/args_parser.hpp"
+#include "vanitas/baseline.hpp"
+#include "vanitas/classifier.hpp"
+
+namespace vanitas::cli {
+
+// --baseline / --save-baseline: which items a previous run already had, and
+// the fingerprints of this run for the next one. A baseline only speaks for
+// the item types it was saved with, so it is refused for others.
+class BaselineDiff
+{
+    public:
+        // types: those of the items known() sees
+        BaselineDiff(const vanitas::Args &args, unsigned types);
+
+        bool active() const { return baseline_ || save_; }
+
+        // Records the item for --save-baseline; true if the baseline has it.
+        bool known(const vanitas::Item &it);
+
+        // Prints the summary and saves.
+        void finish();
+
+    private:
+        std::unique_ptr<vanitas::Baseline> baseline_;
+        std::string save_path_;
+        bool save_ = false;
+        unsigned types_ = 0;
+
+        std::vector<uint64_t> fps_;
+        size_t known_ = 0;
+        size_t fresh_ = 0;
+};
+
+} // namespace vanitas::cli
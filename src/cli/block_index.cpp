@@ -0,0 +1,124 @@
+#include "block_index.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "vanitas/normalizer.hpp"
+#include "vanitas/pipeline.hpp"
+
+namespace vanitas::cli {
+
+static constexpr size_t read_chunk = 1024 * 1024;
+
+BlockIndex::BlockIndex(const std::string &path, const vanitas::ProfileSlot &slot, vanitas::Encoding enc)
+    : slot_(slot), enc_(enc)
+{
+    fd_ = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd_ < 0 || fstat(fd_, &st) != 0) {
+        const int e = errno;
+        if (fd_ >= 0)
+            close(fd_);
+        throw std::runtime_error("Cannot open file: " + path + ": " + std::strerror(e));
+    }
+    file_size_ = (uint64_t)st.st_size;
+
+    // every block takes at least one input byte
+    chunks_.resize(file_size_ / chunk_entries + 1);
+}
+
+BlockIndex::~BlockIndex()
+{
+    stop_ = true;
+    if (thread_.joinable())
+        thread_.join();
+    close(fd_);
+}
+
+void BlockIndex::start()
+{
+    thread_ = std::thread([this] { run(); });
+}
+
+uint64_t BlockIndex::end(size_t i) const
+{
+    if (i + 1 < size())
+        return offset(i + 1);
+    return done() ? file_size_ : scanned();
+}
+
+void BlockIndex::append(uint64_t offset, vanitas::Type t)
+{
+    const size_t n = size_.load(std::memory_order_relaxed);
+    auto &chunk = chunks_[n >> chunk_shift];
+    if (!chunk)
+        chunk = std::make_unique<uint64_t[]>(chunk_entries);
+    chunk[n & (chunk_entries - 1)] = offset << 2 | (uint64_t)t;
+    counts_[t].fetch_add(1, std::memory_order_relaxed);
+    size_.store(n + 1, std::memory_order_release);
+}
+
+void BlockIndex::run()
+{
+    vanitas::Pipeline pipeline(slot_, [this](const vanitas::Item &it) { append(it.offset, it.type); });
+    pipeline.decode(enc_.load(std::memory_order_relaxed));
+
+    std::string buf(read_chunk, '\0');
+    uint64_t pos = 0;
+    while (pos < file_size_ && !stop_.load(std::memory_order_relaxed)) {
+        const ssize_t n = pread(fd_, buf.data(), buf.size(), (off_t)pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        pipeline.feed(std::string_view(buf.data(), (size_t)n));
+        enc_.store(pipeline.encoding(), std::memory_order_relaxed);
+        pos += (uint64_t)n;
+        scanned_.store(pos, std::memory_order_relaxed);
+    }
+    pipeline.finish();
+    done_.store(true, std::memory_order_release);
+}
+
+std::string BlockIndex::read(uint64_t from, uint64_t to, size_t max) const
+{
+    std::string out;
+    if (to <= from)
+        return out;
+    out.resize((size_t)std::min<uint64_t>(to - from, max));
+
+    size_t got = 0;
+    while (got < out.size()) {
+        const ssize_t n = pread(fd_, out.data() + got, out.size() - got, (off_t)(from + got));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        got += (size_t)n;
+    }
+    out.resize(got);
+    return out;
+}
+
+std::vector<std::string> BlockIndex::lines(size_t i, size_t max_bytes) const
+{
+    std::vector<std::string> out;
+    vanitas::Decoder dec = decoder();
+    vanitas::Normalizer norm;
+    auto take = [&](const std::vector<vanitas::Event> &events) {
+        for (const auto &ev : events)
+            if (ev.kind == vanitas::EvKind::Line && !ev.text.empty())
+                out.emplace_back(ev.text);
+    };
+    const std::string raw = read(offset(i), end(i), max_bytes);
+    take(norm.feed(dec.feed(raw)));
+    take(norm.feed(dec.flush()));
+    take(norm.flush());
+    return out;
+}
+
+} // namespace vanitas::cli
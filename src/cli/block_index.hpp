@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vanitas/classifier.hpp"
+#include "vanitas/decoder.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas::cli {
+
+// Offsets and types of every block of a file, built on a background thread.
+// Only 8 bytes per block are kept; the text is read back from the file on demand.
+// Readers may use the index while it grows: entries below size() never change.
+class BlockIndex
+{
+    public:
+        // throws std::runtime_error when the file cannot be opened
+        BlockIndex(const std::string &path, const vanitas::ProfileSlot &slot,
+                   vanitas::Encoding enc = vanitas::Encoding::Auto);
+        ~BlockIndex();
+
+        BlockIndex(const BlockIndex &) = delete;
+        BlockIndex &operator=(const BlockIndex &) = delete;
+
+        void start();
+
+        size_t size() const { return size_.load(std::memory_order_acquire); }
+        bool done() const { return done_.load(std::memory_order_acquire); }
+        uint64_t file_size() const { return file_size_; }
+        uint64_t scanned() const { return scanned_.load(std::memory_order_relaxed); }
+        size_t count(vanitas::Type t) const { return counts_[t].load(std::memory_order_relaxed); }
+
+        uint64_t offset(size_t i) const { return entry(i) >> 2; }
+        vanitas::Type type(size_t i) const { return (vanitas::Type)(entry(i) & 3); }
+        // end of block i as far as it is known: the next block, or what has been read so far
+        uint64_t end(size_t i) const;
+
+        // raw bytes [from, to), at most max bytes
+        std::string read(uint64_t from, uint64_t to, size_t max) const;
+        // for text read back: decodes it as the index did
+        vanitas::Decoder decoder() const { return vanitas::Decoder(enc_.load(std::memory_order_relaxed)); }
+        // normalized, non-empty lines of block i
+        std::vector<std::string> lines(size_t i, size_t max_bytes) const;
+
+    private:
+        static constexpr size_t chunk_shift = 16;
+        static constexpr size_t chunk_entries = size_t(1) << chunk_shift;
+
+        int fd_ = -1;
+        uint64_t file_size_ = 0;
+        const vanitas::ProfileSlot &slot_;
+        std::atomic<vanitas::Encoding> enc_;
+
+        // sized for the worst case up front, so readers never see it move
+        std::vector<std::unique_ptr<uint64_t[]>> chunks_;
+        std::atomic<size_t> size_{0};
+        std::atomic<uint64_t> scanned_{0};
+        std::atomic<size_t> counts_[4] = {};
+        std::atomic<bool> done_{false};
+        std::atomic<bool> stop_{false};
+        std::thread thread_;
+
+        uint64_t entry(size_t i) const { return chunks_[i >> chunk_shift][i & (chunk_entries - 1)]; }
+        void append(uint64_t offset, vanitas::Type t);
+        void run();
+};
+
+} // namespace vanitas::cli
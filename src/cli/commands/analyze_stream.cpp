@@ -1,39 +1,45 @@
 #include "commands/include/analyze_stream.hpp"
 #include <vector>
 
-#include "vanitas/block_builder.hpp"
-#include "vanitas/classifier.hpp"
-#include "vanitas/normalizer.hpp"
+#include "vanitas/pipeline.hpp"
 
 namespace vanitas::cli {
 
-int analyze_stream(std::istream &in, const vanitas::Profile &prof)
+int analyze_stream(std::istream &in, const vanitas::ProfileSlot &prof, const vanitas::ContextOptions &ctx, Report &report,
+                   std::string_view sample, int fd)
 {
-    vanitas::Normalizer n;
-    vanitas::BlockBuilder builder(prof);
-    vanitas::Classifier clas(prof);
+    vanitas::LoadGovernor *governor = fd >= 0 ? report.governor() : nullptr;
+
+    vanitas::Pipeline pipeline(prof, report.sink(), report.filter(), ctx);
+    pipeline.track_tests(report.tests());
+    pipeline.tee_clean(report.clean());
+    pipeline.decode(report.encoding());
+    if (!sample.empty())
+        pipeline.feed(sample);
 
     std::vector<char> buf(4096);
 
-    while (in) {
+    while (in && !report.should_stop()) {
         in.read(buf.data(), buf.size());
         std::streamsize s = in.gcount();
         if (s <= 0)
             break;
 
-        auto events = n.feed(std::string_view(buf.data(), (size_t)s));
-        auto blocks = builder.push(events);
-        vanitas::print_items(clas.classify(blocks));
+        if (governor)
+            governor->begin();
+        pipeline.feed(std::string_view(buf.data(), (size_t)s));
+        if (governor) {
+            governor->end((size_t)s, pending_bytes(fd) + (size_t)in.rdbuf()->in_avail());
+            pipeline.shed(governor->level());
+        }
     }
 
-    auto tail_events = n.flush();
-    auto tail_blocks = builder.push(tail_events);
-    vanitas::print_items(clas.classify(tail_blocks));
-
-    auto tail_blocks2 = builder.flush();
-    vanitas::print_items(clas.classify(tail_blocks2));
+    if (report.should_stop() && !in.eof())
+        report.cut_short();
+    pipeline.finish();
+    report.finish(pipeline.counts());
 
-    return 0;
+    return report.exit_code(pipeline.counts());
 }
 
 } // namespace vanitas::cli
@@ -0,0 +1,60 @@
+#include "commands/include/clean.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+
+#include "vanitas/clean_writer.hpp"
+#include "vanitas/decoder.hpp"
+#include "vanitas/normalizer.hpp"
+
+namespace vanitas::cli {
+
+// Only the Decoder and the Normalizer run: no profile is loaded and nothing
+// is classified. Input is read a megabyte at a time, a file with the kernel
+// told it is read front to back.
+int CleanCommand::execute()
+{
+    const bool from_stdin = args.file.empty() || args.file == "-";
+    const int fd = from_stdin ? STDIN_FILENO : open(args.file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        std::cerr << "Cannot open file: " << args.file << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    if (!from_stdin)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const auto out = args.clean_output ? std::make_unique<vanitas::CleanWriter>(*args.clean_output)
+                                       : std::make_unique<vanitas::CleanWriter>(STDOUT_FILENO);
+    vanitas::Decoder decoder(args.encoding);
+    vanitas::Normalizer norm;
+
+    int rc = 0;
+    std::string buf(1024 * 1024, '\0');
+    for (;;) {
+        const ssize_t n = read(fd, buf.data(), buf.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            std::cerr << "Cannot read " << (from_stdin ? std::string("stdin") : args.file) << ": "
+                      << std::strerror(errno) << "\n";
+            rc = 1;
+            break;
+        }
+        if (n == 0)
+            break;
+        out->push(norm.feed(decoder.feed(std::string_view(buf.data(), (size_t)n))));
+    }
+    out->push(norm.feed(decoder.flush()));
+    out->push(norm.flush());
+    out->finish();
+
+    if (!from_stdin)
+        close(fd);
+    return rc;
+}
+
+} // namespace vanitas::cli
@@ -0,0 +1,171 @@
+#include "commands/include/client.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "stream_protocol.hpp"
+
+namespace vanitas::cli {
+
+static int connect_socket(const std::string &path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0)
+        return -1;
+    if (connect(fd, (sockaddr *)&addr, sizeof(addr)) != 0) {
+        int e = errno;
+        close(fd);
+        errno = e;
+        return -1;
+    }
+    return fd;
+}
+
+static bool write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0) {
+        ssize_t w = write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Forwards in_fd to the daemon and its answer to out_fd (or discards it when
+// out_fd < 0) until the daemon closes the stream. Returns the answer size, or -1.
+static long long stream_through(int in_fd, int sock, int out_fd)
+{
+    std::vector<char> buf(64 * 1024);
+    long long received = 0;
+    bool in_open = true;
+
+    while (true) {
+        pollfd fds[2] = {{sock, POLLIN, 0}, {in_fd, POLLIN, 0}};
+        int n = poll(fds, in_open ? 2 : 1, -1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return -1;
+
+        if (fds[0].revents & (POLLIN | POLLHUP | POLLERR)) {
+            ssize_t r = read(sock, buf.data(), buf.size());
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0)
+                return r == 0 ? received : -1;
+            received += r;
+            if (out_fd >= 0 && !write_all(out_fd, buf.data(), (size_t)r))
+                return -1;
+        }
+
+        if (in_open && (fds[1].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t r = read(in_fd, buf.data(), buf.size());
+            if (r < 0 && errno == EINTR)
+                continue;
+            if (r <= 0) {
+                in_open = false;
+                shutdown(sock, SHUT_WR);
+            } else if (!write_all(sock, buf.data(), (size_t)r)) {
+                // the daemon gave up on the stream; still print what it said
+                in_open = false;
+            }
+        }
+    }
+}
+
+int ClientCommand::execute()
+{
+    signal(SIGPIPE, SIG_IGN);
+
+    if (args.bench > 0)
+        return bench();
+
+    const std::string path = args.socket.empty() ? default_socket_path() : args.socket;
+    int sock = connect_socket(path);
+    if (sock < 0) {
+        std::cerr << "client: cannot connect to " << path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    const std::string header = make_stream_header(args);
+    if (!write_all(sock, header.data(), header.size())) {
+        std::cerr << "client: write failed: " << std::strerror(errno) << "\n";
+        close(sock);
+        return 1;
+    }
+
+    long long r = stream_through(STDIN_FILENO, sock, STDOUT_FILENO);
+    close(sock);
+    return r < 0 ? 1 : 0;
+}
+
+// Load generator: N concurrent streams of the same file through one daemon.
+int ClientCommand::bench()
+{
+    const std::string path = args.socket.empty() ? default_socket_path() : args.socket;
+    const std::string header = make_stream_header(args);
+
+    std::atomic<size_t> failed{0};
+    std::atomic<long long> in_bytes{0};
+    std::atomic<long long> out_bytes{0};
+
+    const auto t0 = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    threads.reserve(args.bench);
+    for (size_t i = 0; i < args.bench; ++i) {
+        threads.emplace_back([&] {
+            int in = open(args.file.c_str(), O_RDONLY | O_CLOEXEC);
+            int sock = in < 0 ? -1 : connect_socket(path);
+            long long r = -1;
+            if (sock >= 0 && write_all(sock, header.data(), header.size()))
+                r = stream_through(in, sock, -1);
+            if (r < 0) {
+                ++failed;
+            } else {
+                out_bytes += r;
+                in_bytes += lseek(in, 0, SEEK_CUR);
+            }
+            if (sock >= 0)
+                close(sock);
+            if (in >= 0)
+                close(in);
+        });
+    }
+    for (auto &t : threads)
+        t.join();
+
+    const double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    const double mib = (double)in_bytes / (1024.0 * 1024.0);
+
+    std::cout << "streams:    " << args.bench << " (" << failed << " failed)\n";
+    std::cout << "input:      " << mib << " MiB\n";
+    std::cout << "output:     " << (double)out_bytes / (1024.0 * 1024.0) << " MiB\n";
+    std::cout << "elapsed:    " << secs << " s\n";
+    std::cout << "throughput: " << mib / secs << " MiB/s\n";
+    return failed ? 1 : 0;
+}
+
+} // namespace vanitas::cli
@@ -1,18 +1,100 @@
 #include "commands/include/file.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
 #include <fstream>
 #include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "commands/include/analyze_stream.hpp"
+#include "file_window.hpp"
+#include "options.hpp"
+#include "vanitas/pipeline.hpp"
 
 namespace vanitas::cli {
 int FileCommand::execute()
 {
+    const vanitas::ContextOptions ctx = context_options(args);
+    Report report(args, filter_, output_);
+    if (args.tail_bytes || args.tail_blocks || args.range || report.since() || report.until()) {
+        if (detector_) {
+            std::ifstream head(args.file, std::ios::binary);
+            detector_->choose(read_sample(head));
+        }
+        report.check_timestamps(*prof_.load());
+        return analyze_window(ctx, report);
+    }
+
     std::ifstream file(args.file, std::ios::binary);
     if (!file) {
         std::cerr << "Cannot open file: " << args.file << "\n";
         return 1;
     }
 
-    return analyze_stream(file, prof_);
+    std::string sample;
+    if (detector_) {
+        sample = read_sample(file);
+        detector_->choose(sample);
+    }
+    report.check_timestamps(*prof_.load());
+    return analyze_stream(file, prof_, ctx, report, sample);
+}
+
+// Only the bytes of the window are read, whatever the size of the file.
+// --since/--until find theirs by binary search, taking the file to be in time order.
+int FileCommand::analyze_window(const vanitas::ContextOptions &ctx, Report &report)
+{
+    if (args.encoding == vanitas::Encoding::Utf16le || args.encoding == vanitas::Encoding::Utf16be)
+        throw std::runtime_error("--tail-bytes, --tail-blocks, --range, --since and --until need UTF-8 or Latin-1 input");
+
+    const int fd = open(args.file.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        std::cerr << "Cannot open file: " << args.file << ": " << std::strerror(errno) << "\n";
+        if (fd >= 0)
+            close(fd);
+        return 1;
+    }
+
+    const auto prof = prof_.load();
+    const FileWindow win(fd, (uint64_t)st.st_size, *prof);
+    ByteRange r;
+    if (args.range)
+        r = win.range(args.range->first, args.range->second);
+    else if (args.tail_blocks)
+        r = win.tail_blocks(args.tail_blocks);
+    else if (args.tail_bytes)
+        r = win.tail_bytes(args.tail_bytes);
+    else
+        r = win.time_range(report.since(), report.until());
+
+    vanitas::Pipeline pipeline(prof, report.sink(), report.filter(), ctx);
+    pipeline.track_tests(report.tests());
+    pipeline.tee_clean(report.clean());
+    pipeline.decode(report.encoding());
+    pipeline.seek(r.begin, win.line_at(r.begin));
+
+    std::string buf(1024 * 1024, '\0');
+    uint64_t pos = r.begin;
+    while (pos < r.end) {
+        const ssize_t n = pread(fd, buf.data(), (size_t)std::min<uint64_t>(buf.size(), r.end - pos), (off_t)pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        pipeline.feed(std::string_view(buf.data(), (size_t)n));
+        pos += (uint64_t)n;
+        if (report.should_stop())
+            break;
+    }
+    if (report.should_stop() && pos < r.end)
+        report.cut_short();
+    pipeline.finish();
+    close(fd);
+
+    report.finish(pipeline.counts());
+    return report.exit_code(pipeline.counts());
 }
 } // namespace vanitas::cli
@@ -0,0 +1,337 @@
+#include "commands/include/grep.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <future>
+#include <iostream>
+#include <string>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "vanitas/decoder.hpp"
+#include "vanitas/pipeline.hpp"
+#include "vanitas/trigram_index.hpp"
+
+namespace vanitas::cli {
+namespace fs = std::filesystem;
+
+namespace {
+
+constexpr uint64_t piece_bytes = 64ull << 20; // indexed by one thread, as one segment
+constexpr uint64_t min_update = 1ull << 20;   // less new input than this is scanned, not indexed
+constexpr uint64_t merge_gap = 4096;          // candidates closer than this are read in one go
+constexpr size_t identity_bytes = 4096;
+constexpr size_t flush_bytes = 1024 * 1024;
+
+std::string read_at(int fd, uint64_t pos, size_t n)
+{
+    std::string out(n, '\0');
+    size_t got = 0;
+    while (got < n) {
+        const ssize_t r = pread(fd, out.data() + got, n - got, (off_t)(pos + got));
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        got += (size_t)r;
+    }
+    out.resize(got);
+    return out;
+}
+
+// Returns the newlines read.
+uint64_t feed_range(int fd, vanitas::Pipeline &p, uint64_t begin, uint64_t end)
+{
+    uint64_t newlines = 0;
+    std::string buf((size_t)std::min<uint64_t>(1024 * 1024, end - begin), '\0');
+    for (uint64_t pos = begin; pos < end;) {
+        const ssize_t n = pread(fd, buf.data(), (size_t)std::min<uint64_t>(buf.size(), end - pos), (off_t)pos);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        p.feed(std::string_view(buf.data(), (size_t)n));
+        newlines += (uint64_t)std::count(buf.data(), buf.data() + n, '\n');
+        pos += (uint64_t)n;
+    }
+    p.finish();
+    return newlines;
+}
+
+uint64_t identity_of(std::string_view head)
+{
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (const unsigned char c : head) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+bool has_literal(std::string_view raw, std::string_view literal, bool icase)
+{
+    if (!icase)
+        return raw.find(literal) != std::string_view::npos;
+    const auto lower = [](unsigned char c) { return c >= 'A' && c <= 'Z' ? (char)(c | 0x20) : (char)c; };
+    return std::search(raw.begin(), raw.end(), literal.begin(), literal.end(),
+                       [&](char x, char y) { return lower((unsigned char)x) == lower((unsigned char)y); }) != raw.end();
+}
+
+// Drops the candidates whose input lacks the literal, for an ASCII literal. A
+// block without escape sequences or carriage returns is its own clean text,
+// so it cannot match; the others are left to the pipeline. Neighbours in a
+// candidate group are mostly turned down here without being classified.
+std::vector<vanitas::IndexedBlock> with_literal(int fd, const std::vector<vanitas::IndexedBlock> &cands,
+                                                std::string_view literal, bool icase)
+{
+    std::vector<vanitas::IndexedBlock> out;
+    for (size_t i = 0; i < cands.size();) {
+        size_t j = i + 1;
+        while (j < cands.size() && cands[j].offset == cands[j - 1].end)
+            ++j;
+        const uint64_t from = cands[i].offset;
+        const std::string raw = read_at(fd, from, (size_t)(cands[j - 1].end - from));
+        for (; i < j; ++i) {
+            const std::string_view b =
+                std::string_view(raw).substr((size_t)(cands[i].offset - from), (size_t)(cands[i].end - cands[i].offset));
+            if (b.find_first_of("\x1b\r") != std::string_view::npos || has_literal(b, literal, icase))
+                out.push_back(cands[i]);
+        }
+    }
+    return out;
+}
+
+struct Piece
+{
+        uint64_t begin = 0;
+        uint64_t end = 0;
+        uint64_t lines = 0;
+        std::string segment;
+};
+
+// The cases of one piece as a segment, lines counted from its start. The input
+// may still be written to, so the final case of the last piece is left for a
+// later update.
+void index_piece(int fd, const vanitas::ProfilePtr &prof, vanitas::Encoding enc, Piece &pc, bool last,
+                 uint64_t profile, uint64_t identity)
+{
+    vanitas::TrigramSegment seg;
+    std::string held;
+    uint64_t held_offset = 0, held_line = 1;
+    vanitas::Type held_type = vanitas::Type::Info;
+    bool holding = false;
+
+    vanitas::Pipeline p(prof, [&](const vanitas::Item &it) {
+        if (holding)
+            seg.add(held_offset, (uint32_t)(held_line - 1), held_type, held);
+        held.assign(it.details.empty() ? it.text : it.details);
+        held_offset = it.offset;
+        held_line = it.line;
+        held_type = it.type;
+        holding = true;
+    });
+    p.decode(enc);
+    p.seek(pc.begin, 1);
+    pc.lines = feed_range(fd, p, pc.begin, pc.end);
+
+    uint64_t end = pc.end;
+    if (holding && last) {
+        end = held_offset;
+        pc.lines = held_line - 1;
+    } else if (holding) {
+        seg.add(held_offset, (uint32_t)(held_line - 1), held_type, held);
+    }
+    if (end > pc.begin)
+        seg.write(pc.segment, profile, identity, pc.begin, end, 0, pc.lines);
+}
+
+} // namespace
+
+// Cases are found in the index by the trigrams of the text the pattern
+// requires, then read back from the log and matched; what the index does not
+// cover yet is matched as it is read.
+int GrepCommand::execute()
+{
+    if (args.encoding == vanitas::Encoding::Utf16le || args.encoding == vanitas::Encoding::Utf16be)
+        throw std::runtime_error("vanitas grep needs UTF-8 or Latin-1 input");
+
+    fd_ = open(args.file.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st{};
+    if (fd_ < 0 || fstat(fd_, &st) != 0) {
+        std::cerr << "Cannot open file: " << args.file << ": " << std::strerror(errno) << "\n";
+        if (fd_ >= 0)
+            close(fd_);
+        return 2; // 1 is for nothing found
+    }
+    size_ = (uint64_t)st.st_size;
+
+    const std::string sample = read_at(fd_, 0, ProfileDetector::sample_bytes);
+    if (args.encoding == vanitas::Encoding::Auto) {
+        vanitas::Decoder probe;
+        probe.feed(sample);
+        if (probe.encoding() == vanitas::Encoding::Utf16le || probe.encoding() == vanitas::Encoding::Utf16be)
+            throw std::runtime_error("vanitas grep needs UTF-8 or Latin-1 input");
+    }
+    if (detector_)
+        detector_->choose(sample);
+
+    re_ = std::regex(args.pattern, args.ignore_case ? std::regex::ECMAScript | std::regex::icase : std::regex::ECMAScript);
+    const std::string literal = vanitas::Rule(args.pattern).literal;
+
+    uint64_t covered = 0, covered_line = 1;
+    std::vector<vanitas::IndexedBlock> cands;
+    // Blocks of interleaved sources are not stretches of the file.
+    const auto prof = prof_.load();
+    if (!args.no_index && !prof->source.enabled()) {
+        const uint64_t profile = vanitas::profile_hash(*prof);
+        const uint64_t identity = identity_of(std::string_view(sample).substr(0, identity_bytes));
+        const fs::path index =
+            vanitas::TrigramIndex::file_for(base_dir_, fs::absolute(args.file).string(), profile_name_);
+
+        update(index, FileWindow(fd_, size_, *prof), profile, identity);
+        const vanitas::TrigramIndex idx(index);
+        if (idx.matches(profile, identity) && idx.end() <= size_) {
+            covered = idx.end();
+            covered_line = idx.end_line();
+            if (literal.size() >= 3) {
+                cands = idx.candidates(vanitas::trigrams(literal));
+                if (std::all_of(literal.begin(), literal.end(), [](char c) { return (unsigned char)c < 0x80; }))
+                    cands = with_literal(fd_, cands, literal, args.ignore_case);
+            } else {
+                std::cerr << "WARN: the pattern has no text of 3 or more characters to look up, every case is read\n";
+                cands = idx.all();
+            }
+        }
+    }
+
+    for (size_t i = 0; i < cands.size();) {
+        if (!filter_.wants(cands[i].type)) {
+            ++i;
+            continue;
+        }
+        const uint64_t begin = cands[i].offset, line = cands[i].line;
+        uint64_t end = cands[i].end;
+        for (++i; i < cands.size() && cands[i].offset - end < merge_gap; ++i) {
+            if (filter_.wants(cands[i].type))
+                end = cands[i].end;
+        }
+        scan(begin, end, line);
+    }
+    scan(covered, size_, covered_line);
+    close(fd_);
+
+    if (filter_.count_only)
+        out_ += std::to_string(matches_) + "\n";
+    std::cout << out_;
+    return matches_ ? 0 : 1;
+}
+
+// Appends segments for what was added to the log since the last update, or
+// writes the index anew when the log or the profile is not the one it was
+// built from. Pieces of the input are indexed in parallel.
+void GrepCommand::update(const fs::path &index, const FileWindow &win, uint64_t profile, uint64_t identity)
+{
+    uint64_t from = 0, keep = 0, line = 1;
+    {
+        const vanitas::TrigramIndex idx(index);
+        if (!args.reindex && !idx.empty() && idx.matches(profile, identity) && idx.end() <= size_) {
+            from = idx.end();
+            keep = idx.valid_bytes();
+            line = idx.end_line();
+        }
+    }
+    if (size_ - from < min_update)
+        return;
+
+    std::vector<Piece> pieces;
+    for (uint64_t b = from; b < size_;) {
+        uint64_t e = b + piece_bytes < size_ ? win.range(b + piece_bytes, size_).begin : size_;
+        if (e <= b) // a single block longer than a piece
+            e = size_;
+        pieces.push_back({b, e, 0, {}});
+        b = e;
+    }
+
+    std::error_code ec;
+    fs::create_directories(index.parent_path(), ec);
+    const fs::path dst = keep ? index : fs::path(index.string() + ".tmp");
+    if (keep) {
+        fs::resize_file(index, keep, ec); // drops a segment cut short
+        if (ec) {
+            std::cerr << "WARN: cannot write " << index.string() << ": " << ec.message() << "\n";
+            return;
+        }
+    }
+    std::ofstream out(dst, std::ios::binary | (keep ? std::ios::app : std::ios::trunc));
+    if (!out) {
+        std::cerr << "WARN: cannot write " << dst.string() << "\n";
+        return;
+    }
+
+    const auto prof = prof_.load();
+    const size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t k = 0; k < pieces.size(); k += threads) {
+        const size_t n = std::min(threads, pieces.size() - k);
+        std::vector<std::future<void>> wave;
+        for (size_t j = k; j < k + n; ++j) {
+            wave.push_back(std::async(std::launch::async, [&, j] {
+                index_piece(fd_, prof, args.encoding, pieces[j], j + 1 == pieces.size(), profile, identity);
+            }));
+        }
+        for (auto &f : wave)
+            f.get();
+        for (size_t j = k; j < k + n; ++j) {
+            if (pieces[j].segment.empty())
+                continue;
+            vanitas::TrigramSegment::set_line(pieces[j].segment, line);
+            line += pieces[j].lines;
+            out << pieces[j].segment;
+            pieces[j].segment = std::string();
+        }
+    }
+    out.close();
+    if (!out) {
+        std::cerr << "WARN: cannot write " << dst.string() << "\n";
+        return;
+    }
+    if (!keep) {
+        fs::rename(dst, index, ec);
+        if (ec)
+            std::cerr << "WARN: cannot write " << index.string() << ": " << ec.message() << "\n";
+    }
+}
+
+void GrepCommand::scan(uint64_t begin, uint64_t end, uint64_t line)
+{
+    if (begin >= end)
+        return;
+
+    vanitas::Pipeline p(
+        prof_.load(),
+        [&](const vanitas::Item &it) {
+            const std::string_view text = it.details.empty() ? it.text : it.details;
+            if (!std::regex_search(text.begin(), text.end(), re_))
+                return;
+            ++matches_;
+            if (filter_.count_only)
+                return;
+            vanitas::Item whole = it;
+            if (output_.format == Format::Text)
+                whole.text = text;
+            format_item(out_, whole, output_);
+            if (out_.size() >= flush_bytes) {
+                std::cout << out_;
+                out_.clear();
+            }
+        },
+        vanitas::Filter{filter_.types, false});
+    p.decode(args.encoding);
+    p.seek(begin, line);
+    feed_range(fd_, p, begin, end);
+}
+
+} // namespace vanitas::cli
@@ -9,15 +9,77 @@ int HelpCommand::execute()
               << "\n"
               << "Usage:\n"
               << "  vanitas help\n"
-              << "  vanitas file <path>\n"
-              << "  vanitas pipe\n"
-              << "  vanitas run -- <cmd> [args...]\n"
+              << "  vanitas file [opts] <path>\n"
+              << "  vanitas pipe [opts]\n"
+              << "  vanitas run [opts] -- <cmd> [args...]\n"
+              << "  vanitas run -j <N> [opts] [--job-file <path>] [-- <cmd> [args...]]...\n"
+              << "  vanitas serve [--socket <path>] [--workers <N>]\n"
+              << "  vanitas client [--socket <path>] [opts]\n"
+              << "  vanitas tui [opts] <path>\n"
+              << "  vanitas replay [--speed <X>|--as-fast-as-possible] [opts] <file.vrec>\n"
+              << "  vanitas clean [--encoding <enc>] [-o <file>] [<path>|-]\n"
+              << "  vanitas grep [opts] <pattern> <path>\n"
               << "\n"
               << "Commands:\n"
               << "  help   Show this help.\n"
               << "  file   Analyze a file.\n"
               << "  pipe   Analyze stdin.\n"
               << "  run    Run a command and analyze its output (stdout+stderr).\n"
+              << "         --record <file.vrec> also saves the raw output with its timing.\n"
+              << "         -j <N> runs many commands, N at once: each `--` starts the next one, and\n"
+              << "         --job-file adds one shell line per command. Items are printed per command,\n"
+              << "         followed by a table of exit codes and counts.\n"
+              << "  serve  Daemon: analyze many client streams over a Unix socket.\n"
+              << "  client Send stdin to a running daemon and print its analysis.\n"
+              << "         --bench <N> <file> streams <file> N times concurrently (load test).\n"
+              << "  tui    Browse a file interactively: j/k move, n/N next/prev error or warning,\n"
+              << "         Enter show block, f cycle severity filter, / search, q quit.\n"
+              << "  replay Analyze a recording again, as fast as possible or at --speed X of its pace.\n"
+              << "  clean  Write a file or stdin without escape sequences and with '\\r' overwrites collapsed,\n"
+              << "         to stdout or -o <file>. Nothing is classified.\n"
+              << "  grep   Print the whole cases (blocks) of a file that match a regex, with their type. A\n"
+              << "         trigram index kept under ~/.vanitas/cache/grep narrows what is read; it is built\n"
+              << "         on first use and extended as the file grows. -i ignores case, --no-index reads\n"
+              << "         the whole file, --reindex builds the index anew, -e <pattern> takes one that starts\n"
+              << "         with -. Of the analysis options it takes\n"
+              << "         --profile, --only, --min-severity, --count, --format, -n and --encoding.\n"
+              << "         Exits with 1 if nothing matched.\n"
+              << "\n"
+              << "Analysis options (file, pipe, run, replay):\n"
+              << "  --profile <name>          Profile name or path; auto picks the one that best fits the input.\n"
+              << "  --only <types>            Comma list of error,warn,tests,info to report.\n"
+              << "  --min-severity <type>     Report this severity and above (info < tests < warn < error).\n"
+              << "  --count                   Print only per-type counts.\n"
+              << "  -B <N> / -A <N> / -C <N>  Show N blocks of context before/after/around errors and warnings.\n"
+              << "  --context-lines           Measure -B/-A/-C in lines instead of blocks.\n"
+              << "  --format <fmt>            text (default), json (one object per item) or quickfix (file:line:col).\n"
+              << "  -n, --line-number         Prefix text items with their line in the input.\n"
+              << "  --encoding <enc>          auto (default: BOM, or UTF-16 by its NULs, else UTF-8), utf-8,\n"
+              << "                            utf-16le, utf-16be or latin1. Invalid bytes become U+FFFD.\n"
+              << "  --watch                   Reload the profile when its files change (serve always does).\n"
+              << "  --save-baseline <f.vfp>   Record the fingerprints of this run's items (file, pipe, run).\n"
+              << "  --baseline <f.vfp>        Report only items not in that baseline, and how many are gone.\n"
+              << "  --fail-fast[=N]           Stop reading after N errors (default 1) and exit with 4.\n"
+              << "  --fail-signal <SIG>       run: signal for the command's process group on --fail-fast (TERM).\n"
+              << "  --exit-on-error           Exit with 3 if errors were reported (run: when the command succeeded).\n"
+              << "  --since <time>            Report only blocks stamped at or after <time>: ISO-8601 (UTC),\n"
+              << "                            @<epoch seconds>, now, or relative like -2h.\n"
+              << "  --until <time>            Report only blocks stamped before <time>.\n"
+              << "  --histogram <interval>    Print errors and warnings per interval (30s, 5m, 1h, 1d) instead.\n"
+              << "                            These three need a profile with a [timestamp] format.\n"
+              << "  --test-summary            Follow gtest, pytest and ctest results and end with the failed tests\n"
+              << "                            and their output, flaky and slowest tests.\n"
+              << "  --shed-after <s>[,s,s,s]  pipe, run: when input has been waiting s seconds behind, skip\n"
+              << "                            tests rules, then info items, then most, then all warn rules (2s,\n"
+              << "                            4s, 8s unless given). Errors are always found; a summary says what was shed.\n"
+              << "  --tee-clean <file>        Also write the input as `vanitas clean` would (not with run -j).\n"
+              << "\n"
+              << "File window options (file):\n"
+              << "  --tail-bytes <N>          Analyze only about the last N bytes (K/M/G suffixes).\n"
+              << "  --tail-blocks <N>         Analyze only the last N blocks.\n"
+              << "  --range <START:END>       Analyze bytes START..END; either side may be empty.\n"
+              << "                            Windows are widened so that no block is cut.\n"
+              << "                            --since/--until also select a window if the file is in time order.\n"
               << "\n";
     return 0;
 }
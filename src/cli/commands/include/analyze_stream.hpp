@@ -2,9 +2,16 @@
 #pragma once
 
 #include <istream>
+#include <string_view>
 
-#include "vanitas/profile.hpp"
+#include "report.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile_slot.hpp"
 
 namespace vanitas::cli {
-int analyze_stream(std::istream &in, const vanitas::Profile &prof);
+// Stops reading early on --fail-fast; returns the exit code. sample is input
+// already taken from in (for --profile auto) and is analyzed first. fd is the
+// descriptor in reads, when --shed-after needs to see what waits in it.
+int analyze_stream(std::istream &in, const vanitas::ProfileSlot &prof, const vanitas::ContextOptions &ctx, Report &report,
+                   std::string_view sample = {}, int fd = -1);
 }
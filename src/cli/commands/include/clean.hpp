@@ -0,0 +1,16 @@
+#pragma once
+
+#include "command.hpp"
+#include "vanitas/args_parser.hpp"
+
+namespace vanitas::cli {
+class CleanCommand final : public ICommand
+{
+    public:
+        explicit CleanCommand(const vanitas::Args &a) : args(a) {}
+        int execute() override;
+
+    private:
+        const vanitas::Args &args;
+};
+} // namespace vanitas::cli
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "command.hpp"
+#include "vanitas/args_parser.hpp"
+
+namespace vanitas::cli {
+class ClientCommand final : public ICommand
+{
+    public:
+        explicit ClientCommand(const vanitas::Args &a) : args(a) {}
+        int execute() override;
+
+    private:
+        const vanitas::Args &args;
+
+        int bench();
+};
+} // namespace vanitas::cli
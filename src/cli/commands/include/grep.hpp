@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <regex>
+#include <string>
+
+#include "command.hpp"
+#include "file_window.hpp"
+#include "output.hpp"
+#include "profile_detector.hpp"
+#include "vanitas/args_parser.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas::cli {
+class GrepCommand final : public ICommand
+{
+    public:
+        explicit GrepCommand(const vanitas::Args &a, const vanitas::ProfileSlot &prof, const vanitas::Filter &filter,
+                             const OutputOptions &output, std::filesystem::path base_dir, std::string profile_name,
+                             ProfileDetector *detector = nullptr)
+            : args(a), prof_(prof), filter_(filter), output_(output), base_dir_(std::move(base_dir)),
+              profile_name_(std::move(profile_name)), detector_(detector)
+        {
+        }
+        int execute() override;
+
+    private:
+        const vanitas::Args &args;
+        const vanitas::ProfileSlot &prof_;
+        const vanitas::Filter &filter_;
+        const OutputOptions &output_;
+        std::filesystem::path base_dir_;
+        std::string profile_name_;
+        ProfileDetector *detector_; // --profile auto
+
+        int fd_ = -1;
+        uint64_t size_ = 0;
+        std::regex re_;
+        size_t matches_ = 0;
+        std::string out_;
+
+        void update(const std::filesystem::path &index, const FileWindow &win, uint64_t profile, uint64_t identity);
+        // Cases of [begin, end) that match; begin starts a block, on line.
+        void scan(uint64_t begin, uint64_t end, uint64_t line);
+};
+} // namespace vanitas::cli
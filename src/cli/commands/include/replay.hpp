@@ -0,0 +1,28 @@
+#pragma once
+
+#include "command.hpp"
+#include "output.hpp"
+#include "profile_detector.hpp"
+#include "vanitas/args_parser.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas::cli {
+class ReplayCommand final : public ICommand
+{
+    public:
+        explicit ReplayCommand(const vanitas::Args &a, const vanitas::ProfileSlot &prof, const vanitas::Filter &filter,
+                               const OutputOptions &output, ProfileDetector *detector = nullptr)
+            : args(a), prof_(prof), filter_(filter), output_(output), detector_(detector)
+        {
+        }
+        int execute() override;
+
+    private:
+        const vanitas::Args &args;
+        const vanitas::ProfileSlot &prof_;
+        const vanitas::Filter &filter_;
+        const OutputOptions &output_;
+        ProfileDetector *detector_; // --profile auto
+};
+} // namespace vanitas::cli
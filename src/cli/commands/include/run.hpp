@@ -1,19 +1,29 @@
 #pragma once
 
 #include "command.hpp"
+#include "output.hpp"
+#include "profile_detector.hpp"
 #include "vanitas/args_parser.hpp"
-#include "vanitas/profile.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile_slot.hpp"
 
 namespace vanitas::cli {
 
 class RunCommand final : public ICommand
 {
     public:
-        explicit RunCommand(const vanitas::Args &a, const vanitas::Profile &prof) : args(a), prof_(prof) {}
+        explicit RunCommand(const vanitas::Args &a, const vanitas::ProfileSlot &prof, const vanitas::Filter &filter,
+                             const OutputOptions &output, ProfileDetector *detector = nullptr)
+            : args(a), prof_(prof), filter_(filter), output_(output), detector_(detector)
+        {
+        }
         int execute() override;
 
     private:
         const vanitas::Args &args;
-        const vanitas::Profile &prof_;
+        const vanitas::ProfileSlot &prof_;
+        const vanitas::Filter &filter_;
+        const OutputOptions &output_;
+        ProfileDetector *detector_; // --profile auto
 };
 } // namespace vanitas::cli
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "command.hpp"
+#include "output.hpp"
+#include "vanitas/args_parser.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas::cli {
+
+// run -j N: many commands, up to N at once, all through the one loaded profile.
+class RunJobsCommand final : public ICommand
+{
+    public:
+        explicit RunJobsCommand(const vanitas::Args &a, const vanitas::ProfileSlot &prof, const vanitas::Filter &filter,
+                                const OutputOptions &output)
+            : args(a), prof_(prof), filter_(filter), output_(output)
+        {
+        }
+        int execute() override;
+
+    private:
+        const vanitas::Args &args;
+        const vanitas::ProfileSlot &prof_;
+        const vanitas::Filter &filter_;
+        const OutputOptions &output_;
+};
+} // namespace vanitas::cli
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+#include "command.hpp"
+#include "vanitas/args_parser.hpp"
+#include "vanitas/config.hpp"
+#include "vanitas/profile.hpp"
+#include "vanitas/profile_watcher.hpp"
+
+namespace vanitas::cli {
+
+using ProfileLoader = std::function<vanitas::Profile(const std::string &name)>;
+
+class ServeCommand final : public ICommand
+{
+    public:
+        // watcher may be null; otherwise every profile a stream asks for is tracked by it
+        explicit ServeCommand(const vanitas::Args &a, ProfileLoader loader, vanitas::ProfileWatcher *watcher,
+                              const vanitas::Config &cfg, std::string default_profile)
+            : args(a), loader_(std::move(loader)), watcher_(watcher), cfg_(cfg), default_profile_(std::move(default_profile))
+        {
+        }
+        int execute() override;
+
+    private:
+        const vanitas::Args &args;
+        ProfileLoader loader_;
+        vanitas::ProfileWatcher *watcher_;
+        const vanitas::Config &cfg_;
+        std::string default_profile_;
+};
+} // namespace vanitas::cli
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "command.hpp"
+#include "profile_detector.hpp"
+#include "vanitas/args_parser.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas::cli {
+class TuiCommand final : public ICommand
+{
+    public:
+        explicit TuiCommand(const vanitas::Args &a, const vanitas::ProfileSlot &prof, const vanitas::Filter &filter,
+                            ProfileDetector *detector = nullptr)
+            : args(a), prof_(prof), filter_(filter), detector_(detector)
+        {
+        }
+        int execute() override;
+
+    private:
+        const vanitas::Args &args;
+        const vanitas::ProfileSlot &prof_;
+        const vanitas::Filter &filter_;
+        ProfileDetector *detector_; // --profile auto
+};
+} // namespace vanitas::cli
@@ -1,8 +1,26 @@
 #include "commands/include/pipe.hpp"
 #include <iostream>
+#include <string>
+#include <unistd.h>
 
 #include "commands/include/analyze_stream.hpp"
+#include "options.hpp"
 
 namespace vanitas::cli {
-int PipeCommand::execute() { return vanitas::cli::analyze_stream(std::cin, prof_); }
+int PipeCommand::execute()
+{
+    const vanitas::ContextOptions ctx = context_options(args);
+    Report report(args, filter_, output_);
+
+    // taken from the descriptor before std::cin buffers anything
+    std::string sample;
+    if (detector_) {
+        sample = read_sample(STDIN_FILENO);
+        detector_->choose(sample);
+    }
+    report.check_timestamps(*prof_.load());
+    if (report.governor())
+        widen_pipe(STDIN_FILENO);
+    return vanitas::cli::analyze_stream(std::cin, prof_, ctx, report, sample, STDIN_FILENO);
+}
 } // namespace vanitas::cli
@@ -8,6 +8,7 @@
 #include <utility>
 #include <vector>
 
+#include "vanitas/builtin_profiles.hpp"
 #include "vanitas/config.hpp"
 
 namespace vanitas::cli {
@@ -89,6 +90,21 @@ int ProfileCommand::execute()
         }
     }
 
+    std::unordered_set<std::string> file_set;
+    for (const auto &fp : file_profiles)
+        file_set.insert(fp.first);
+
+    std::cout << "\nBuilt-in:\n";
+    for (const auto &b : vanitas::builtin_profiles()) {
+        const std::string name(b.name);
+        std::cout << "  - " << name << " (" << b.about << ")";
+        if (inline_set.count(name))
+            std::cout << " (shadowed by config)";
+        else if (file_set.count(name))
+            std::cout << " (shadowed by file)";
+        std::cout << "\n";
+    }
+
     std::cout << "\nFrom config (" << config_path.string() << "):\n";
     if (!cfgv) {
         std::cout << "  (no config file)\n";
@@ -0,0 +1,54 @@
+#include "commands/include/replay.hpp"
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "options.hpp"
+#include "recording.hpp"
+#include "report.hpp"
+#include "vanitas/pipeline.hpp"
+
+namespace vanitas::cli {
+
+// Feeds a `run --record` recording through the pipeline as if the command
+// were running now. The exit code is the recorded command's, with
+// --fail-fast and --exit-on-error applied as in run.
+int ReplayCommand::execute()
+{
+    const vanitas::ContextOptions ctx = context_options(args);
+    Report report(args, filter_, output_);
+
+    RecChunk c;
+    if (detector_) {
+        // the head is read a second time below, so that it keeps its timing
+        RecordReader head(args.file);
+        std::string sample;
+        while (sample.size() < ProfileDetector::sample_bytes && head.next(c))
+            sample.append(c.data);
+        detector_->choose(sample);
+    }
+    report.check_timestamps(*prof_.load());
+
+    RecordReader rec(args.file);
+    vanitas::Pipeline pipeline(prof_, report.sink(), report.filter(), ctx);
+    pipeline.track_tests(report.tests());
+    pipeline.tee_clean(report.clean());
+    pipeline.decode(report.encoding());
+
+    const auto start = std::chrono::steady_clock::now();
+    while (!report.should_stop() && rec.next(c)) {
+        if (args.replay_speed > 0) {
+            const auto at = std::chrono::microseconds((int64_t)((double)c.time_us / args.replay_speed));
+            std::this_thread::sleep_until(start + at);
+        }
+        pipeline.feed(c.data);
+    }
+    if (report.should_stop() && rec.next(c))
+        report.cut_short();
+
+    pipeline.finish();
+    report.finish(pipeline.counts());
+    return report.exit_code(pipeline.counts(), rec.exit_code().value_or(0));
+}
+
+} // namespace vanitas::cli
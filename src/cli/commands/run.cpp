@@ -1,20 +1,149 @@
 // commands/src/run.cpp
 #include "commands/include/run.hpp"
+#include <algorithm>
 #include <cerrno>
+#include <chrono>
+#include <csignal>
 #include <cstring>
 #include <iostream>
+#include <memory>
+#include <poll.h>
 #include <string>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <thread>
 #include <unistd.h>
 #include <vector>
 
-#include "vanitas/block_builder.hpp"
-#include "vanitas/classifier.hpp"
-#include "vanitas/normalizer.hpp"
+#include "options.hpp"
+#include "recording.hpp"
+#include "output.hpp"
+#include "report.hpp"
+#include "vanitas/pipeline.hpp"
 
 namespace vanitas::cli {
 
+// How long a child stopped by --fail-fast gets to exit before SIGKILL.
+static constexpr auto stop_grace = std::chrono::seconds(1);
+
+// With --fail-fast the child runs in its own process group, so terminal
+// signals no longer reach it directly; they are forwarded.
+static volatile sig_atomic_t child_group = 0;
+
+static void forward_signal(int sig)
+{
+    if (child_group > 0)
+        kill(-child_group, sig);
+}
+
+static void set_forwarding(bool on)
+{
+    struct sigaction sa{};
+    sa.sa_handler = on ? forward_signal : SIG_DFL;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    for (int sig : {SIGINT, SIGTERM, SIGHUP, SIGQUIT})
+        sigaction(sig, &sa, nullptr);
+}
+
+// The child's stdout and stderr. They share one pipe unless the output is
+// recorded, which tags every chunk with its stream and so needs a pipe each.
+// read() rather than stdio: an error has to be seen when it is written, not
+// when 4 KiB have piled up behind it.
+class ChildOutput
+{
+    public:
+        ~ChildOutput()
+        {
+            for (const auto &f : fds_)
+                if (f.fd >= 0)
+                    close(f.fd);
+        }
+
+        // bytes written and not read yet, over all pipes
+        size_t pending() const
+        {
+            size_t n = 0;
+            for (const auto &f : fds_)
+                if (f.fd >= 0)
+                    n += pending_bytes(f.fd);
+            return n;
+        }
+
+        void add(int fd, RecStream stream)
+        {
+            fds_.push_back({fd, POLLIN, 0});
+            streams_.push_back(stream);
+        }
+
+        // The next chunk from whichever pipe has one, taking turns; false once
+        // all are closed or when nothing came within timeout_ms (-1 waits).
+        bool read(std::string_view &data, RecStream &stream, int timeout_ms = -1)
+        {
+            while (std::any_of(fds_.begin(), fds_.end(), [](const pollfd &f) { return f.fd >= 0; })) {
+                const int n = poll(fds_.data(), fds_.size(), timeout_ms);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+
+                for (size_t k = 0; k < fds_.size(); ++k) {
+                    const size_t i = (next_ + k) % fds_.size();
+                    pollfd &f = fds_[i];
+                    if (f.fd < 0 || !(f.revents & (POLLIN | POLLHUP | POLLERR)))
+                        continue;
+                    const ssize_t r = ::read(f.fd, buf_, sizeof(buf_));
+                    if (r < 0 && errno == EINTR)
+                        continue;
+                    if (r <= 0) {
+                        close(f.fd);
+                        f.fd = -1;
+                        continue;
+                    }
+                    next_ = i + 1;
+                    data = std::string_view(buf_, (size_t)r);
+                    stream = streams_[i];
+                    return true;
+                }
+            }
+            return false;
+        }
+
+    private:
+        std::vector<pollfd> fds_;
+        std::vector<RecStream> streams_;
+        size_t next_ = 0;
+        char buf_[4096];
+};
+
+// Reads (and records, but does not analyze) what the stopped group still
+// writes until it closes the pipes or the deadline passes, so nobody blocks
+// on a full pipe while exiting.
+static void drain(ChildOutput &out, RecordWriter *rec, std::chrono::steady_clock::time_point deadline)
+{
+    std::string_view data;
+    RecStream stream;
+    while (true) {
+        const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0 || !out.read(data, stream, (int)left.count()))
+            return;
+        if (rec)
+            rec->write(stream, data);
+    }
+}
+
+static int reap(pid_t pid, std::chrono::steady_clock::time_point deadline, int &status)
+{
+    while (std::chrono::steady_clock::now() < deadline) {
+        const pid_t r = waitpid(pid, &status, WNOHANG);
+        if (r != 0)
+            return r;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    kill(-pid, SIGKILL);
+    return waitpid(pid, &status, 0);
+}
+
 int RunCommand::execute()
 {
     if (args.cmd.empty()) {
@@ -22,86 +151,146 @@ int RunCommand::execute()
         return 2;
     }
 
+    // before the child starts, so a bad baseline or time does not run the command for nothing
+    Report report(args, filter_, output_);
+    if (!detector_)
+        report.check_timestamps(*prof_.load());
+
+    std::unique_ptr<RecordWriter> rec;
+    if (args.record)
+        rec = std::make_unique<RecordWriter>(*args.record);
+
+    // built before fork(): the recorder's thread may hold the allocator's lock
+    std::vector<char *> argv;
+    argv.reserve(args.cmd.size() + 1);
+    for (auto &s : args.cmd)
+        argv.push_back(const_cast<char *>(s.c_str()));
+    argv.push_back(nullptr);
+
     int p[2];
-    if (pipe(p) != 0) {
+    int q[2] = {-1, -1};
+    if (pipe(p) != 0 || (rec && pipe(q) != 0)) {
         std::cerr << "run: pipe() failed: " << std::strerror(errno) << "\n";
         return 1;
     }
+    const int err_out = rec ? q[1] : p[1];
 
     pid_t pid = fork();
     if (pid < 0) {
         std::cerr << "run: fork() failed: " << std::strerror(errno) << "\n";
-        close(p[0]);
-        close(p[1]);
+        for (int fd : {p[0], p[1], q[0], q[1]})
+            if (fd >= 0)
+                close(fd);
         return 1;
     }
 
     if (pid == 0) {
+        if (args.fail_fast)
+            setpgid(0, 0);
         close(p[0]);
+        if (q[0] >= 0)
+            close(q[0]);
 
         if (dup2(p[1], STDOUT_FILENO) < 0)
             _exit(127);
-        if (dup2(p[1], STDERR_FILENO) < 0)
+        if (dup2(err_out, STDERR_FILENO) < 0)
             _exit(127);
         close(p[1]);
-
-        std::vector<char *> argv;
-        argv.reserve(args.cmd.size() + 1);
-        for (auto &s : args.cmd)
-            argv.push_back(const_cast<char *>(s.c_str()));
-        argv.push_back(nullptr);
+        if (q[1] >= 0)
+            close(q[1]);
 
         execvp(argv[0], argv.data());
         _exit(127);
     }
 
+    ChildOutput out;
     close(p[1]);
-
-    FILE *in = fdopen(p[0], "rb");
-    if (!in) {
-        std::cerr << "run: fdopen() failed: " << std::strerror(errno) << "\n";
-        close(p[0]);
-        return 1;
+    out.add(p[0], RecStream::Stdout);
+    if (rec) {
+        close(q[1]);
+        out.add(q[0], RecStream::Stderr);
+    }
+    vanitas::LoadGovernor *governor = report.governor();
+    if (governor) {
+        widen_pipe(p[0]);
+        if (rec)
+            widen_pipe(q[0]);
     }
 
-    vanitas::Normalizer norm;
-    vanitas::BlockBuilder builder(prof_);
-    vanitas::Classifier classifier(prof_);
-
-    std::vector<char> buf(4096);
-    while (true) {
-        size_t n = fread(buf.data(), 1, buf.size(), in);
-        if (n == 0)
-            break;
+    if (args.fail_fast) {
+        setpgid(pid, pid); // also here: the child may not have run yet
+        child_group = pid;
+        set_forwarding(true);
+    }
 
-        auto events = norm.feed(std::string_view(buf.data(), n));
-        auto blocks = builder.push(events);
-        vanitas::print_items(classifier.classify(blocks));
+    const vanitas::ContextOptions ctx = context_options(args);
+    std::string_view data;
+    RecStream stream;
+    std::string sample;
+    if (detector_) {
+        while (sample.size() < ProfileDetector::sample_bytes &&
+               out.read(data, stream, sample.empty() ? -1 : ProfileDetector::sample_quiet_ms)) {
+            if (rec)
+                rec->write(stream, data);
+            sample.append(data);
+        }
+        detector_->choose(sample);
+        report.check_timestamps(*prof_.load(), true);
     }
+    vanitas::Pipeline pipeline(prof_, report.sink(), report.filter(), ctx);
+    pipeline.track_tests(report.tests());
+    pipeline.tee_clean(report.clean());
+    pipeline.decode(report.encoding());
+    if (!sample.empty())
+        pipeline.feed(sample);
 
-    {
-        auto tail_events = norm.flush();
-        auto tail_blocks = builder.push(tail_events);
-        vanitas::print_items(classifier.classify(tail_blocks));
+    bool stopped = report.should_stop();
+    while (!stopped && out.read(data, stream)) {
+        if (rec)
+            rec->write(stream, data);
+        if (governor)
+            governor->begin();
+        pipeline.feed(data);
+        if (governor) {
+            governor->end(data.size(), out.pending());
+            pipeline.shed(governor->level());
+        }
+        stopped = report.should_stop();
     }
-    {
-        auto tail_blocks2 = builder.flush();
-        vanitas::print_items(classifier.classify(tail_blocks2));
+    if (stopped) {
+        kill(-pid, args.fail_signal);
+        report.cut_short();
     }
 
-    fclose(in);
+    pipeline.finish();
+    report.finish(pipeline.counts());
+
+    const auto deadline = std::chrono::steady_clock::now() + stop_grace;
+    if (stopped)
+        drain(out, rec.get(), deadline);
 
     int status = 0;
-    if (waitpid(pid, &status, 0) < 0) {
+    const pid_t r = stopped ? reap(pid, deadline, status) : waitpid(pid, &status, 0);
+    if (args.fail_fast) {
+        set_forwarding(false);
+        child_group = 0;
+    }
+    if (r < 0) {
         std::cerr << "run: waitpid() failed: " << std::strerror(errno) << "\n";
         return 1;
     }
 
+    int rc = 1;
     if (WIFEXITED(status))
-        return WEXITSTATUS(status);
-    if (WIFSIGNALED(status))
-        return 128 + WTERMSIG(status);
-    return 1;
+        rc = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status))
+        rc = 128 + WTERMSIG(status);
+    if (rec) {
+        rec->exit_code(rc);
+        if (const std::string err = rec->finish(); !err.empty())
+            std::cerr << "run: recording incomplete: " << err << "\n";
+    }
+    return report.exit_code(pipeline.counts(), rc);
 }
 
 } // namespace vanitas::cli
@@ -0,0 +1,524 @@
+#include "commands/include/run_jobs.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "options.hpp"
+#include "report.hpp"
+#include "vanitas/pipeline.hpp"
+
+namespace vanitas::cli {
+
+using Clock = std::chrono::steady_clock;
+
+// How long a job stopped by --fail-fast gets to exit before SIGKILL.
+static constexpr auto stop_grace = std::chrono::seconds(1);
+// A job whose pipe closed is usually reaped within a few ms of it.
+static constexpr int reap_poll_ms = 10;
+
+// Every job runs in a process group of its own, so a job stopped by
+// --fail-fast takes its whole tree along. Terminal signals are therefore
+// caught, only while the loop waits, and passed on to every running job.
+static volatile sig_atomic_t pending_signal = 0;
+
+static void note_signal(int sig) { pending_signal = sig; }
+
+static constexpr int forwarded_signals[] = {SIGINT, SIGTERM, SIGHUP, SIGQUIT};
+
+struct Job
+{
+        size_t number = 0; // from 1, in list order
+        std::string name;
+        std::vector<std::string> argv;
+
+        pid_t pid = -1;
+        int fd = -1;
+        std::unique_ptr<vanitas::Pipeline> pipeline;
+        std::string out;    // items not printed yet
+        bool shown = false; // its group has started on the output
+        size_t passed_errors = 0;
+
+        bool started = false;
+        bool reaped = false;
+        bool stopped = false; // --fail-fast
+        Clock::time_point begin, end, kill_at;
+        int rc = 0;
+        int signal = 0;
+        vanitas::Counts counts;
+
+        bool done() const { return started && reaped && fd < 0; }
+};
+
+// Shell lines from --job-file, then the `--` groups.
+static std::vector<Job> load_jobs(const vanitas::Args &args)
+{
+    std::vector<Job> jobs;
+    auto add = [&](std::string name, std::vector<std::string> argv) {
+        Job &j = jobs.emplace_back();
+        j.number = jobs.size();
+        j.name = std::move(name);
+        j.argv = std::move(argv);
+    };
+
+    if (args.job_file) {
+        std::ifstream f;
+        std::istream *in = &std::cin;
+        if (*args.job_file != "-") {
+            f.open(*args.job_file);
+            if (!f)
+                throw std::runtime_error("Cannot open job file: " + *args.job_file);
+            in = &f;
+        }
+        std::string line;
+        while (std::getline(*in, line)) {
+            const size_t b = line.find_first_not_of(" \t\r");
+            if (b == std::string::npos || line[b] == '#')
+                continue;
+            line = line.substr(b, line.find_last_not_of(" \t\r") + 1 - b);
+            add(line, {"/bin/sh", "-c", line});
+        }
+    }
+
+    for (const auto &cmd : args.job_cmds) {
+        std::string name;
+        for (const auto &a : cmd)
+            name += (name.empty() ? "" : " ") + a;
+        add(std::move(name), cmd);
+    }
+    return jobs;
+}
+
+// One epoll loop over every running job's pipe (stdout and stderr share it).
+// Each job has its own pipeline on the shared profile slot. Output is grouped:
+// one job at a time streams to stdout, the others keep their items until it
+// is done, and jobs that finished meanwhile are printed whole before the next
+// running one takes over.
+class JobRunner
+{
+    public:
+        JobRunner(const vanitas::Args &args, const vanitas::ProfileSlot &prof, const vanitas::Filter &filter,
+                  const OutputOptions &output, std::vector<Job> &jobs)
+            : args_(args), prof_(prof), filter_(filter), output_(output), ctx_(context_options(args)), jobs_(jobs)
+        {
+        }
+        ~JobRunner()
+        {
+            if (epfd_ >= 0)
+                close(epfd_);
+            if (null_fd_ >= 0)
+                close(null_fd_);
+        }
+
+        int run();
+
+    private:
+        const vanitas::Args &args_;
+        const vanitas::ProfileSlot &prof_;
+        const vanitas::Filter &filter_;
+        const OutputOptions &output_;
+        const vanitas::ContextOptions ctx_;
+        std::vector<Job> &jobs_;
+
+        int epfd_ = -1;
+        int null_fd_ = -1; // the jobs' stdin
+        sigset_t old_mask_{};
+        sigset_t wait_mask_{};
+        int interrupted_ = 0;
+
+        std::vector<Job *> active_; // started, not done
+        std::unordered_map<pid_t, Job *> by_pid_;
+        size_t closed_unreaped_ = 0;
+        std::vector<Job *> stopping_;
+
+        Job *live_ = nullptr; // the job whose items go straight to stdout
+        std::deque<Job *> waiting_;
+
+        char buf_[64 * 1024];
+
+        void start(Job &j);
+        void read(Job &j);
+        void reap();
+        void stop(Job &j);
+        void complete(Job &j);
+        void interrupt(int sig);
+        int timeout() const;
+
+        void progress(Job &j);
+        void hand_over();
+        void show(Job &j);
+        void close_group(Job &j);
+        void summary(std::ostream &os) const;
+        int exit_code(const Job &j) const;
+};
+
+void JobRunner::start(Job &j)
+{
+    j.started = true;
+    j.begin = Clock::now();
+
+    // built before fork()
+    std::vector<char *> argv;
+    argv.reserve(j.argv.size() + 1);
+    for (auto &s : j.argv)
+        argv.push_back(const_cast<char *>(s.c_str()));
+    argv.push_back(nullptr);
+
+    // O_CLOEXEC: a job must not hold its siblings' pipes open
+    int p[2];
+    pid_t pid = -1;
+    if (pipe2(p, O_CLOEXEC) != 0) {
+        std::cerr << "run: " << j.name << ": pipe() failed: " << std::strerror(errno) << "\n";
+    } else if ((pid = fork()) < 0) {
+        std::cerr << "run: " << j.name << ": fork() failed: " << std::strerror(errno) << "\n";
+        close(p[0]);
+        close(p[1]);
+    }
+    if (pid < 0) {
+        j.end = Clock::now();
+        j.reaped = true;
+        j.rc = 127;
+        progress(j);
+        return;
+    }
+
+    if (pid == 0) {
+        setpgid(0, 0);
+        sigprocmask(SIG_SETMASK, &old_mask_, nullptr);
+        if (dup2(null_fd_, STDIN_FILENO) < 0 || dup2(p[1], STDOUT_FILENO) < 0 || dup2(p[1], STDERR_FILENO) < 0)
+            _exit(127);
+        execvp(argv[0], argv.data());
+        _exit(127);
+    }
+
+    setpgid(pid, pid); // also here: the child may not have run yet
+    close(p[1]);
+    fcntl(p[0], F_SETFL, fcntl(p[0], F_GETFL) | O_NONBLOCK);
+    j.pid = pid;
+    j.fd = p[0];
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = &j;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, j.fd, &ev);
+
+    // --fail-fast counts the errors --only/--min-severity leave out too
+    vanitas::Filter filter = filter_;
+    if (args_.fail_fast)
+        filter.types |= vanitas::type_bit(vanitas::Type::Error);
+    j.pipeline = std::make_unique<vanitas::Pipeline>(
+        prof_,
+        [this, &j](const vanitas::Item &it) {
+            if (args_.fail_fast) {
+                if (j.passed_errors >= args_.fail_fast)
+                    return;
+                if (it.type == vanitas::Type::Error)
+                    ++j.passed_errors;
+            }
+            if (filter_.wants(it.type))
+                format_item(j.out, it, output_);
+        },
+        filter, ctx_);
+    j.pipeline->decode(args_.encoding);
+
+    active_.push_back(&j);
+    by_pid_[pid] = &j;
+}
+
+void JobRunner::read(Job &j)
+{
+    const ssize_t r = ::read(j.fd, buf_, sizeof(buf_));
+    if (r < 0 && (errno == EINTR || errno == EAGAIN))
+        return;
+    if (r <= 0) {
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, j.fd, nullptr);
+        close(j.fd);
+        j.fd = -1;
+        if (j.reaped)
+            complete(j);
+        else
+            ++closed_unreaped_;
+        return;
+    }
+    if (j.stopped) // drained, not analyzed
+        return;
+
+    j.pipeline->feed(std::string_view(buf_, (size_t)r));
+    if (args_.fail_fast && j.passed_errors >= args_.fail_fast)
+        stop(j);
+    progress(j);
+}
+
+void JobRunner::reap()
+{
+    while (!by_pid_.empty()) {
+        int status = 0;
+        const pid_t pid = waitpid(-1, &status, WNOHANG);
+        if (pid <= 0)
+            return;
+        const auto it = by_pid_.find(pid);
+        if (it == by_pid_.end())
+            continue;
+        Job &j = *it->second;
+        by_pid_.erase(it);
+
+        j.reaped = true;
+        j.end = Clock::now();
+        j.rc = 1;
+        if (WIFEXITED(status)) {
+            j.rc = WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            j.signal = WTERMSIG(status);
+            j.rc = 128 + j.signal;
+        }
+        if (j.fd < 0) {
+            --closed_unreaped_;
+            complete(j);
+        }
+    }
+}
+
+void JobRunner::stop(Job &j)
+{
+    j.stopped = true;
+    j.kill_at = Clock::now() + stop_grace;
+    kill(-j.pid, args_.fail_signal);
+    stopping_.push_back(&j);
+}
+
+void JobRunner::complete(Job &j)
+{
+    j.pipeline->finish();
+    j.counts = j.pipeline->counts();
+    if (!filter_.wants(vanitas::Type::Error))
+        j.counts.errors = 0; // counted for --fail-fast only
+    j.pipeline.reset();
+    std::erase(active_, &j);
+    std::erase(stopping_, &j);
+    progress(j);
+}
+
+void JobRunner::interrupt(int sig)
+{
+    pending_signal = 0;
+    interrupted_ = sig;
+    for (const auto &[pid, j] : by_pid_)
+        kill(-pid, sig);
+}
+
+int JobRunner::timeout() const
+{
+    int ms = closed_unreaped_ ? reap_poll_ms : -1;
+    const auto now = Clock::now();
+    for (const Job *j : stopping_) {
+        if (j->reaped)
+            continue;
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(j->kill_at - now).count();
+        const int t = left < 0 ? 0 : (int)std::min<long long>(left, 1000);
+        ms = ms < 0 ? t : std::min(ms, t);
+    }
+    return ms;
+}
+
+int JobRunner::run()
+{
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    null_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    if (epfd_ < 0 || null_fd_ < 0)
+        throw std::runtime_error(std::string("run: ") + std::strerror(errno));
+
+    sigset_t block;
+    sigemptyset(&block);
+    for (int sig : forwarded_signals)
+        sigaddset(&block, sig);
+    sigprocmask(SIG_BLOCK, &block, &old_mask_);
+    wait_mask_ = old_mask_;
+    struct sigaction sa{};
+    sa.sa_handler = note_signal;
+    sigemptyset(&sa.sa_mask);
+    for (int sig : forwarded_signals) {
+        sigdelset(&wait_mask_, sig);
+        sigaction(sig, &sa, nullptr);
+    }
+
+    std::vector<epoll_event> events(256);
+    size_t next = 0;
+    while (true) {
+        if (pending_signal)
+            interrupt(pending_signal);
+        while (!interrupted_ && active_.size() < args_.jobs && next < jobs_.size())
+            start(jobs_[next++]);
+        if (active_.empty())
+            break;
+
+        const int n = epoll_pwait(epfd_, events.data(), (int)events.size(), timeout(), &wait_mask_);
+        if (n < 0 && errno != EINTR)
+            throw std::runtime_error(std::string("run: epoll_wait() failed: ") + std::strerror(errno));
+        for (int k = 0; k < n; ++k)
+            read(*static_cast<Job *>(events[k].data.ptr));
+        reap();
+
+        const auto now = Clock::now();
+        for (Job *j : stopping_) {
+            if (!j->reaped && now >= j->kill_at) {
+                kill(-j->pid, SIGKILL);
+                j->kill_at = Clock::time_point::max();
+            }
+        }
+    }
+
+    sa.sa_handler = SIG_DFL;
+    for (int sig : forwarded_signals)
+        sigaction(sig, &sa, nullptr);
+    sigprocmask(SIG_SETMASK, &old_mask_, nullptr);
+
+    summary(output_.format == Format::Text ? std::cout : std::cerr);
+    if (interrupted_)
+        return 128 + interrupted_;
+    for (const Job &j : jobs_)
+        if (const int rc = exit_code(j); rc != 0)
+            return rc;
+    return 0;
+}
+
+void JobRunner::progress(Job &j)
+{
+    if (live_ == &j || (!live_ && !j.out.empty()))
+        show(j);
+    if (j.done()) {
+        if (live_ == &j) {
+            close_group(j);
+            hand_over();
+        } else if (output_.format == Format::Json || !j.out.empty()) {
+            waiting_.push_back(&j);
+            hand_over();
+        }
+    }
+    std::cout.flush();
+}
+
+void JobRunner::hand_over()
+{
+    while (!live_) {
+        if (!waiting_.empty()) {
+            Job &w = *waiting_.front();
+            waiting_.pop_front();
+            show(w);
+            close_group(w);
+            continue;
+        }
+        Job *next = nullptr;
+        for (Job *a : active_)
+            if (!a->out.empty() && (!next || a->number < next->number))
+                next = a;
+        if (!next)
+            return;
+        show(*next);
+    }
+}
+
+void JobRunner::show(Job &j)
+{
+    live_ = &j;
+    if (!j.shown) {
+        j.shown = true;
+        if (output_.format == Format::Text)
+            std::cout << "== [" << j.number << "/" << jobs_.size() << "] " << j.name << "\n";
+    }
+    std::cout << j.out;
+    j.out.clear();
+}
+
+// json: each job ends with a record of how it went
+void JobRunner::close_group(Job &j)
+{
+    live_ = nullptr;
+    if (output_.format != Format::Json)
+        return;
+    std::string rec = "{\"type\":\"job\",\"job\":" + std::to_string(j.number) + ",\"command\":";
+    json_string(rec, j.name);
+    rec += ",\"exit\":" + std::to_string(j.rc);
+    if (j.signal)
+        rec += ",\"signal\":" + std::to_string(j.signal);
+    if (j.stopped)
+        rec += ",\"stopped\":true";
+    char secs[32];
+    std::snprintf(secs, sizeof(secs), "%.3f", std::chrono::duration<double>(j.end - j.begin).count());
+    rec += ",\"errors\":" + std::to_string(j.counts.errors) + ",\"warnings\":" + std::to_string(j.counts.warnings) +
+           ",\"seconds\":" + secs + "}\n";
+    std::cout << rec;
+}
+
+void JobRunner::summary(std::ostream &os) const
+{
+    size_t failed = 0, errors = 0, warnings = 0, run = 0;
+    std::string table;
+    char row[128];
+    std::snprintf(row, sizeof(row), "%5s  %-8s %7s %9s %8s  %s\n", "job", "exit", "errors", "warnings", "time",
+                  "command");
+    table += row;
+    for (const Job &j : jobs_) {
+        std::string status = "-";
+        std::string time = "-";
+        if (j.done()) {
+            ++run;
+            status = j.stopped ? "stopped" : j.signal ? "sig " + std::to_string(j.signal) : std::to_string(j.rc);
+            char t[32];
+            std::snprintf(t, sizeof(t), "%.1fs", std::chrono::duration<double>(j.end - j.begin).count());
+            time = t;
+            failed += exit_code(j) != 0;
+            errors += j.counts.errors;
+            warnings += j.counts.warnings;
+        }
+        std::snprintf(row, sizeof(row), "%5zu  %-8s %7zu %9zu %8s  ", j.number, status.c_str(), j.counts.errors,
+                      j.counts.warnings, time.c_str());
+        table += row;
+        table += j.name;
+        table += '\n';
+    }
+    table += std::to_string(run) + " of " + std::to_string(jobs_.size()) + " jobs run, " + std::to_string(failed) +
+             " failed: " + std::to_string(errors) + " errors, " + std::to_string(warnings) + " warnings\n";
+
+    if (std::any_of(jobs_.begin(), jobs_.end(), [](const Job &j) { return j.shown; }))
+        os << "\n";
+    os << table;
+    os.flush();
+}
+
+// as for a single `run`: --fail-fast and --exit-on-error on top of the command's own
+int JobRunner::exit_code(const Job &j) const
+{
+    if (!j.done())
+        return 0;
+    if (j.stopped)
+        return exit_failed_fast;
+    if (j.rc == 0 && args_.exit_on_error && j.counts.errors > 0)
+        return exit_errors_found;
+    return j.rc;
+}
+
+int RunJobsCommand::execute()
+{
+    std::vector<Job> jobs = load_jobs(args);
+    if (jobs.empty()) {
+        std::cerr << "run: no jobs\n";
+        return 2;
+    }
+    return JobRunner(args, prof_, filter_, output_, jobs).run();
+}
+
+} // namespace vanitas::cli
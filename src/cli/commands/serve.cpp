@@ -0,0 +1,485 @@
+#include "commands/include/serve.hpp"
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+#include "options.hpp"
+#include "output.hpp"
+#include "stream_protocol.hpp"
+#include "vanitas/pipeline.hpp"
+#include "worker_pool.hpp"
+
+namespace vanitas::cli {
+
+namespace {
+
+constexpr size_t max_header = 4096;
+constexpr size_t read_chunk = 64 * 1024;
+constexpr size_t pause_reading_at = 1024 * 1024; // queued input per stream before backpressure
+constexpr size_t max_profiles = 64;               // distinct profile names compiled per daemon
+
+// Profiles are compiled once per name and shared by every stream using them;
+// the watcher republishes a slot when its profile files change. Clients name
+// profiles, never files: a name that could be a path is refused.
+class ProfileCache
+{
+    public:
+        ProfileCache(ProfileLoader loader, vanitas::ProfileWatcher *watcher)
+            : loader_(std::move(loader)), watcher_(watcher)
+        {
+        }
+
+        std::shared_ptr<vanitas::ProfileSlot> get(const std::string &name)
+        {
+            if (name.empty() || name.find('/') != std::string::npos || name.find("..") != std::string::npos)
+                throw std::runtime_error("Invalid profile name: '" + name + "'");
+
+            std::lock_guard lk(m_);
+            auto it = cache_.find(name);
+            if (it != cache_.end())
+                return it->second;
+            if (cache_.size() >= max_profiles)
+                throw std::runtime_error("Too many profiles in use (" + std::to_string(max_profiles) + ")");
+            auto slot = std::make_shared<vanitas::ProfileSlot>(std::make_shared<const vanitas::Profile>(loader_(name)));
+            cache_.emplace(name, slot);
+            if (watcher_)
+                watcher_->track(name, slot);
+            return slot;
+        }
+
+    private:
+        ProfileLoader loader_;
+        vanitas::ProfileWatcher *watcher_;
+        std::mutex m_;
+        std::unordered_map<std::string, std::shared_ptr<vanitas::ProfileSlot>> cache_;
+};
+
+struct Connection
+{
+        int fd = -1;
+
+        // worker side; a stream is handled by at most one worker at a time
+        std::string header;
+        bool header_done = false;
+        vanitas::Filter filter;
+        OutputOptions output;
+        std::shared_ptr<vanitas::ProfileSlot> slot;
+        std::unique_ptr<vanitas::Pipeline> pipeline;
+        std::string produced;
+
+        // shared between the event loop and workers
+        std::mutex m;
+        std::deque<std::string> in;
+        size_t in_bytes = 0;
+        bool in_eof = false;
+        bool scheduled = false;
+        std::string out;
+        bool done = false; // no more output will be produced
+
+        // event loop side
+        bool reading = true;
+        bool want_write = false;
+        std::string sending;
+        size_t sent = 0;
+};
+
+using ConnPtr = std::shared_ptr<Connection>;
+
+class Server
+{
+    public:
+        Server(const vanitas::Args &args, ProfileLoader loader, vanitas::ProfileWatcher *watcher, const vanitas::Config &cfg,
+               std::string default_profile)
+            : args_(args), cfg_(cfg), default_profile_(std::move(default_profile)), profiles_(std::move(loader), watcher),
+              pool_(args.workers ? args.workers : std::max(1u, std::thread::hardware_concurrency()))
+        {
+        }
+
+        int run();
+
+    private:
+        const vanitas::Args &args_;
+        const vanitas::Config &cfg_;
+        std::string default_profile_;
+        ProfileCache profiles_;
+
+        int epfd_ = -1;
+        int wake_fd_ = -1;
+        std::unordered_map<int, ConnPtr> conns_;
+
+        std::mutex dirty_m_;
+        std::vector<ConnPtr> dirty_;
+
+        WorkerPool pool_; // last: joined before the state above goes away
+
+        void accept_all(int lfd);
+        void read_conn(const ConnPtr &c);
+        void flush_conn(const ConnPtr &c);
+        void close_conn(const ConnPtr &c);
+        void update_events(const ConnPtr &c);
+        void schedule(const ConnPtr &c);
+
+        // worker side
+        void drain(const ConnPtr &c);
+        void process(Connection &c, std::string_view chunk);
+        void finish(Connection &c);
+        void notify(const ConnPtr &c);
+};
+
+void Server::update_events(const ConnPtr &c)
+{
+    epoll_event ev{};
+    ev.events = (c->reading ? EPOLLIN | EPOLLRDHUP : 0u) | (c->want_write ? EPOLLOUT : 0u);
+    ev.data.fd = c->fd;
+    epoll_ctl(epfd_, EPOLL_CTL_MOD, c->fd, &ev);
+}
+
+void Server::accept_all(int lfd)
+{
+    while (true) {
+        int fd = accept4(lfd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+            return;
+
+        auto c = std::make_shared<Connection>();
+        c->fd = fd;
+        conns_[fd] = c;
+
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLRDHUP;
+        ev.data.fd = fd;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void Server::schedule(const ConnPtr &c)
+{
+    // caller holds c->m
+    if (c->scheduled)
+        return;
+    c->scheduled = true;
+    pool_.submit([this, c] { drain(c); });
+}
+
+void Server::read_conn(const ConnPtr &c)
+{
+    char buf[read_chunk];
+    while (c->reading) {
+        ssize_t n = read(c->fd, buf, sizeof(buf));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            return;
+        if (n < 0) {
+            close_conn(c);
+            return;
+        }
+
+        std::lock_guard lk(c->m);
+        if (n == 0) {
+            c->in_eof = true;
+            c->reading = false;
+        } else {
+            c->in.emplace_back(buf, (size_t)n);
+            c->in_bytes += (size_t)n;
+            if (c->in_bytes >= pause_reading_at)
+                c->reading = false;
+        }
+        schedule(c);
+    }
+    update_events(c);
+}
+
+void Server::flush_conn(const ConnPtr &c)
+{
+    if (c->fd < 0)
+        return;
+
+    bool done = false;
+    while (true) {
+        if (c->sent == c->sending.size()) {
+            std::lock_guard lk(c->m);
+            c->sending.clear();
+            c->sent = 0;
+            c->sending.swap(c->out);
+            done = c->done;
+
+            if (!c->reading && !c->in_eof && c->in_bytes < pause_reading_at / 2) {
+                c->reading = true;
+                update_events(c);
+            }
+            if (c->sending.empty())
+                break;
+        }
+
+        ssize_t n = send(c->fd, c->sending.data() + c->sent, c->sending.size() - c->sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!c->want_write) {
+                c->want_write = true;
+                update_events(c);
+            }
+            return;
+        }
+        if (n < 0) {
+            close_conn(c);
+            return;
+        }
+        c->sent += (size_t)n;
+    }
+
+    if (c->want_write) {
+        c->want_write = false;
+        update_events(c);
+    }
+    if (done)
+        close_conn(c);
+}
+
+void Server::close_conn(const ConnPtr &c)
+{
+    if (c->fd < 0)
+        return;
+    epoll_ctl(epfd_, EPOLL_CTL_DEL, c->fd, nullptr);
+    close(c->fd);
+    conns_.erase(c->fd);
+    c->fd = -1;
+}
+
+void Server::notify(const ConnPtr &c)
+{
+    {
+        std::lock_guard lk(dirty_m_);
+        dirty_.push_back(c);
+    }
+    uint64_t one = 1;
+    (void)!write(wake_fd_, &one, sizeof(one));
+}
+
+void Server::process(Connection &c, std::string_view chunk)
+{
+    if (!c.header_done) {
+        const size_t old = c.header.size();
+        c.header.append(chunk.substr(0, max_header + 1));
+        const size_t nl = c.header.find('\n');
+        if (nl == std::string::npos) {
+            if (c.header.size() > max_header)
+                throw std::runtime_error("Stream header too long");
+            return;
+        }
+
+        const vanitas::Args opts = parse_stream_header(std::string_view(c.header).substr(0, nl));
+        c.filter = resolve_filter(opts, cfg_);
+        c.output = resolve_output(opts, cfg_);
+        c.slot = profiles_.get(opts.profile.value_or(default_profile_));
+        c.pipeline = std::make_unique<vanitas::Pipeline>(
+            *c.slot, [&c](const vanitas::Item &it) { format_item(c.produced, it, c.output); }, c.filter, context_options(opts));
+        c.header_done = true;
+
+        chunk.remove_prefix(nl + 1 - old);
+        c.header.clear();
+    }
+
+    c.pipeline->feed(chunk);
+}
+
+void Server::finish(Connection &c)
+{
+    if (!c.pipeline)
+        return;
+    c.pipeline->finish();
+    if (c.filter.count_only)
+        format_counts(c.produced, c.pipeline->counts(), c.filter, c.output);
+}
+
+void Server::drain(const ConnPtr &c)
+{
+    while (true) {
+        std::string chunk;
+        bool eof = false;
+        {
+            std::lock_guard lk(c->m);
+            if (c->done) {
+                c->in.clear();
+                c->in_bytes = 0;
+                c->scheduled = false;
+                return;
+            }
+            if (!c->in.empty()) {
+                chunk = std::move(c->in.front());
+                c->in.pop_front();
+                c->in_bytes -= chunk.size();
+            } else if (c->in_eof) {
+                eof = true;
+            } else {
+                c->scheduled = false;
+                return;
+            }
+        }
+
+        bool failed = false;
+        try {
+            if (eof)
+                finish(*c);
+            else
+                process(*c, chunk);
+        } catch (const std::exception &e) {
+            c->produced += std::string("vanitas: ") + e.what() + "\n";
+            failed = true;
+        }
+
+        {
+            std::lock_guard lk(c->m);
+            c->out += c->produced;
+            if (eof || failed) {
+                c->done = true;
+                c->scheduled = false;
+            }
+        }
+        c->produced.clear();
+        notify(c);
+
+        if (eof || failed)
+            return;
+    }
+}
+
+int Server::run()
+{
+    const std::string path = args_.socket.empty() ? default_socket_path() : args_.socket;
+
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "serve: socket path too long: " << path << "\n";
+        return 2;
+    }
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (lfd < 0) {
+        std::cerr << "serve: socket() failed: " << std::strerror(errno) << "\n";
+        return 1;
+    }
+
+    struct stat st{};
+    if (stat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode))
+        unlink(path.c_str());
+
+    if (bind(lfd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(lfd, SOMAXCONN) != 0) {
+        std::cerr << "serve: cannot listen on " << path << ": " << std::strerror(errno) << "\n";
+        close(lfd);
+        return 1;
+    }
+
+    // SIGINT/SIGTERM are blocked in every thread (see ServeCommand::execute) and read here
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    for (int fd : {lfd, wake_fd_, sfd}) {
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    std::cerr << "vanitas: serving on " << path << "\n";
+
+    std::vector<epoll_event> events(256);
+    bool running = true;
+    while (running) {
+        int n = epoll_wait(epfd_, events.data(), (int)events.size(), -1);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0) {
+            std::cerr << "serve: epoll_wait() failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            const int fd = events[i].data.fd;
+            const uint32_t ev = events[i].events;
+
+            if (fd == lfd) {
+                accept_all(lfd);
+                continue;
+            }
+            if (fd == sfd) {
+                running = false;
+                continue;
+            }
+            if (fd == wake_fd_) {
+                uint64_t v;
+                (void)!read(wake_fd_, &v, sizeof(v));
+                std::vector<ConnPtr> dirty;
+                {
+                    std::lock_guard lk(dirty_m_);
+                    dirty.swap(dirty_);
+                }
+                for (const auto &c : dirty)
+                    flush_conn(c);
+                continue;
+            }
+
+            auto it = conns_.find(fd);
+            if (it == conns_.end())
+                continue;
+            ConnPtr c = it->second;
+
+            if (ev & EPOLLERR) {
+                close_conn(c);
+                continue;
+            }
+            if (ev & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))
+                read_conn(c);
+            if (ev & EPOLLOUT)
+                flush_conn(c);
+        }
+    }
+
+    for (auto &[fd, c] : conns_)
+        close(fd);
+    conns_.clear();
+    close(lfd);
+    unlink(path.c_str());
+    return 0;
+}
+
+} // namespace
+
+int ServeCommand::execute()
+{
+    // before the worker threads exist, so they inherit the mask
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &mask, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+
+    return Server(args, loader_, watcher_, cfg_, default_profile_).run();
+}
+
+} // namespace vanitas::cli
@@ -0,0 +1,628 @@
+#include "commands/include/tui.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <fstream>
+#include <iostream>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "block_index.hpp"
+#include "screen.hpp"
+#include "vanitas/normalizer.hpp"
+
+namespace vanitas::cli {
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t head_bytes = 4096;              // read per visible row
+constexpr size_t detail_bytes = 4 * 1024 * 1024; // cap for an expanded block
+constexpr size_t search_read = 1024 * 1024;      // read per step of a text search
+constexpr auto frame_budget = std::chrono::milliseconds(25);
+
+std::atomic<bool> g_resized{false};
+
+void on_winch(int) { g_resized = true; }
+
+enum Key {
+    KeyNone = 0,
+    KeyEnter = 1000,
+    KeyEsc,
+    KeyUp,
+    KeyDown,
+    KeyPgUp,
+    KeyPgDn,
+    KeyHome,
+    KeyEnd,
+    KeyBackspace,
+};
+
+// Splits what one read() returned into keys; escape sequences are expected to
+// arrive whole, which holds for terminals and for ssh.
+std::vector<int> parse_keys(std::string_view in)
+{
+    std::vector<int> keys;
+    for (size_t i = 0; i < in.size(); ++i) {
+        const unsigned char c = (unsigned char)in[i];
+        if (c == '\r' || c == '\n') {
+            keys.push_back(KeyEnter);
+        } else if (c == 127 || c == 8) {
+            keys.push_back(KeyBackspace);
+        } else if (c != 0x1b) {
+            keys.push_back(c);
+        } else if (i + 1 < in.size() && (in[i + 1] == '[' || in[i + 1] == 'O')) {
+            size_t j = i + 2;
+            while (j < in.size() && !(in[j] >= 0x40 && in[j] <= 0x7e))
+                ++j;
+            if (j >= in.size())
+                break;
+            const std::string_view seq = in.substr(i + 2, j - i - 2);
+            switch (in[j]) {
+            case 'A':
+                keys.push_back(KeyUp);
+                break;
+            case 'B':
+                keys.push_back(KeyDown);
+                break;
+            case 'H':
+                keys.push_back(KeyHome);
+                break;
+            case 'F':
+                keys.push_back(KeyEnd);
+                break;
+            case '~':
+                if (seq == "5")
+                    keys.push_back(KeyPgUp);
+                else if (seq == "6")
+                    keys.push_back(KeyPgDn);
+                else if (seq == "1" || seq == "7")
+                    keys.push_back(KeyHome);
+                else if (seq == "4" || seq == "8")
+                    keys.push_back(KeyEnd);
+                break;
+            default:
+                break;
+            }
+            i = j;
+        } else {
+            keys.push_back(KeyEsc);
+        }
+    }
+    return keys;
+}
+
+const char *label(vanitas::Type t)
+{
+    switch (t) {
+    case vanitas::Type::Error:
+        return "ERROR: ";
+    case vanitas::Type::Warn:
+        return "WARN:  ";
+    case vanitas::Type::Tests:
+        return "TESTS: ";
+    default:
+        return "INFO:  ";
+    }
+}
+
+Style style_of(vanitas::Type t)
+{
+    switch (t) {
+    case vanitas::Type::Error:
+        return Style::Error;
+    case vanitas::Type::Warn:
+        return Style::Warn;
+    case vanitas::Type::Tests:
+        return Style::Tests;
+    default:
+        return Style::Normal;
+    }
+}
+
+// lower-case needle: case-insensitive, otherwise exact
+bool contains(std::string_view hay, const std::string &needle, bool fold)
+{
+    if (!fold)
+        return hay.find(needle) != std::string_view::npos;
+    auto it = std::search(hay.begin(), hay.end(), needle.begin(), needle.end(), [](char a, char b) {
+        return std::tolower((unsigned char)a) == b;
+    });
+    return it != hay.end();
+}
+
+class Tui
+{
+    public:
+        Tui(const std::string &path, BlockIndex &idx, unsigned types) : path_(path), idx_(idx), types_(types) {}
+
+        int run();
+
+    private:
+        const std::string &path_;
+        BlockIndex &idx_;
+
+        Terminal term_;
+        Screen screen_{term_.out()};
+        bool quit_ = false;
+
+        // list rows: every block, or the ones passing the type filter and search
+        unsigned types_;
+        std::string search_;
+        bool fold_ = false;
+        bool typing_ = false;
+        std::vector<uint64_t> rows_;
+        size_t scanned_ = 0; // blocks checked against the filter so far
+        uint64_t anchor_ = 0;
+        bool anchored_ = true;
+
+        size_t sel_ = 0;
+        size_t top_ = 0;
+        long long drawn_top_ = -1;
+
+        bool detail_ = false;
+        std::vector<std::string> detail_lines_;
+        size_t detail_block_ = 0;
+        size_t detail_top_ = 0;
+
+        int list_height() const { return std::max(1, screen_.rows() - 1); }
+        bool filtered() const { return types_ != vanitas::all_types || !search_.empty(); }
+        size_t row_count() const { return filtered() ? rows_.size() : idx_.size(); }
+        size_t block_at(size_t r) const { return filtered() ? (size_t)rows_[r] : r; }
+        bool scanning() const { return filtered() && (scanned_ < idx_.size() || !idx_.done()); }
+
+        void remember_selection();
+        void refilter();
+        void scan(Clock::time_point deadline);
+        void scan_text(size_t first, size_t limit);
+        void move_to(size_t row);
+        void jump(bool forward);
+        void open_detail();
+
+        void on_key(int k);
+        void on_list_key(int k);
+        void on_detail_key(int k);
+        void on_search_key(int k);
+
+        void draw();
+        void draw_list();
+        void draw_detail();
+        void draw_status();
+};
+
+// called before the filter changes, while sel_ still maps to the old rows
+void Tui::remember_selection()
+{
+    if (anchored_ && row_count() > 0) {
+        anchor_ = block_at(sel_);
+        anchored_ = false;
+    }
+}
+
+void Tui::refilter()
+{
+    fold_ = std::none_of(search_.begin(), search_.end(), [](unsigned char c) { return std::isupper(c); });
+    rows_.clear();
+    scanned_ = 0;
+    sel_ = top_ = 0;
+    drawn_top_ = -1;
+}
+
+// Extends rows_ until the deadline; a type filter alone needs no I/O, a search
+// reads the blocks back in large sequential chunks.
+void Tui::scan(Clock::time_point deadline)
+{
+    if (!filtered()) {
+        if (!anchored_) {
+            anchored_ = true;
+            move_to(anchor_);
+        }
+        return;
+    }
+
+    const size_t n = idx_.size();
+    // the last block may still grow while the file is being indexed
+    const size_t limit = idx_.done() ? n : (n > 0 ? n - 1 : 0);
+
+    while (scanned_ < limit && Clock::now() < deadline) {
+        if (search_.empty()) {
+            const size_t stop = std::min(limit, scanned_ + 1'000'000);
+            for (; scanned_ < stop; ++scanned_)
+                if (types_ & vanitas::type_bit(idx_.type(scanned_)))
+                    rows_.push_back(scanned_);
+        } else {
+            scan_text(scanned_, limit);
+        }
+    }
+
+    // keep the selection on the block it was on before the filter changed
+    if (!anchored_) {
+        auto it = std::lower_bound(rows_.begin(), rows_.end(), anchor_);
+        if (it != rows_.end() || !scanning()) {
+            anchored_ = true;
+            move_to(it == rows_.end() ? (rows_.empty() ? 0 : rows_.size() - 1) : (size_t)(it - rows_.begin()));
+        }
+    }
+}
+
+// Checks the blocks from first on that fit in one read against search_.
+void Tui::scan_text(size_t first, size_t limit)
+{
+    const uint64_t base = idx_.offset(first);
+    size_t last = first;
+    while (last + 1 < limit && idx_.end(last + 1) - base <= search_read)
+        ++last;
+
+    const std::string raw = idx_.read(base, idx_.end(last), search_read);
+
+    vanitas::Decoder dec = idx_.decoder();
+    vanitas::Normalizer norm;
+    std::vector<char> hit(last - first + 1, 0);
+    size_t b = first;
+    auto check = [&](const std::vector<vanitas::Event> &evs) {
+        for (const auto &ev : evs) {
+            while (b < last && base + ev.offset >= idx_.offset(b + 1))
+                ++b;
+            if (!hit[b - first] && ev.kind == vanitas::EvKind::Line && contains(ev.text, search_, fold_))
+                hit[b - first] = 1;
+        }
+    };
+    check(norm.feed(dec.feed(raw)));
+    check(norm.feed(dec.flush()));
+    check(norm.flush());
+
+    for (size_t i = first; i <= last; ++i)
+        if (hit[i - first] && (types_ & vanitas::type_bit(idx_.type(i))))
+            rows_.push_back(i);
+    scanned_ = last + 1;
+}
+
+void Tui::move_to(size_t row)
+{
+    const size_t n = row_count();
+    sel_ = n == 0 ? 0 : std::min(row, n - 1);
+    const size_t h = (size_t)list_height();
+    if (sel_ < top_)
+        top_ = sel_;
+    else if (sel_ >= top_ + h)
+        top_ = sel_ - h + 1;
+}
+
+// next/previous Error or Warn among the list rows
+void Tui::jump(bool forward)
+{
+    const size_t n = row_count();
+    auto wanted = [&](size_t r) {
+        const auto t = idx_.type(block_at(r));
+        return t == vanitas::Type::Error || t == vanitas::Type::Warn;
+    };
+    if (forward) {
+        for (size_t r = sel_ + 1; r < n; ++r)
+            if (wanted(r))
+                return move_to(r);
+    } else {
+        for (size_t r = sel_; r-- > 0;)
+            if (wanted(r))
+                return move_to(r);
+    }
+}
+
+void Tui::open_detail()
+{
+    if (row_count() == 0)
+        return;
+    detail_block_ = block_at(sel_);
+    detail_lines_ = idx_.lines(detail_block_, detail_bytes);
+    detail_top_ = 0;
+    detail_ = true;
+}
+
+void Tui::on_key(int k)
+{
+    if (k == 3) { // Ctrl-C
+        quit_ = true;
+        return;
+    }
+    if (typing_)
+        on_search_key(k);
+    else if (detail_)
+        on_detail_key(k);
+    else
+        on_list_key(k);
+}
+
+void Tui::on_list_key(int k)
+{
+    const size_t page = (size_t)list_height();
+    switch (k) {
+    case 'q':
+        quit_ = true;
+        break;
+    case 'j':
+    case KeyDown:
+        move_to(sel_ + 1);
+        break;
+    case 'k':
+    case KeyUp:
+        move_to(sel_ > 0 ? sel_ - 1 : 0);
+        break;
+    case ' ':
+    case KeyPgDn:
+        move_to(sel_ + page);
+        break;
+    case 'b':
+    case KeyPgUp:
+        move_to(sel_ > page ? sel_ - page : 0);
+        break;
+    case 'g':
+    case KeyHome:
+        move_to(0);
+        break;
+    case 'G':
+    case KeyEnd:
+        move_to(row_count() > 0 ? row_count() - 1 : 0);
+        break;
+    case 'n':
+        jump(true);
+        break;
+    case 'N':
+        jump(false);
+        break;
+    case KeyEnter:
+    case 'l':
+        open_detail();
+        break;
+    case 'f': {
+        remember_selection();
+        // all -> warn and above -> errors only -> all
+        const unsigned warn_up = vanitas::type_bit(vanitas::Type::Error) | vanitas::type_bit(vanitas::Type::Warn);
+        if (types_ == vanitas::all_types)
+            types_ = warn_up;
+        else if (types_ == warn_up)
+            types_ = vanitas::type_bit(vanitas::Type::Error);
+        else
+            types_ = vanitas::all_types;
+        refilter();
+        break;
+    }
+    case '/':
+        remember_selection();
+        typing_ = true;
+        search_.clear();
+        refilter();
+        break;
+    case KeyEsc:
+        if (!search_.empty()) {
+            remember_selection();
+            search_.clear();
+            refilter();
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void Tui::on_detail_key(int k)
+{
+    const size_t page = (size_t)std::max(1, screen_.rows() - 2);
+    const size_t max_top = detail_lines_.size() > page ? detail_lines_.size() - page : 0;
+    switch (k) {
+    case 'q':
+    case 'h':
+    case KeyEsc:
+    case KeyEnter:
+        detail_ = false;
+        drawn_top_ = -1;
+        break;
+    case 'j':
+    case KeyDown:
+        detail_top_ = std::min(max_top, detail_top_ + 1);
+        break;
+    case 'k':
+    case KeyUp:
+        detail_top_ = detail_top_ > 0 ? detail_top_ - 1 : 0;
+        break;
+    case ' ':
+    case KeyPgDn:
+        detail_top_ = std::min(max_top, detail_top_ + page);
+        break;
+    case 'b':
+    case KeyPgUp:
+        detail_top_ = detail_top_ > page ? detail_top_ - page : 0;
+        break;
+    case 'g':
+    case KeyHome:
+        detail_top_ = 0;
+        break;
+    case 'G':
+    case KeyEnd:
+        detail_top_ = max_top;
+        break;
+    default:
+        break;
+    }
+}
+
+// every keystroke restarts the search, so matches show up while typing
+void Tui::on_search_key(int k)
+{
+    if (k != KeyEnter)
+        remember_selection();
+    switch (k) {
+    case KeyEnter:
+        typing_ = false;
+        return;
+    case KeyEsc:
+        typing_ = false;
+        search_.clear();
+        break;
+    case KeyBackspace:
+        if (search_.empty())
+            return;
+        search_.pop_back();
+        break;
+    default:
+        if (k < 0x20 || k > 0xff)
+            return;
+        search_ += (char)k;
+        break;
+    }
+    refilter();
+}
+
+void Tui::draw_list()
+{
+    const int h = list_height();
+
+    // rows only ever get appended, so what is on screen can be shifted
+    if (drawn_top_ >= 0)
+        screen_.scroll(0, h, (int)std::clamp<long long>((long long)top_ - drawn_top_, -h, h));
+    drawn_top_ = (long long)top_;
+
+    const size_t n = row_count();
+    std::string line;
+    for (int i = 0; i < h; ++i) {
+        const size_t r = top_ + (size_t)i;
+        if (r >= n) {
+            screen_.put(i, r == n && scanning() ? "  ..." : "", Style::Dim);
+            continue;
+        }
+
+        const size_t b = block_at(r);
+        const auto t = idx_.type(b);
+        line = label(t);
+        const std::string raw = idx_.read(idx_.offset(b), idx_.end(b), head_bytes);
+        // the head is what follows the last '\r' of the first line, as in the pipeline
+        vanitas::Decoder dec = idx_.decoder();
+        vanitas::Normalizer norm;
+        auto head = [&](const std::vector<vanitas::Event> &events) {
+            for (const auto &ev : events) {
+                if (ev.kind == vanitas::EvKind::Line) {
+                    line += ev.text;
+                    return true;
+                }
+            }
+            return false;
+        };
+        (void)(head(norm.feed(dec.feed(raw))) || head(norm.feed(dec.flush())) || head(norm.flush()));
+
+        screen_.put(i, line, r == sel_ ? Style::Selected : style_of(t));
+    }
+}
+
+void Tui::draw_detail()
+{
+    const int h = screen_.rows() - 1;
+    std::string title = " block " + std::to_string(detail_block_ + 1) + " @ byte " +
+                        std::to_string(idx_.offset(detail_block_)) + "  " + label(idx_.type(detail_block_)) +
+                        std::to_string(detail_lines_.size()) + " lines   (q: back)";
+    screen_.put(0, title, Style::Bar);
+    for (int i = 1; i < h; ++i) {
+        const size_t l = detail_top_ + (size_t)i - 1;
+        screen_.put(i, l < detail_lines_.size() ? detail_lines_[l] : "", Style::Normal);
+    }
+}
+
+void Tui::draw_status()
+{
+    if (typing_) {
+        screen_.put(screen_.rows() - 1,
+                    "/" + search_ + "   " + std::to_string(rows_.size()) + (scanning() ? "+" : "") + " matches",
+                    Style::Bar);
+        return;
+    }
+
+    std::string s = " " + path_ + "  " + std::to_string(idx_.size()) + " blocks  E:" +
+                    std::to_string(idx_.count(vanitas::Type::Error)) + " W:" +
+                    std::to_string(idx_.count(vanitas::Type::Warn)) + " T:" +
+                    std::to_string(idx_.count(vanitas::Type::Tests));
+    if (!idx_.done() && idx_.file_size() > 0)
+        s += "  indexing " + std::to_string(idx_.scanned() * 100 / idx_.file_size()) + "%";
+    if (types_ != vanitas::all_types)
+        s += types_ == vanitas::type_bit(vanitas::Type::Error) ? "  [errors]" : "  [warn+]";
+    if (!search_.empty())
+        s += "  /" + search_ + ": " + std::to_string(rows_.size()) + (scanning() ? "+" : "") + " matches";
+    if (!detail_)
+        s += "   j/k n/N Enter f / q";
+    screen_.put(screen_.rows() - 1, s, Style::Bar);
+}
+
+void Tui::draw()
+{
+    if (detail_)
+        draw_detail();
+    else
+        draw_list();
+    draw_status();
+    screen_.present();
+}
+
+int Tui::run()
+{
+    int rows = 0, cols = 0;
+    term_.size(rows, cols);
+    screen_.resize(rows, cols);
+
+    while (!quit_) {
+        if (g_resized.exchange(false)) {
+            term_.size(rows, cols);
+            screen_.resize(rows, cols);
+            drawn_top_ = -1;
+            move_to(sel_);
+        }
+
+        scan(Clock::now() + frame_budget);
+        if (!anchored_ || sel_ >= row_count())
+            move_to(sel_);
+        draw();
+
+        // redraw periodically while indexing or searching, otherwise sleep until input
+        const bool busy = !idx_.done() || scanning();
+        pollfd pfd{term_.in(), POLLIN, 0};
+        const int r = poll(&pfd, 1, busy ? 100 : -1);
+        if (r < 0 && errno != EINTR)
+            return 1;
+        if (r <= 0)
+            continue;
+
+        char buf[256];
+        const ssize_t n = read(term_.in(), buf, sizeof(buf));
+        if (n <= 0)
+            continue;
+        for (int k : parse_keys(std::string_view(buf, (size_t)n)))
+            on_key(k);
+    }
+    return 0;
+}
+
+} // namespace
+
+int TuiCommand::execute()
+{
+    struct sigaction sa{};
+    sa.sa_handler = on_winch;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGWINCH, &sa, nullptr);
+
+    try {
+        if (detector_) {
+            std::ifstream file(args.file, std::ios::binary);
+            detector_->choose(read_sample(file));
+        }
+        BlockIndex idx(args.file, prof_, args.encoding);
+        idx.start();
+        return Tui(args.file, idx, filter_.types).run();
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << "\n";
+        return 1;
+    }
+}
+
+} // namespace vanitas::cli
@@ -0,0 +1,227 @@
+#include "file_window.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+#include "vanitas/block_builder.hpp"
+#include "vanitas/normalizer.hpp"
+
+namespace vanitas::cli {
+
+static constexpr size_t scan_chunk = 64 * 1024;
+static constexpr size_t max_line = 4096;                  // longer lines are judged by their start
+static constexpr uint64_t max_backoff = 16 * 1024 * 1024; // give up widening a cut block past this
+static constexpr uint64_t max_line_count = 256ull * 1024 * 1024;
+
+static size_t read_at(int fd, char *buf, size_t n, uint64_t pos)
+{
+    size_t got = 0;
+    while (got < n) {
+        const ssize_t r = pread(fd, buf + got, n - got, (off_t)(pos + got));
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        got += (size_t)r;
+    }
+    return got;
+}
+
+// start of the line holding the byte at pos
+uint64_t FileWindow::line_start(uint64_t pos) const
+{
+    char buf[scan_chunk];
+    while (pos > 0) {
+        const uint64_t from = pos > scan_chunk ? pos - scan_chunk : 0;
+        const size_t n = read_at(fd_, buf, (size_t)(pos - from), from);
+        const void *nl = memrchr(buf, '\n', n);
+        if (nl)
+            return from + (uint64_t)((const char *)nl - buf) + 1;
+        pos = from;
+    }
+    return 0;
+}
+
+// start of the line after the one holding pos
+uint64_t FileWindow::next_line(uint64_t pos) const
+{
+    char buf[scan_chunk];
+    while (pos < size_) {
+        const size_t n = read_at(fd_, buf, scan_chunk, pos);
+        if (n == 0)
+            break;
+        const void *nl = std::memchr(buf, '\n', n);
+        if (nl)
+            return pos + (uint64_t)((const char *)nl - buf) + 1;
+        pos += n;
+    }
+    return size_;
+}
+
+// What the pipeline sees of a raw line: escapes stripped, the text after the last '\r'.
+static std::string visible(std::string_view raw)
+{
+    vanitas::Normalizer norm;
+    (void)norm.feed(raw);
+    const auto events = norm.flush();
+    if (events.empty() || events.front().kind != vanitas::EvKind::Line)
+        return {};
+    return std::string(events.front().text);
+}
+
+// 1: the line opens a block, 0: it continues one, -1: empty (ignored by the builder)
+int FileWindow::classify_line(uint64_t start) const
+{
+    std::string raw(max_line, '\0');
+    raw.resize(read_at(fd_, raw.data(), raw.size(), start));
+    raw.resize(std::min(raw.size(), raw.find('\n')));
+
+    const std::string text = visible(raw);
+    if (text.empty())
+        return -1;
+    return vanitas::BlockBuilder::starts_block(prof_, text) ? 1 : 0;
+}
+
+// Start of the block holding pos: the line start at or before pos, widened
+// backwards over continuation lines when the window would cut a block.
+uint64_t FileWindow::block_start(uint64_t pos) const
+{
+    if (pos >= size_)
+        return size_;
+
+    const uint64_t first = line_start(pos);
+    uint64_t at = first;
+    while (at > 0 && first - at <= max_backoff) {
+        if (classify_line(at) == 1)
+            return at;
+        at = line_start(at - 1);
+    }
+    return at == 0 ? 0 : first;
+}
+
+ByteRange FileWindow::tail_bytes(uint64_t n) const
+{
+    return {block_start(size_ > n ? size_ - n : 0), size_};
+}
+
+ByteRange FileWindow::tail_blocks(uint64_t n) const
+{
+    if (n == 0 || size_ == 0)
+        return {size_, size_};
+
+    uint64_t at = line_start(size_ - 1);
+    while (true) {
+        if (classify_line(at) == 1 && --n == 0)
+            return {at, size_};
+        if (at == 0)
+            return {0, size_};
+        at = line_start(at - 1);
+    }
+}
+
+// begin widened back to its block, end pushed forward past the block it cuts
+ByteRange FileWindow::range(uint64_t begin, uint64_t end) const
+{
+    end = std::min(end, size_);
+    begin = std::min(begin, end);
+    if (begin == end)
+        return {begin, end};
+
+    ByteRange r{block_start(begin), end};
+    if (r.end < size_) {
+        uint64_t at = line_start(r.end);
+        const uint64_t limit = r.end + max_backoff;
+        if (at < r.end)
+            at = next_line(at);
+        while (at < size_ && at < limit && classify_line(at) != 1)
+            at = next_line(at);
+        r.end = at;
+    }
+    return r;
+}
+
+// Start of the first line at or after pos (a line start) whose timestamp is
+// >= min, with that timestamp in time; limit (or the end) if there is none
+// before it. Reads forward in chunks.
+uint64_t FileWindow::timed_line(uint64_t pos, int64_t min, int64_t &time, uint64_t limit) const
+{
+    limit = std::min(limit, size_);
+    std::string buf(scan_chunk, '\0');
+    while (pos < limit) {
+        const size_t n = read_at(fd_, buf.data(), buf.size(), pos);
+        if (n == 0)
+            break;
+
+        size_t at = 0;
+        while (at < n) {
+            const void *nl = std::memchr(buf.data() + at, '\n', n - at);
+            const size_t end = nl ? (size_t)((const char *)nl - buf.data()) : n;
+            const bool complete = nl || pos + n >= size_;
+            if (!complete && at > 0)
+                break; // read again from this line's start
+
+            const std::string text = visible(std::string_view(buf.data() + at, std::min(end - at, max_line)));
+            const auto t = vanitas::find_timestamp(prof_.timestamp, text);
+            if (t && *t >= min) {
+                time = *t;
+                return pos + at;
+            }
+            if (!complete) {
+                // a line longer than the chunk, judged by its start
+                at = (size_t)(next_line(pos) - pos);
+                break;
+            }
+            at = end + 1;
+        }
+        pos += std::max<size_t>(at, 1);
+    }
+    return limit;
+}
+
+// First line start from which on all timestamps are >= t. Probes keep lo at
+// the start of a line known to be earlier than t; the last stretch is scanned.
+uint64_t FileWindow::time_bound(int64_t t) const
+{
+    uint64_t lo = 0;
+    uint64_t hi = size_;
+    int64_t ts = 0;
+    while (hi - lo > scan_chunk) {
+        const uint64_t mid = lo + (hi - lo) / 2;
+        const uint64_t at = timed_line(next_line(mid), INT64_MIN, ts, hi);
+        if (at >= hi || ts >= t)
+            hi = mid;
+        else
+            lo = at;
+    }
+    return timed_line(lo, t, ts, size_);
+}
+
+ByteRange FileWindow::time_range(std::optional<int64_t> since, std::optional<int64_t> until) const
+{
+    if (!prof_.timestamp.enabled())
+        return {0, size_};
+    const uint64_t begin = since ? time_bound(*since) : 0;
+    const uint64_t end = until ? time_bound(*until) : size_;
+    return range(begin, std::max(begin, end));
+}
+
+uint64_t FileWindow::line_at(uint64_t pos) const
+{
+    if (pos > max_line_count)
+        return 0;
+
+    uint64_t lines = 1;
+    char buf[scan_chunk];
+    for (uint64_t at = 0; at < pos;) {
+        const size_t n = read_at(fd_, buf, (size_t)std::min<uint64_t>(scan_chunk, pos - at), at);
+        if (n == 0)
+            break;
+        lines += (uint64_t)std::count(buf, buf + n, '\n');
+        at += n;
+    }
+    return lines;
+}
+
+} // namespace vanitas::cli
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "vanitas/profile.hpp"
+
+namespace vanitas::cli {
+
+struct ByteRange
+{
+        uint64_t begin = 0;
+        uint64_t end = 0;
+};
+
+// Windows into a file that start and end on block boundaries as the profile's
+// firstline/continuation rules define them, found by reading only around the
+// edges (backwards from the end for tails), so the cost does not grow with the
+// file size.
+class FileWindow
+{
+    public:
+        FileWindow(int fd, uint64_t size, const vanitas::Profile &prof) : fd_(fd), size_(size), prof_(prof) {}
+
+        ByteRange tail_bytes(uint64_t n) const;
+        ByteRange tail_blocks(uint64_t n) const;
+        ByteRange range(uint64_t begin, uint64_t end) const;
+        // [since, until) by the profile's timestamps, for a file in time order
+        ByteRange time_range(std::optional<int64_t> since, std::optional<int64_t> until) const;
+
+        // newlines before pos, or 0 (unknown) when that would mean reading too much
+        uint64_t line_at(uint64_t pos) const;
+
+    private:
+        int fd_;
+        uint64_t size_;
+        const vanitas::Profile &prof_;
+
+        uint64_t line_start(uint64_t pos) const;
+        uint64_t next_line(uint64_t pos) const;
+        int classify_line(uint64_t start) const;
+        uint64_t block_start(uint64_t pos) const;
+        uint64_t timed_line(uint64_t pos, int64_t min, int64_t &time, uint64_t limit) const;
+        uint64_t time_bound(int64_t t) const;
+};
+
+} // namespace vanitas::cli
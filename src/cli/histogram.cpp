@@ -0,0 +1,109 @@
+#include "histogram.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+
+#include "vanitas/timestamp.hpp"
+
+namespace vanitas::cli {
+
+static constexpr size_t bar_width = 50;
+static constexpr int64_t max_gap_rows = 1000; // empty buckets are listed up to this span
+
+int64_t parse_interval(const std::string &s)
+{
+    size_t used = 0;
+    long long n = 0;
+    try {
+        n = std::stoll(s, &used);
+    } catch (...) {
+        used = 0;
+    }
+    const std::string unit = s.substr(used);
+    int64_t scale = 0;
+    if (unit.empty() || unit == "s")
+        scale = 1000;
+    else if (unit == "ms")
+        scale = 1;
+    else if (unit == "m")
+        scale = 60 * 1000;
+    else if (unit == "h")
+        scale = 3600 * 1000;
+    else if (unit == "d")
+        scale = 24 * 3600 * 1000;
+    if (used == 0 || n <= 0 || scale == 0)
+        throw std::runtime_error("Invalid interval: '" + s + "' (e.g. 30s, 5m, 1h, 1d)");
+    return n * scale;
+}
+
+void Histogram::add(const vanitas::Item &it)
+{
+    if (it.type != vanitas::Type::Error && it.type != vanitas::Type::Warn)
+        return;
+
+    Bucket *b = &untimed_;
+    if (it.time) {
+        const int64_t q = it.time / interval_ - (it.time % interval_ < 0);
+        b = &buckets_[q * interval_];
+    }
+    if (it.type == vanitas::Type::Error)
+        ++b->errors;
+    else
+        ++b->warnings;
+}
+
+void Histogram::format_row(std::string &out, const std::string &label, const Bucket &b, size_t max,
+                           const OutputOptions &o) const
+{
+    if (o.format == Format::Json) {
+        out += "{\"time\":";
+        out += label.empty() ? "null" : "\"" + label + "\"";
+        out += ",\"errors\":" + std::to_string(b.errors) + ",\"warnings\":" + std::to_string(b.warnings) + "}\n";
+        return;
+    }
+
+    char buf[96];
+    std::snprintf(buf, sizeof(buf), "%-24s %8zu %8zu  ", label.empty() ? "(no time)" : label.c_str(), b.errors,
+                  b.warnings);
+    out += buf;
+    const size_t total = b.errors + b.warnings;
+    const size_t width = max ? (total * bar_width + max - 1) / max : 0;
+    const size_t err = total ? width * b.errors / total : 0;
+    out.append(err, '#');
+    out.append(width - err, '+');
+    out += '\n';
+}
+
+void Histogram::print(const OutputOptions &o) const
+{
+    size_t max = untimed_.errors + untimed_.warnings;
+    for (const auto &[t, b] : buckets_)
+        max = std::max(max, b.errors + b.warnings);
+
+    std::string out;
+    if (o.format != Format::Json) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "%-24s %8s %8s\n", "time (UTC)", "errors", "warnings");
+        out += buf;
+    }
+
+    if (!buckets_.empty()) {
+        const int64_t first = buckets_.begin()->first;
+        const int64_t last = buckets_.rbegin()->first;
+        if ((last - first) / interval_ < max_gap_rows) {
+            for (int64_t t = first; t <= last; t += interval_) {
+                const auto it = buckets_.find(t);
+                format_row(out, vanitas::format_iso8601(t), it == buckets_.end() ? Bucket{} : it->second, max, o);
+            }
+        } else {
+            for (const auto &[t, b] : buckets_)
+                format_row(out, vanitas::format_iso8601(t), b, max, o);
+        }
+    }
+    if (untimed_.errors || untimed_.warnings)
+        format_row(out, "", untimed_, max, o);
+    std::cout << out;
+}
+
+} // namespace vanitas::cli
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "output.hpp"
+#include "vanitas/classifier.hpp"
+
+namespace vanitas::cli {
+
+// --histogram: errors and warnings per time bucket (UTC), printed at the end
+// in place of the items.
+class Histogram
+{
+    public:
+        explicit Histogram(int64_t interval_ms) : interval_(interval_ms) {}
+
+        void add(const vanitas::Item &it);
+        void print(const OutputOptions &o) const;
+
+    private:
+        struct Bucket
+        {
+                size_t errors = 0;
+                size_t warnings = 0;
+        };
+
+        int64_t interval_;
+        std::map<int64_t, Bucket> buckets_; // by bucket start
+        Bucket untimed_;
+
+        void format_row(std::string &out, const std::string &label, const Bucket &b, size_t max,
+                        const OutputOptions &o) const;
+};
+
+// "30s", "5m", "1h", "1d", "250ms"; a bare number is seconds.
+int64_t parse_interval(const std::string &s);
+
+} // namespace vanitas::cli
@@ -0,0 +1,37 @@
+#include "options.hpp"
+
+namespace vanitas::cli {
+
+vanitas::Filter resolve_filter(const vanitas::Args &args, const vanitas::Config &cfg)
+{
+    vanitas::Filter f;
+
+    if (args.only)
+        f.types &= vanitas::parse_type_names(*args.only);
+    else if (!cfg.only.empty())
+        f.types &= vanitas::parse_type_names(cfg.only);
+
+    if (args.min_severity)
+        f.types &= vanitas::min_severity_types(*args.min_severity);
+    else if (cfg.min_severity)
+        f.types &= vanitas::min_severity_types(*cfg.min_severity);
+
+    f.count_only = args.count;
+    return f;
+}
+
+vanitas::ContextOptions context_options(const vanitas::Args &args)
+{
+    return {args.context_before, args.context_after, args.context_lines};
+}
+
+OutputOptions resolve_output(const vanitas::Args &args, const vanitas::Config &cfg)
+{
+    OutputOptions o;
+    o.format = parse_format(args.format.value_or(cfg.format));
+    o.line_numbers = args.line_numbers;
+    o.origin = args.file;
+    return o;
+}
+
+} // namespace vanitas::cli
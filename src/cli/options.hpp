@@ -0,0 +1,13 @@
+#pragma once
+
+#include "vanitas/args_parser.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/config.hpp"
+#include "output.hpp"
+
+namespace vanitas::cli {
+// CLI flags win over config.toml.
+vanitas::Filter resolve_filter(const vanitas::Args &args, const vanitas::Config &cfg);
+vanitas::ContextOptions context_options(const vanitas::Args &args);
+OutputOptions resolve_output(const vanitas::Args &args, const vanitas::Config &cfg);
+} // namespace vanitas::cli
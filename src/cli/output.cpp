@@ -0,0 +1,449 @@
+#include "output.hpp"
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string_view>
+
+#include "vanitas/timestamp.hpp"
+
+namespace vanitas::cli {
+
+Format parse_format(const std::string &name)
+{
+    if (name == "text")
+        return Format::Text;
+    if (name == "json")
+        return Format::Json;
+    if (name == "quickfix" || name == "vim" || name == "emacs")
+        return Format::Quickfix;
+    throw std::runtime_error("Unknown format: '" + name + "' (expected text, json, quickfix)");
+}
+
+static void format_context(std::string &out, std::string_view ctx)
+{
+    if (ctx.empty())
+        return;
+
+    size_t pos = 0;
+    while (pos <= ctx.size()) {
+        size_t nl = ctx.find('\n', pos);
+        if (nl == std::string_view::npos)
+            nl = ctx.size();
+        out += "     | ";
+        out += ctx.substr(pos, nl - pos);
+        out += '\n';
+        pos = nl + 1;
+    }
+}
+
+static void format_text(std::string &out, const vanitas::Item &it, const OutputOptions &o)
+{
+    format_context(out, it.before);
+    if (o.line_numbers) {
+        out += it.line ? std::to_string(it.line) : "?";
+        out += ':';
+    }
+    switch (it.type) {
+    case vanitas::Type::Error:
+        out += "ERROR: ";
+        break;
+    case vanitas::Type::Warn:
+        out += "WARN:  ";
+        break;
+    case vanitas::Type::Tests:
+        out += "TESTS: ";
+        break;
+    default:
+        out += "INFO:  ";
+        break;
+    }
+    if (!it.source.empty()) {
+        out += it.source;
+        out += " | ";
+    }
+    out += it.text;
+    out += '\n';
+    format_context(out, it.after);
+}
+
+static const char *type_name(vanitas::Type t)
+{
+    switch (t) {
+    case vanitas::Type::Error:
+        return "error";
+    case vanitas::Type::Warn:
+        return "warning";
+    case vanitas::Type::Tests:
+        return "tests";
+    default:
+        return "info";
+    }
+}
+
+void json_string(std::string &out, std::string_view s)
+{
+    out += '"';
+    for (unsigned char c : s) {
+        switch (c) {
+        case '"':
+            out += "\\\"";
+            break;
+        case '\\':
+            out += "\\\\";
+            break;
+        case '\n':
+            out += "\\n";
+            break;
+        case '\t':
+            out += "\\t";
+            break;
+        default:
+            if (c < 0x20) {
+                char buf[8];
+                std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+                out += buf;
+            } else {
+                out += (char)c;
+            }
+        }
+    }
+    out += '"';
+}
+
+static void format_json(std::string &out, const vanitas::Item &it)
+{
+    out += "{\"type\":\"";
+    out += type_name(it.type);
+    out += "\"";
+    if (it.line)
+        out += ",\"line\":" + std::to_string(it.line);
+    out += ",\"offset\":" + std::to_string(it.offset);
+    if (it.time)
+        out += ",\"time\":\"" + vanitas::format_iso8601(it.time) + "\"";
+    if (!it.source.empty()) {
+        out += ",\"source\":";
+        json_string(out, it.source);
+    }
+    out += ",\"text\":";
+    json_string(out, it.text);
+    out += ",\"details\":";
+    json_string(out, it.details);
+    if (!it.before.empty()) {
+        out += ",\"before\":";
+        json_string(out, it.before);
+    }
+    if (!it.after.empty()) {
+        out += ",\"after\":";
+        json_string(out, it.after);
+    }
+    out += "}\n";
+}
+
+static bool all_digits(std::string_view s)
+{
+    return !s.empty() && s.find_first_not_of("0123456789") == std::string_view::npos;
+}
+
+struct Location
+{
+        std::string_view file;
+        std::string_view line;
+        std::string_view col;
+        std::string_view message;
+};
+
+// Finds a "path:line[:col]:" diagnostic location. The path is the word before
+// the first colon and must look like one (contain '.' or '/'), which rules out
+// timestamps and "function:line" tags.
+static bool find_location(std::string_view s, Location &loc)
+{
+    for (size_t i = s.find(':'); i != std::string_view::npos; i = s.find(':', i + 1)) {
+        if (i == 0)
+            continue;
+        const size_t start = s.find_last_of(" \t(", i - 1);
+        const std::string_view file = s.substr(start == std::string_view::npos ? 0 : start + 1,
+                                               i - (start == std::string_view::npos ? 0 : start + 1));
+        if (file.empty() || file.find_first_of("./") == std::string_view::npos)
+            continue;
+
+        std::string_view rest = s.substr(i + 1);
+        const size_t c1 = rest.find(':');
+        if (c1 == std::string_view::npos || !all_digits(rest.substr(0, c1)))
+            continue;
+        loc.file = file;
+        loc.line = rest.substr(0, c1);
+        loc.col = {};
+        rest.remove_prefix(c1 + 1);
+
+        const size_t c2 = rest.find(':');
+        if (c2 != std::string_view::npos && all_digits(rest.substr(0, c2))) {
+            loc.col = rest.substr(0, c2);
+            rest.remove_prefix(c2 + 1);
+        }
+        while (!rest.empty() && rest.front() == ' ')
+            rest.remove_prefix(1);
+        loc.message = rest;
+        return true;
+    }
+    return false;
+}
+
+static void format_quickfix(std::string &out, const vanitas::Item &it, const OutputOptions &o)
+{
+    Location loc;
+    if (find_location(it.text, loc)) {
+        out += loc.file;
+        out += ':';
+        out += loc.line;
+        out += ':';
+        out += loc.col.empty() ? std::string_view("1") : loc.col;
+        out += ": ";
+        // gcc/clang messages already say what they are
+        if (!(loc.message.starts_with("error:") || loc.message.starts_with("warning:") ||
+              loc.message.starts_with("fatal error:") || loc.message.starts_with("note:"))) {
+            out += type_name(it.type);
+            out += ": ";
+        }
+        out += loc.message;
+        out += '\n';
+        return;
+    }
+
+    // otherwise point into the log itself, when it is a file
+    if (o.origin.empty() || it.line == 0)
+        return;
+    out += o.origin;
+    out += ':' + std::to_string(it.line) + ":1: ";
+    out += type_name(it.type);
+    out += ": ";
+    out += it.text;
+    out += '\n';
+}
+
+void format_item(std::string &out, const vanitas::Item &it, const OutputOptions &o)
+{
+    switch (o.format) {
+    case Format::Json:
+        format_json(out, it);
+        break;
+    case Format::Quickfix:
+        format_quickfix(out, it, o);
+        break;
+    default:
+        format_text(out, it, o);
+        break;
+    }
+}
+
+void format_counts(std::string &out, const vanitas::Counts &c, const vanitas::Filter &f, const OutputOptions &o)
+{
+    if (o.format == Format::Json) {
+        std::string fields;
+        auto add = [&](vanitas::Type t, const char *key, size_t n) {
+            if (!f.wants(t))
+                return;
+            fields += fields.empty() ? "{" : ",";
+            fields += "\"" + std::string(key) + "\":" + std::to_string(n);
+        };
+        add(vanitas::Type::Error, "errors", c.errors);
+        add(vanitas::Type::Warn, "warnings", c.warnings);
+        add(vanitas::Type::Tests, "tests", c.tests);
+        add(vanitas::Type::Info, "info", c.info);
+        out += (fields.empty() ? "{" : fields) + "}\n";
+        return;
+    }
+
+    if (f.wants(vanitas::Type::Error))
+        out += "errors:   " + std::to_string(c.errors) + "\n";
+    if (f.wants(vanitas::Type::Warn))
+        out += "warnings: " + std::to_string(c.warnings) + "\n";
+    if (f.wants(vanitas::Type::Tests))
+        out += "tests:    " + std::to_string(c.tests) + "\n";
+    if (f.wants(vanitas::Type::Info))
+        out += "info:     " + std::to_string(c.info) + "\n";
+}
+
+static const char *shed_name(vanitas::Shed l)
+{
+    switch (l) {
+    case vanitas::Shed::None:
+        return "none";
+    case vanitas::Shed::Tests:
+        return "tests";
+    case vanitas::Shed::Info:
+        return "info";
+    case vanitas::Shed::Sample:
+        return "sample";
+    case vanitas::Shed::FastPath:
+        return "fast-path";
+    }
+    return "";
+}
+
+void format_shed(std::string &out, const vanitas::ShedCounts &s, const OutputOptions &o)
+{
+    if (o.format == Format::Json) {
+        out += "{\"type\":\"shed\",\"level\":\"" + std::string(shed_name(s.worst)) +
+               "\",\"tests_skipped\":" + std::to_string(s.tests) + ",\"info_dropped\":" + std::to_string(s.info) +
+               ",\"warn_skipped\":" + std::to_string(s.warn) + "}\n";
+        return;
+    }
+    if (o.format == Format::Quickfix)
+        return;
+
+    out += "Shed under load (up to " + std::string(shed_name(s.worst)) + "); errors were all looked for\n";
+    if (s.tests)
+        out += "  " + std::to_string(s.tests) + " blocks not tried as tests\n";
+    if (s.info)
+        out += "  " + std::to_string(s.info) + " info items not printed\n";
+    if (s.warn)
+        out += "  " + std::to_string(s.warn) + " blocks not tried as warnings\n";
+}
+
+static constexpr size_t slowest_tests = 5;
+
+static std::string format_ms(int64_t ms)
+{
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.3fs", (double)ms / 1000);
+    return buf;
+}
+
+void format_tests(std::string &out, const vanitas::TestTracker &t, const OutputOptions &o)
+{
+    size_t passed = 0, failed = 0, skipped = 0, flaky = 0;
+    for (const auto &r : t.tests()) {
+        passed += r.status == vanitas::TestStatus::Passed;
+        failed += r.status == vanitas::TestStatus::Failed;
+        skipped += r.status == vanitas::TestStatus::Skipped;
+        flaky += r.flaky();
+    }
+    const auto slow = t.slowest(slowest_tests);
+
+    if (o.format == Format::Json) {
+        out += "{\"type\":\"tests\",\"passed\":" + std::to_string(passed) + ",\"failed\":" + std::to_string(failed) +
+               ",\"skipped\":" + std::to_string(skipped) + ",\"flaky\":" + std::to_string(flaky) + ",\"failures\":[";
+        const char *sep = "";
+        for (const auto &r : t.tests()) {
+            if (r.status != vanitas::TestStatus::Failed)
+                continue;
+            out += sep;
+            out += "{\"name\":";
+            json_string(out, r.name);
+            out += ",\"framework\":\"" + std::string(r.framework) + "\"";
+            if (r.duration_ms >= 0)
+                out += ",\"duration_ms\":" + std::to_string(r.duration_ms);
+            out += ",\"text\":";
+            json_string(out, r.failure);
+            out += "}";
+            sep = ",";
+        }
+        out += "],\"flaky_tests\":[";
+        sep = "";
+        for (const auto &r : t.tests()) {
+            if (!r.flaky())
+                continue;
+            out += sep;
+            out += "{\"name\":";
+            json_string(out, r.name);
+            out += ",\"runs\":" + std::to_string(r.runs) + ",\"failures\":" + std::to_string(r.failures) + "}";
+            sep = ",";
+        }
+        out += "],\"slowest\":[";
+        sep = "";
+        for (const auto *r : slow) {
+            out += sep;
+            out += "{\"name\":";
+            json_string(out, r->name);
+            out += ",\"duration_ms\":" + std::to_string(r->duration_ms) + "}";
+            sep = ",";
+        }
+        out += "]}\n";
+        return;
+    }
+
+    if (o.format == Format::Quickfix) {
+        // a failed test at the first location its output names
+        for (const auto &r : t.tests()) {
+            if (r.status != vanitas::TestStatus::Failed)
+                continue;
+            std::string_view text = r.failure;
+            Location loc;
+            while (!text.empty()) {
+                const size_t nl = text.find('\n');
+                if (find_location(text.substr(0, nl), loc))
+                    break;
+                text = nl == std::string_view::npos ? std::string_view() : text.substr(nl + 1);
+            }
+            if (text.empty())
+                continue;
+            out += loc.file;
+            out += ':';
+            out += loc.line;
+            out += ':';
+            out += loc.col.empty() ? std::string_view("1") : loc.col;
+            out += ": error: " + r.name + " failed";
+            if (!loc.message.empty()) {
+                out += ": ";
+                out += loc.message;
+            }
+            out += '\n';
+        }
+        return;
+    }
+
+    out += "TESTS: " + std::to_string(passed) + " passed, " + std::to_string(failed) + " failed, " +
+           std::to_string(skipped) + " skipped";
+    if (flaky)
+        out += ", " + std::to_string(flaky) + " flaky";
+    if (t.empty())
+        out += " (no gtest, pytest or ctest results seen)";
+    out += '\n';
+    for (const auto &r : t.tests()) {
+        if (r.status != vanitas::TestStatus::Failed)
+            continue;
+        out += "FAILED: " + r.name;
+        if (r.duration_ms >= 0)
+            out += " (" + format_ms(r.duration_ms) + ")";
+        out += '\n';
+        format_context(out, r.failure);
+    }
+    for (const auto &r : t.tests())
+        if (r.flaky())
+            out += "FLAKY:  " + r.name + " (failed " + std::to_string(r.failures) + " of " + std::to_string(r.runs) +
+                   " runs)\n";
+    for (const auto *r : slow)
+        out += "SLOW:   " + format_ms(r->duration_ms) + "  " + r->name + "\n";
+}
+
+vanitas::Pipeline::Sink item_printer(const OutputOptions &o)
+{
+    return [o, buf = std::string()](const vanitas::Item &it) mutable {
+        buf.clear();
+        format_item(buf, it, o);
+        std::cout << buf;
+    };
+}
+
+void print_counts(const vanitas::Counts &c, const vanitas::Filter &f, const OutputOptions &o)
+{
+    std::string buf;
+    format_counts(buf, c, f, o);
+    std::cout << buf;
+}
+
+void print_tests(const vanitas::TestTracker &t, const OutputOptions &o)
+{
+    std::string buf;
+    format_tests(buf, t, o);
+    std::cout << buf;
+}
+
+void print_shed(const vanitas::ShedCounts &s, const OutputOptions &o)
+{
+    std::string buf;
+    format_shed(buf, s, o);
+    std::cout << buf;
+}
+
+} // namespace vanitas::cli
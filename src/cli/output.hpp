@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "vanitas/classifier.hpp"
+#include "vanitas/pipeline.hpp"
+#include "vanitas/test_tracker.hpp"
+
+namespace vanitas::cli {
+
+enum class Format {
+    Text,
+    Json,     // one JSON object per item
+    Quickfix, // file:line:col: severity: message, for vim/emacs
+};
+
+struct OutputOptions
+{
+        Format format = Format::Text;
+        bool line_numbers = false; // text: prefix items with their input line
+        std::string origin;        // input file, when there is one
+};
+
+Format parse_format(const std::string &name);
+
+// s quoted and escaped as a JSON string
+void json_string(std::string &out, std::string_view s);
+
+void format_item(std::string &out, const vanitas::Item &it, const OutputOptions &o = {});
+void format_counts(std::string &out, const vanitas::Counts &c, const vanitas::Filter &f, const OutputOptions &o = {});
+
+// --test-summary: totals, then failed tests with their output, flaky and slowest tests
+void format_tests(std::string &out, const vanitas::TestTracker &t, const OutputOptions &o = {});
+
+// --shed-after: what was left out under load
+void format_shed(std::string &out, const vanitas::ShedCounts &s, const OutputOptions &o = {});
+
+vanitas::Pipeline::Sink item_printer(const OutputOptions &o);
+void print_counts(const vanitas::Counts &c, const vanitas::Filter &f, const OutputOptions &o);
+void print_tests(const vanitas::TestTracker &t, const OutputOptions &o);
+void print_shed(const vanitas::ShedCounts &s, const OutputOptions &o);
+} // namespace vanitas::cli
@@ -0,0 +1,52 @@
+#include "profile_detector.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+
+namespace vanitas::cli {
+
+void ProfileDetector::choose(std::string_view sample)
+{
+    std::vector<vanitas::ProfileScore> scores;
+    const size_t best = vanitas::detect_profile(candidates_, sample, &scores);
+    slot_.publish(candidates_[best].profile);
+
+    char score[32];
+    std::snprintf(score, sizeof(score), "%.2f", scores[best].score);
+    std::cerr << "profile: " << candidates_[best].name << " (auto, score " << score << " of " << candidates_.size()
+              << " profiles)\n";
+}
+
+std::string read_sample(std::istream &in)
+{
+    std::string out(ProfileDetector::sample_bytes, '\0');
+    in.read(out.data(), (std::streamsize)out.size());
+    out.resize((size_t)in.gcount());
+    return out;
+}
+
+std::string read_sample(int fd)
+{
+    std::string out(ProfileDetector::sample_bytes, '\0');
+    size_t n = 0;
+    while (n < out.size()) {
+        pollfd pfd{fd, POLLIN, 0};
+        const int ready = poll(&pfd, 1, n ? ProfileDetector::sample_quiet_ms : -1);
+        if (ready < 0 && errno == EINTR)
+            continue;
+        if (ready <= 0)
+            break;
+        const ssize_t r = read(fd, out.data() + n, out.size() - n);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        n += (size_t)r;
+    }
+    out.resize(n);
+    return out;
+}
+
+} // namespace vanitas::cli
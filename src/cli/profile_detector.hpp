@@ -0,0 +1,43 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vanitas/profile_detect.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas::cli {
+
+// --profile auto: every available profile is scored on the head of the input
+// and the best one is published to the slot before the pipeline is built. The
+// sample is then fed to the pipeline ahead of the rest, so nothing is read twice.
+class ProfileDetector
+{
+    public:
+        static constexpr size_t sample_bytes = 64 * 1024;
+        // how long a writer may pause before the sample is taken as complete
+        static constexpr int sample_quiet_ms = 300;
+
+        // candidates[0] is the fallback when no profile explains the sample
+        ProfileDetector(vanitas::ProfileSlot &slot, std::vector<vanitas::ProfileCandidate> candidates)
+            : slot_(slot), candidates_(std::move(candidates))
+        {
+        }
+
+        // Publishes the winner and names it on stderr.
+        void choose(std::string_view sample);
+
+    private:
+        vanitas::ProfileSlot &slot_;
+        std::vector<vanitas::ProfileCandidate> candidates_;
+};
+
+// Up to sample_bytes, or less at end of input.
+std::string read_sample(std::istream &in);
+// Also stops once something was read and the writer then stays quiet for a
+// moment, so a slow command or `tail -f` is not held back until 64 KiB pile up.
+std::string read_sample(int fd);
+
+} // namespace vanitas::cli
@@ -0,0 +1,277 @@
+#include "recording.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <unistd.h>
+#include <zlib.h>
+
+namespace vanitas::cli {
+
+static constexpr char file_magic[8] = {'V', 'A', 'N', 'R', 'E', 'C', '1', '\n'};
+static constexpr uint32_t frame_magic = 0x31465256; // "VRF1"
+static constexpr size_t header_size = 16;
+static constexpr size_t frame_header_size = 24;
+static constexpr size_t chunk_header_size = 13; // u64 time, u8 stream, u32 length
+
+// A frame is sealed at this size or age, whichever comes first, so a crash
+// loses about a second of output at most. Age is seen to by the writer thread,
+// also while the child is quiet.
+static constexpr size_t frame_bytes = 256 * 1024;
+static constexpr uint64_t frame_age_us = 1'000'000;
+// Frames waiting for the writer thread before write() blocks (8 MiB).
+static constexpr size_t max_pending = 32;
+
+template <class T> static void put(std::string &out, T v)
+{
+    char b[sizeof(T)];
+    std::memcpy(b, &v, sizeof(T));
+    out.append(b, sizeof(T));
+}
+
+template <class T> static T get(const char *p)
+{
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+static bool write_all(int fd, const char *p, size_t n)
+{
+    while (n > 0) {
+        const ssize_t w = ::write(fd, p, n);
+        if (w < 0 && errno == EINTR)
+            continue;
+        if (w <= 0)
+            return false;
+        p += w;
+        n -= (size_t)w;
+    }
+    return true;
+}
+
+// Up to n bytes; fewer only at end of file.
+static size_t read_all(int fd, char *p, size_t n)
+{
+    size_t got = 0;
+    while (got < n) {
+        const ssize_t r = ::read(fd, p + got, n - got);
+        if (r < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            break;
+        got += (size_t)r;
+    }
+    return got;
+}
+
+RecordWriter::RecordWriter(const std::string &path) : start_(std::chrono::steady_clock::now())
+{
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0)
+        throw std::runtime_error("Cannot create recording: " + path + ": " + std::strerror(errno));
+
+    std::string header(file_magic, sizeof(file_magic));
+    const int64_t wall = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::system_clock::now().time_since_epoch())
+                             .count();
+    put(header, wall);
+    if (!write_all(fd_, header.data(), header.size())) {
+        ::close(fd_);
+        throw std::runtime_error("Cannot write recording: " + path + ": " + std::strerror(errno));
+    }
+
+    frame_.reserve(frame_bytes + 4096);
+    thread_ = std::thread([this] { run(); });
+}
+
+RecordWriter::~RecordWriter() { finish(); }
+
+void RecordWriter::write(RecStream stream, std::string_view data)
+{
+    const uint64_t t =
+        (uint64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_).count();
+    std::unique_lock lk(m_);
+    if (frame_.empty()) {
+        frame_time_ = t;
+        cv_.notify_all(); // the writer thread times the new frame
+    }
+
+    put(frame_, t);
+    put(frame_, (uint8_t)stream);
+    put(frame_, (uint32_t)data.size());
+    frame_.append(data);
+    ++chunks_;
+
+    if (frame_.size() >= frame_bytes || t - frame_time_ >= frame_age_us)
+        seal(lk);
+}
+
+void RecordWriter::exit_code(int rc)
+{
+    char b[sizeof(int32_t)];
+    const int32_t v = rc;
+    std::memcpy(b, &v, sizeof(v));
+    write(RecStream::Exit, std::string_view(b, sizeof(b)));
+}
+
+// With m_ held. Either thread may have sealed the frame while this one waited.
+void RecordWriter::seal(std::unique_lock<std::mutex> &lk)
+{
+    cv_.wait(lk, [&] { return pending_.size() < max_pending || !error_.empty(); });
+    if (frame_.empty())
+        return;
+
+    Frame f{std::move(frame_), chunks_, frame_time_};
+    frame_ = std::string();
+    frame_.reserve(frame_bytes + 4096);
+    chunks_ = 0;
+
+    if (!error_.empty())
+        return;
+    pending_.push_back(std::move(f));
+    cv_.notify_all();
+}
+
+void RecordWriter::run()
+{
+    std::string packed;
+    while (true) {
+        Frame f;
+        {
+            std::unique_lock lk(m_);
+            while (pending_.empty() && !done_) {
+                if (frame_.empty()) {
+                    cv_.wait(lk);
+                    continue;
+                }
+                const auto due = start_ + std::chrono::microseconds(frame_time_ + frame_age_us);
+                if (std::chrono::steady_clock::now() >= due)
+                    seal(lk);
+                else
+                    cv_.wait_until(lk, due);
+            }
+            if (pending_.empty())
+                return;
+            f = std::move(pending_.front());
+            pending_.pop_front();
+            cv_.notify_all();
+        }
+
+        uLongf n = compressBound((uLong)f.raw.size());
+        packed.resize(frame_header_size + n);
+        const int z = compress2(reinterpret_cast<Bytef *>(packed.data() + frame_header_size), &n,
+                                reinterpret_cast<const Bytef *>(f.raw.data()), (uLong)f.raw.size(), Z_BEST_SPEED);
+
+        std::string header;
+        put(header, frame_magic);
+        put(header, (uint32_t)f.raw.size());
+        put(header, (uint32_t)n);
+        put(header, f.chunks);
+        put(header, f.time);
+        std::memcpy(packed.data(), header.data(), frame_header_size);
+
+        if (z != Z_OK || !write_all(fd_, packed.data(), frame_header_size + n)) {
+            std::lock_guard lk(m_);
+            error_ = z != Z_OK ? "compression failed" : std::strerror(errno);
+            pending_.clear();
+            cv_.notify_all();
+            return;
+        }
+    }
+}
+
+std::string RecordWriter::finish()
+{
+    if (fd_ < 0)
+        return error_;
+
+    {
+        std::unique_lock lk(m_);
+        seal(lk);
+        done_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+    ::close(fd_);
+    fd_ = -1;
+    return error_;
+}
+
+RecordReader::RecordReader(const std::string &path)
+{
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0)
+        throw std::runtime_error("Cannot open recording: " + path + ": " + std::strerror(errno));
+
+    char header[header_size];
+    if (read_all(fd_, header, sizeof(header)) != sizeof(header) ||
+        std::memcmp(header, file_magic, sizeof(file_magic)) != 0) {
+        ::close(fd_);
+        throw std::runtime_error("Not a vanitas recording: " + path);
+    }
+}
+
+RecordReader::~RecordReader()
+{
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+// A frame cut short ends the recording quietly: that is where the writer stopped.
+bool RecordReader::next_frame()
+{
+    char header[frame_header_size];
+    if (read_all(fd_, header, sizeof(header)) != sizeof(header))
+        return false;
+    if (get<uint32_t>(header) != frame_magic)
+        throw std::runtime_error("Corrupt recording: bad frame header");
+
+    const uint32_t raw_size = get<uint32_t>(header + 4);
+    const uint32_t packed_size = get<uint32_t>(header + 8);
+    packed_.resize(packed_size);
+    if (read_all(fd_, packed_.data(), packed_size) != packed_size)
+        return false;
+
+    raw_.resize(raw_size);
+    uLongf n = raw_size;
+    if (uncompress(reinterpret_cast<Bytef *>(raw_.data()), &n, reinterpret_cast<const Bytef *>(packed_.data()),
+                   packed_size) != Z_OK ||
+        n != raw_size)
+        throw std::runtime_error("Corrupt recording: frame does not inflate");
+    pos_ = 0;
+    return true;
+}
+
+bool RecordReader::next(RecChunk &c)
+{
+    while (true) {
+        if (pos_ >= raw_.size()) {
+            if (!next_frame())
+                return false;
+            continue;
+        }
+
+        if (raw_.size() - pos_ < chunk_header_size)
+            throw std::runtime_error("Corrupt recording: truncated chunk");
+        const char *p = raw_.data() + pos_;
+        const uint64_t t = get<uint64_t>(p);
+        const auto stream = (RecStream)(uint8_t)p[8];
+        const uint32_t len = get<uint32_t>(p + 9);
+        if (raw_.size() - pos_ - chunk_header_size < len)
+            throw std::runtime_error("Corrupt recording: truncated chunk");
+        pos_ += chunk_header_size + len;
+
+        if (stream == RecStream::Exit) {
+            if (len == sizeof(int32_t))
+                exit_code_ = get<int32_t>(p + chunk_header_size);
+            continue;
+        }
+        c.time_us = t;
+        c.stream = stream;
+        c.data = std::string_view(p + chunk_header_size, len);
+        return true;
+    }
+}
+
+} // namespace vanitas::cli
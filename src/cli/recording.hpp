@@ -0,0 +1,102 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace vanitas::cli {
+
+// A .vrec file holds what a `run` child wrote, byte for byte and before any
+// normalization, so it can be analyzed again later. After a 16 byte header
+// ("VANREC1\n", start time in ms since the epoch) come frames, appended one
+// after the other: a 24 byte frame header (magic, raw and packed size, chunk
+// count, time of its first chunk) and the zlib-packed chunks. Each chunk is
+// its time since the start (us), its stream and its bytes. A frame header says
+// how long the frame is, so frames can be skipped without inflating them, and
+// a file cut off by a crash is readable up to its last whole frame.
+enum class RecStream : uint8_t {
+    Stdout = 1,
+    Stderr = 2,
+    Exit = 3, // the child's exit code, as 4 bytes
+};
+
+// The child's output goes into the current frame (a copy, nothing more); full
+// frames are packed and written by a thread of their own, which also seals the
+// current frame once it is old enough, so output the child stops after is not
+// kept back.
+class RecordWriter
+{
+    public:
+        explicit RecordWriter(const std::string &path);
+        ~RecordWriter();
+        RecordWriter(const RecordWriter &) = delete;
+        RecordWriter &operator=(const RecordWriter &) = delete;
+
+        void write(RecStream stream, std::string_view data);
+        void exit_code(int rc);
+
+        // Writes what is left and closes the file; empty, or why the recording is incomplete.
+        std::string finish();
+
+    private:
+        int fd_ = -1;
+        std::chrono::steady_clock::time_point start_;
+
+        std::mutex m_;
+        std::condition_variable cv_;
+        std::string frame_;
+        uint32_t chunks_ = 0;
+        uint64_t frame_time_ = 0;
+        struct Frame
+        {
+                std::string raw;
+                uint32_t chunks;
+                uint64_t time;
+        };
+        std::deque<Frame> pending_;
+        bool done_ = false;
+        std::string error_;
+        std::thread thread_;
+
+        void seal(std::unique_lock<std::mutex> &lk);
+        void run();
+};
+
+struct RecChunk
+{
+        uint64_t time_us = 0; // since the start of the recording
+        RecStream stream = RecStream::Stdout;
+        std::string_view data; // valid until the next call to next()
+};
+
+class RecordReader
+{
+    public:
+        explicit RecordReader(const std::string &path);
+        ~RecordReader();
+        RecordReader(const RecordReader &) = delete;
+        RecordReader &operator=(const RecordReader &) = delete;
+
+        // The next chunk of output; false at the end of the recording.
+        bool next(RecChunk &c);
+
+        // Once the end is reached, if the recording got that far.
+        std::optional<int> exit_code() const { return exit_code_; }
+
+    private:
+        int fd_ = -1;
+        std::string packed_;
+        std::string raw_;
+        size_t pos_ = 0;
+        std::optional<int> exit_code_;
+
+        bool next_frame();
+};
+
+} // namespace vanitas::cli
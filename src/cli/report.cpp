@@ -0,0 +1,193 @@
+#include "report.hpp"
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#include "vanitas/timestamp.hpp"
+
+namespace vanitas::cli {
+
+// ISO-8601 date or date-time, "@<epoch seconds>", "now", or relative to now: "-15m", "-2h", "-1d".
+static int64_t parse_time_arg(const std::string &s)
+{
+    const int64_t now =
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    if (s == "now")
+        return now;
+    if (s.size() > 1 && s[0] == '-')
+        return now - parse_interval(s.substr(1));
+    if (s.size() > 1 && s[0] == '@') {
+        size_t used = 0;
+        try {
+            const long long secs = std::stoll(s.substr(1), &used);
+            if (used == s.size() - 1)
+                return secs * 1000;
+        } catch (...) {
+        }
+    }
+    if (const auto t = vanitas::parse_iso8601(s))
+        return *t;
+    throw std::runtime_error("Invalid time: '" + s + "' (e.g. 2025-09-02T15:50, @1756828200, -2h)");
+}
+
+size_t pending_bytes(int fd)
+{
+    int n = 0;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || !(S_ISFIFO(st.st_mode) || S_ISSOCK(st.st_mode)) || ioctl(fd, FIONREAD, &n) != 0)
+        return 0;
+    return (size_t)n;
+}
+
+// 1 MiB is what an unprivileged process may ask for by default; a pipe that
+// cannot grow keeps its size.
+void widen_pipe(int fd)
+{
+    struct stat st{};
+    if (fstat(fd, &st) == 0 && S_ISFIFO(st.st_mode))
+        fcntl(fd, F_SETPIPE_SZ, 1024 * 1024);
+}
+
+// the types of the items that get past --only/--min-severity and --histogram
+static unsigned reported_types(const vanitas::Args &args, const vanitas::Filter &f)
+{
+    if (args.histogram)
+        return f.types & (vanitas::type_bit(vanitas::Type::Error) | vanitas::type_bit(vanitas::Type::Warn));
+    return f.types;
+}
+
+Report::Report(const vanitas::Args &args, const vanitas::Filter &filter, const OutputOptions &output)
+    : args_(args), filter_(filter), output_(output), diff_(args, reported_types(args, filter))
+{
+    if (args.since)
+        since_ = parse_time_arg(*args.since);
+    if (args.until)
+        until_ = parse_time_arg(*args.until);
+    if (args.histogram)
+        hist_ = std::make_unique<Histogram>(parse_interval(*args.histogram));
+    if (args.test_summary)
+        tests_ = std::make_unique<vanitas::TestTracker>();
+    if (args.tee_clean)
+        clean_ = std::make_unique<vanitas::CleanWriter>(*args.tee_clean);
+    if (args.shed_after.size() == 1)
+        governor_ = std::make_unique<vanitas::LoadGovernor>(vanitas::ShedThresholds::doubling(args.shed_after[0]));
+    else if (args.shed_after.size() == 4)
+        governor_ = std::make_unique<vanitas::LoadGovernor>(vanitas::ShedThresholds{
+            {args.shed_after[0], args.shed_after[1], args.shed_after[2], args.shed_after[3]}});
+    // --fail-fast sees errors that --only/--min-severity leave out; the sink drops them
+    counting_ = since_ || until_ || diff_.active() || hist_ || (args.fail_fast && !filter.wants(vanitas::Type::Error));
+    in_window_ = !since_;
+}
+
+void Report::check_timestamps(const vanitas::Profile &p, bool running) const
+{
+    if ((!since_ && !until_ && !hist_) || p.timestamp.enabled())
+        return;
+    const std::string what = args_.histogram ? "--histogram" : args_.since ? "--since" : "--until";
+    const std::string msg = what + " needs timestamps; the profile has no [timestamp] format";
+    if (!running)
+        throw std::runtime_error(msg);
+    std::cerr << "WARN: " << msg << "\n";
+}
+
+vanitas::Filter Report::filter() const
+{
+    vanitas::Filter f = filter_;
+    if (counting_)
+        f.count_only = false;
+    if (hist_)
+        f.types &= vanitas::type_bit(vanitas::Type::Error) | vanitas::type_bit(vanitas::Type::Warn);
+    if (args_.fail_fast)
+        f.types |= vanitas::type_bit(vanitas::Type::Error);
+    return f;
+}
+
+bool Report::in_window(const vanitas::Item &it)
+{
+    if (!since_ && !until_)
+        return true;
+    if (it.time != 0)
+        in_window_ = (!since_ || it.time >= *since_) && (!until_ || it.time < *until_);
+    return in_window_;
+}
+
+vanitas::Pipeline::Sink Report::sink()
+{
+    return [this, print = item_printer(output_)](const vanitas::Item &it) {
+        if (!in_window(it))
+            return;
+        if (args_.fail_fast) {
+            if (errors_ >= args_.fail_fast) {
+                cut_ = true;
+                return;
+            }
+            if (it.type == vanitas::Type::Error)
+                ++errors_;
+        }
+        if (!filter_.wants(it.type))
+            return;
+        if (diff_.active() && diff_.known(it))
+            return;
+
+        if (counting_) {
+            switch (it.type) {
+            case vanitas::Type::Error:
+                ++counts_.errors;
+                break;
+            case vanitas::Type::Warn:
+                ++counts_.warnings;
+                break;
+            case vanitas::Type::Tests:
+                ++counts_.tests;
+                break;
+            default:
+                ++counts_.info;
+                break;
+            }
+        }
+
+        if (hist_)
+            hist_->add(it);
+        else if (!filter_.count_only)
+            print(it);
+    };
+}
+
+const vanitas::Counts &Report::counts(const vanitas::Counts &classified) const
+{
+    return counting_ ? counts_ : classified;
+}
+
+bool Report::should_stop() const { return args_.fail_fast > 0 && errors_ >= args_.fail_fast; }
+
+void Report::finish(const vanitas::Counts &classified)
+{
+    if (clean_)
+        clean_->finish();
+    if (filter_.count_only)
+        print_counts(counts(classified), filter_, output_);
+    if (hist_)
+        hist_->print(output_);
+    if (tests_) {
+        tests_->finish();
+        print_tests(*tests_, output_);
+    }
+    if (classified.shed.any())
+        print_shed(classified.shed, output_);
+    std::cout.flush();
+    diff_.finish();
+}
+
+int Report::exit_code(const vanitas::Counts &classified, int rc) const
+{
+    if (cut_)
+        return exit_failed_fast;
+    if (rc == 0 && args_.exit_on_error && counts(classified).errors > 0)
+        return exit_errors_found;
+    return rc;
+}
+
+} // namespace vanitas::cli
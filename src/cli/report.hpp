@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "baseline_diff.hpp"
+#include "histogram.hpp"
+#include "output.hpp"
+#include "vanitas/args_parser.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/clean_writer.hpp"
+#include "vanitas/load_governor.hpp"
+#include "vanitas/pipeline.hpp"
+#include "vanitas/profile.hpp"
+#include "vanitas/test_tracker.hpp"
+
+namespace vanitas::cli {
+
+// Exit codes of file/pipe/run on top of their own (run passes on the child's).
+constexpr int exit_errors_found = 3; // --exit-on-error and errors were reported
+constexpr int exit_failed_fast = 4;  // --fail-fast stopped the analysis
+
+// --shed-after: bytes waiting to be read from fd, for LoadGovernor::end (0
+// unless it is a pipe or socket), and a pipe grown so that more of the input
+// can wait there than its first 64 KiB.
+size_t pending_bytes(int fd);
+void widen_pipe(int fd);
+
+// What file/pipe/run do with the classifier's items, in order: the
+// --since/--until window, --fail-fast, --only/--min-severity for the errors only
+// --fail-fast asked for, the baseline, then printing or the histogram, and the
+// --test-summary at the end. Stages that drop items have
+// to see them, so when one is on, --count is counted here instead of in the
+// classifier. The --tee-clean file gets every line, whatever is reported.
+class Report
+{
+    public:
+        Report(const vanitas::Args &args, const vanitas::Filter &filter, const OutputOptions &output);
+
+        vanitas::Filter filter() const;
+        vanitas::Pipeline::Sink sink();
+
+        // --test-summary: for Pipeline::track_tests, null without it
+        vanitas::TestTracker *tests() { return tests_.get(); }
+        // --tee-clean: for Pipeline::tee_clean, null without it
+        vanitas::CleanWriter *clean() { return clean_.get(); }
+        // --shed-after: null without it
+        vanitas::LoadGovernor *governor() { return governor_.get(); }
+        // --encoding: for Pipeline::decode
+        vanitas::Encoding encoding() const { return args_.encoding; }
+
+        const std::optional<int64_t> &since() const { return since_; }
+        const std::optional<int64_t> &until() const { return until_; }
+        // --since/--until/--histogram go by the profile's timestamps: without
+        // them a usage error, or a warning once the command is already running
+        void check_timestamps(const vanitas::Profile &p, bool running = false) const;
+
+        // classified: the pipeline's counts
+        const vanitas::Counts &counts(const vanitas::Counts &classified) const;
+        // --fail-fast: enough errors seen to stop reading
+        bool should_stop() const;
+        // --fail-fast: reading stopped with input left, so the exit code is 4
+        void cut_short() { cut_ = true; }
+        void finish(const vanitas::Counts &classified);
+        // rc with --fail-fast and --exit-on-error applied
+        int exit_code(const vanitas::Counts &classified, int rc = 0) const;
+
+    private:
+        const vanitas::Args &args_;
+        vanitas::Filter filter_;
+        const OutputOptions &output_;
+
+        std::optional<int64_t> since_;
+        std::optional<int64_t> until_; // exclusive
+        BaselineDiff diff_;
+        std::unique_ptr<Histogram> hist_;
+        std::unique_ptr<vanitas::TestTracker> tests_;
+        std::unique_ptr<vanitas::CleanWriter> clean_;
+        std::unique_ptr<vanitas::LoadGovernor> governor_;
+
+        bool counting_ = false;
+        vanitas::Counts counts_;
+        // --fail-fast: errors in the window, whatever the filters; what follows
+        // the Nth in the last chunk is dropped, which also cuts the run short
+        size_t errors_ = 0;
+        bool cut_ = false;
+
+        // an item without a time goes with the stamped one before it
+        bool in_window_ = false;
+
+        bool in_window(const vanitas::Item &it);
+};
+
+} // namespace vanitas::cli
@@ -0,0 +1,181 @@
+#include "screen.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+namespace vanitas::cli {
+
+static void write_all(int fd, std::string_view s)
+{
+    while (!s.empty()) {
+        const ssize_t n = write(fd, s.data(), s.size());
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return;
+        s.remove_prefix((size_t)n);
+    }
+}
+
+Terminal::Terminal()
+{
+    in_ = open("/dev/tty", O_RDWR | O_CLOEXEC);
+    if (in_ < 0 || tcgetattr(in_, &saved_) != 0) {
+        if (in_ >= 0)
+            close(in_);
+        throw std::runtime_error("tui: needs a terminal");
+    }
+    out_ = in_;
+
+    termios raw = saved_;
+    raw.c_iflag &= ~(tcflag_t)(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_oflag &= ~(tcflag_t)OPOST;
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(tcflag_t)(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 0;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(in_, TCSAFLUSH, &raw);
+
+    // alternate screen, hide cursor
+    write_all(out_, "\x1b[?1049h\x1b[?25l\x1b[2J");
+}
+
+Terminal::~Terminal()
+{
+    write_all(out_, "\x1b[r\x1b[0m\x1b[?25h\x1b[?1049l");
+    tcsetattr(in_, TCSAFLUSH, &saved_);
+    close(in_);
+}
+
+void Terminal::size(int &rows, int &cols) const
+{
+    winsize ws{};
+    if (ioctl(out_, TIOCGWINSZ, &ws) == 0 && ws.ws_row > 0 && ws.ws_col > 0) {
+        rows = ws.ws_row;
+        cols = ws.ws_col;
+    } else {
+        rows = 24;
+        cols = 80;
+    }
+}
+
+void Screen::resize(int rows, int cols)
+{
+    rows_ = rows;
+    cols_ = cols;
+    back_.assign((size_t)rows, Row{});
+    // unknown content: every row differs from whatever is drawn next
+    front_.assign((size_t)rows, Row{std::string(1, '\0'), Style::Normal});
+    out_ += "\x1b[2J";
+}
+
+void Screen::put(int row, std::string_view text, Style style)
+{
+    if (row < 0 || row >= rows_)
+        return;
+
+    Row &r = back_[(size_t)row];
+    r.text.clear();
+    r.style = style;
+
+    int width = 0;
+    for (size_t i = 0; i < text.size(); ++i) {
+        const unsigned char c = (unsigned char)text[i];
+        // UTF-8 continuation bytes belong to the character before them
+        if ((c & 0xC0) == 0x80) {
+            r.text += (char)c;
+            continue;
+        }
+        if (width >= cols_)
+            break;
+        if (c == '\t') {
+            const int stop = std::min(cols_, (width / 8 + 1) * 8);
+            r.text.append((size_t)(stop - width), ' ');
+            width = stop;
+            continue;
+        }
+        r.text += (c < 0x20 || c == 0x7f) ? '?' : (char)c;
+        ++width;
+    }
+
+    // a highlighted bar spans the whole row
+    if (style == Style::Selected || style == Style::Bar) {
+        r.text.append((size_t)std::max(0, cols_ - width), ' ');
+        width = std::max(width, cols_);
+    }
+    r.width = width;
+}
+
+void Screen::scroll(int top, int bottom, int n)
+{
+    top = std::max(top, 0);
+    bottom = std::min(bottom, rows_);
+    if (n == 0 || bottom - top <= std::abs(n))
+        return;
+
+    out_ += "\x1b[" + std::to_string(top + 1) + ";" + std::to_string(bottom) + "r";
+    if (n > 0) {
+        out_ += "\x1b[" + std::to_string(n) + "S";
+        std::rotate(front_.begin() + top, front_.begin() + top + n, front_.begin() + bottom);
+        std::fill(front_.begin() + bottom - n, front_.begin() + bottom, Row{});
+    } else {
+        out_ += "\x1b[" + std::to_string(-n) + "T";
+        std::rotate(front_.begin() + top, front_.begin() + bottom + n, front_.begin() + bottom);
+        std::fill(front_.begin() + top, front_.begin() + top - n, Row{});
+    }
+    out_ += "\x1b[r";
+}
+
+static const char *sgr(Style s)
+{
+    switch (s) {
+    case Style::Error:
+        return "\x1b[31m";
+    case Style::Warn:
+        return "\x1b[33m";
+    case Style::Tests:
+        return "\x1b[32m";
+    case Style::Dim:
+        return "\x1b[2m";
+    case Style::Selected:
+        return "\x1b[7m";
+    case Style::Bar:
+        return "\x1b[30;47m";
+    default:
+        return "";
+    }
+}
+
+void Screen::present()
+{
+    for (int i = 0; i < rows_; ++i) {
+        Row &b = back_[(size_t)i];
+        Row &f = front_[(size_t)i];
+        if (b == f)
+            continue;
+
+        out_ += "\x1b[" + std::to_string(i + 1) + ";1H";
+        out_ += sgr(b.style);
+        out_ += b.text;
+        out_ += "\x1b[0m";
+        // erasing from the last column would also erase the character written there
+        if (b.width < cols_)
+            out_ += "\x1b[K";
+        f = b;
+    }
+    flush();
+}
+
+void Screen::flush()
+{
+    if (out_.empty())
+        return;
+    write_all(out_fd_, out_);
+    out_.clear();
+}
+
+} // namespace vanitas::cli
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <termios.h>
+#include <vector>
+
+namespace vanitas::cli {
+
+// Raw mode on the controlling terminal and the alternate screen, restored on
+// destruction.
+class Terminal
+{
+    public:
+        Terminal();
+        ~Terminal();
+
+        Terminal(const Terminal &) = delete;
+        Terminal &operator=(const Terminal &) = delete;
+
+        int in() const { return in_; }
+        int out() const { return out_; }
+        void size(int &rows, int &cols) const;
+
+    private:
+        int in_;
+        int out_;
+        termios saved_{};
+};
+
+enum class Style : uint8_t {
+    Normal,
+    Error,
+    Warn,
+    Tests,
+    Dim,
+    Selected,
+    Bar,
+};
+
+// Back buffer the caller draws a whole frame into, and the front buffer of what
+// the terminal shows. present() only sends the rows that differ, so a frame
+// where little changed costs a few bytes on the wire.
+class Screen
+{
+    public:
+        explicit Screen(int out_fd) : out_fd_(out_fd) {}
+
+        void resize(int rows, int cols);
+        int rows() const { return rows_; }
+        int cols() const { return cols_; }
+
+        // clipped to the width; tabs and control characters are made printable
+        void put(int row, std::string_view text, Style style = Style::Normal);
+
+        // Rows [top, bottom) of the terminal moved up by n (down when n < 0).
+        // Scrolls them on the terminal and in the front buffer, so only the rows
+        // scrolled in have to be sent.
+        void scroll(int top, int bottom, int n);
+
+        void present();
+
+    private:
+        struct Row
+        {
+                std::string text;
+                Style style = Style::Normal;
+                int width = 0; // columns taken by text
+
+                bool operator==(const Row &) const = default;
+        };
+
+        int out_fd_;
+        int rows_ = 0;
+        int cols_ = 0;
+        std::vector<Row> front_;
+        std::vector<Row> back_;
+        std::string out_;
+
+        void flush();
+};
+
+} // namespace vanitas::cli
@@ -0,0 +1,131 @@
+#include "stream_protocol.hpp"
+#include <cstdlib>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace vanitas::cli {
+
+static constexpr std::string_view magic = "VANITAS/1";
+
+static std::string join_list(const std::vector<std::string> &v)
+{
+    std::string out;
+    for (const auto &s : v) {
+        if (!out.empty())
+            out += ',';
+        out += s;
+    }
+    return out;
+}
+
+static std::vector<std::string> split_list(std::string_view s)
+{
+    std::vector<std::string> out;
+    while (!s.empty()) {
+        size_t comma = s.find(',');
+        if (comma == std::string_view::npos)
+            comma = s.size();
+        if (comma > 0)
+            out.emplace_back(s.substr(0, comma));
+        s.remove_prefix(std::min(comma + 1, s.size()));
+    }
+    return out;
+}
+
+static size_t parse_size(std::string_view key, std::string_view v)
+{
+    size_t n = 0;
+    if (v.empty())
+        throw std::runtime_error("Bad stream header value for " + std::string(key));
+    for (char c : v) {
+        if (c < '0' || c > '9')
+            throw std::runtime_error("Bad stream header value for " + std::string(key));
+        n = n * 10 + (size_t)(c - '0');
+        if (n > vanitas::max_context)
+            throw std::runtime_error("Bad stream header value for " + std::string(key) + ": over " +
+                                     std::to_string(vanitas::max_context));
+    }
+    return n;
+}
+
+std::string make_stream_header(const vanitas::Args &args)
+{
+    std::string h(magic);
+    if (args.profile)
+        h += " profile=" + *args.profile;
+    if (args.only)
+        h += " only=" + join_list(*args.only);
+    if (args.min_severity)
+        h += " min_severity=" + *args.min_severity;
+    if (args.context_before)
+        h += " before=" + std::to_string(args.context_before);
+    if (args.context_after)
+        h += " after=" + std::to_string(args.context_after);
+    if (args.context_lines)
+        h += " lines=1";
+    if (args.count)
+        h += " count=1";
+    if (args.format)
+        h += " format=" + *args.format;
+    if (args.line_numbers)
+        h += " n=1";
+    h += '\n';
+    return h;
+}
+
+vanitas::Args parse_stream_header(std::string_view line)
+{
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    if (!line.starts_with(magic))
+        throw std::runtime_error("Bad stream header: expected " + std::string(magic));
+    line.remove_prefix(magic.size());
+
+    vanitas::Args out;
+    out.mode = vanitas::Mode::Pipe;
+
+    while (!line.empty()) {
+        size_t sp = line.find(' ');
+        std::string_view tok = line.substr(0, sp);
+        line.remove_prefix(sp == std::string_view::npos ? line.size() : sp + 1);
+        if (tok.empty())
+            continue;
+
+        const size_t eq = tok.find('=');
+        if (eq == std::string_view::npos)
+            throw std::runtime_error("Bad stream header option: " + std::string(tok));
+        const std::string_view key = tok.substr(0, eq);
+        const std::string_view val = tok.substr(eq + 1);
+
+        if (key == "profile")
+            out.profile = std::string(val);
+        else if (key == "only")
+            out.only = split_list(val);
+        else if (key == "min_severity")
+            out.min_severity = std::string(val);
+        else if (key == "before")
+            out.context_before = parse_size(key, val);
+        else if (key == "after")
+            out.context_after = parse_size(key, val);
+        else if (key == "lines")
+            out.context_lines = val == "1";
+        else if (key == "count")
+            out.count = val == "1";
+        else if (key == "format")
+            out.format = std::string(val);
+        else if (key == "n")
+            out.line_numbers = val == "1";
+        else
+            throw std::runtime_error("Unknown stream header option: " + std::string(key));
+    }
+    return out;
+}
+
+std::string default_socket_path()
+{
+    if (const char *dir = std::getenv("XDG_RUNTIME_DIR"); dir && *dir)
+        return std::string(dir) + "/vanitas.sock";
+    return "/tmp/vanitas-" + std::to_string(getuid()) + ".sock";
+}
+
+} // namespace vanitas::cli
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "vanitas/args_parser.hpp"
+
+namespace vanitas::cli {
+// A client stream starts with one header line, "VANITAS/1" followed by
+// space-separated key=value analysis options, and continues with raw log bytes.
+// The daemon answers with the same text a local `vanitas pipe` would print.
+std::string make_stream_header(const vanitas::Args &args);
+vanitas::Args parse_stream_header(std::string_view line);
+
+std::string default_socket_path();
+} // namespace vanitas::cli
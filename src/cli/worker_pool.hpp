@@ -0,0 +1,34 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vanitas::cli {
+
+// Fixed set of threads draining a FIFO of tasks.
+class WorkerPool
+{
+    public:
+        explicit WorkerPool(size_t threads);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool &) = delete;
+        WorkerPool &operator=(const WorkerPool &) = delete;
+
+        void submit(std::function<void()> task);
+
+    private:
+        std::mutex m_;
+        std::condition_variable cv_;
+        std::deque<std::function<void()>> tasks_;
+        bool stop_ = false;
+        std::vector<std::thread> threads_;
+
+        void work();
+};
+
+} // namespace vanitas::cli
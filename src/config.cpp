@@ -47,6 +47,14 @@ Config load_user_config()
 
     cfg.color = toml::find_or(v, "color", cfg.color);
     cfg.format = toml::find_or(v, "format", cfg.format);
+    cfg.only = toml::find_or(v, "only", cfg.only);
+    cfg.learn_rule_order = toml::find_or(v, "learn_rule_order", cfg.learn_rule_order);
+
+    try {
+        cfg.min_severity = toml::find<std::string>(v, "min_severity");
+    } catch (...) {
+        cfg.min_severity.reset();
+    }
     return cfg;
 }
 
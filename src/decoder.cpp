@@ -0,0 +1,346 @@
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "vanitas/decoder.hpp"
+
+namespace vanitas {
+
+Encoding parse_encoding(const std::string &name)
+{
+    std::string s;
+    for (const char c : name) {
+        if (c != '-' && c != '_')
+            s += (char)std::tolower((unsigned char)c);
+    }
+    if (s == "auto")
+        return Encoding::Auto;
+    if (s == "utf8")
+        return Encoding::Utf8;
+    if (s == "utf16le")
+        return Encoding::Utf16le;
+    if (s == "utf16be")
+        return Encoding::Utf16be;
+    if (s == "latin1" || s == "iso88591")
+        return Encoding::Latin1;
+    throw std::runtime_error("unknown encoding: " + name + " (auto, utf-8, utf-16le, utf-16be, latin1)");
+}
+
+const char *encoding_name(Encoding e)
+{
+    switch (e) {
+    case Encoding::Auto:
+        return "auto";
+    case Encoding::Utf8:
+        return "utf-8";
+    case Encoding::Utf16le:
+        return "utf-16le";
+    case Encoding::Utf16be:
+        return "utf-16be";
+    case Encoding::Latin1:
+        return "latin1";
+    }
+    return "";
+}
+
+// Index of the first byte from i on that is not ASCII, or s.size(). Logs are
+// mostly ASCII, so this is where the time goes: 64 bytes are tested per step
+// while they are all clear, then 16 at a time to find the byte.
+static size_t ascii_end(std::string_view s, size_t i)
+{
+    const char *p = s.data();
+    const size_t n = s.size();
+#if defined(__SSE2__)
+    for (; i + 64 <= n; i += 64) {
+        const __m128i a = _mm_loadu_si128((const __m128i *)(p + i));
+        const __m128i b = _mm_loadu_si128((const __m128i *)(p + i + 16));
+        const __m128i c = _mm_loadu_si128((const __m128i *)(p + i + 32));
+        const __m128i d = _mm_loadu_si128((const __m128i *)(p + i + 48));
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(a, b), _mm_or_si128(c, d))) != 0)
+            break;
+    }
+    for (; i + 16 <= n; i += 16) {
+        const int m = _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)(p + i)));
+        if (m != 0)
+            return i + (size_t)std::countr_zero((unsigned)m);
+    }
+#else
+    for (; i + 8 <= n; i += 8) {
+        uint64_t w;
+        std::memcpy(&w, p + i, 8);
+        if (w & 0x8080808080808080ull)
+            break;
+    }
+#endif
+    while (i < n && (unsigned char)p[i] < 0x80)
+        ++i;
+    return i;
+}
+
+// The non-ASCII sequence at i, by Unicode table 3-7: its length when it is
+// well-formed, 0 when it is well-formed so far but cut off by the end of s,
+// and minus the length of its maximal invalid subpart otherwise.
+static int sequence(std::string_view s, size_t i)
+{
+    const unsigned char b = (unsigned char)s[i];
+    int need;
+    unsigned char lo = 0x80, hi = 0xBF;
+    if (b >= 0xC2 && b <= 0xDF) {
+        need = 1;
+    } else if (b >= 0xE0 && b <= 0xEF) {
+        need = 2;
+        if (b == 0xE0)
+            lo = 0xA0;
+        else if (b == 0xED)
+            hi = 0x9F;
+    } else if (b >= 0xF0 && b <= 0xF4) {
+        need = 3;
+        if (b == 0xF0)
+            lo = 0x90;
+        else if (b == 0xF4)
+            hi = 0x8F;
+    } else {
+        return -1;
+    }
+
+    for (int k = 1; k <= need; ++k) {
+        if (i + (size_t)k >= s.size())
+            return 0;
+        const unsigned char x = (unsigned char)s[i + (size_t)k];
+        if (x < lo || x > hi)
+            return -k;
+        lo = 0x80;
+        hi = 0xBF;
+    }
+    return need + 1;
+}
+
+static bool bom_prefix(std::string_view s)
+{
+    static constexpr std::string_view boms[] = {"\xEF\xBB\xBF", "\xFF\xFE", "\xFE\xFF"};
+    for (const std::string_view bom : boms) {
+        if (s.size() < bom.size() && bom.starts_with(s))
+            return true;
+    }
+    return false;
+}
+
+// UTF-16 without a byte order mark, from ASCII text: every other byte is NUL,
+// the high half of each unit, and hardly any of the others are.
+static Encoding guess(std::string_view s)
+{
+    const size_t pairs = std::min<size_t>(s.size(), 4096) / 2;
+    if (pairs == 0)
+        return Encoding::Utf8;
+    size_t even = 0, odd = 0;
+    for (size_t k = 0; k < pairs; ++k) {
+        even += s[2 * k] == '\0';
+        odd += s[2 * k + 1] == '\0';
+    }
+    if (odd * 2 >= pairs && even * 8 <= odd)
+        return Encoding::Utf16le;
+    if (even * 2 >= pairs && odd * 8 <= even)
+        return Encoding::Utf16be;
+    return Encoding::Utf8;
+}
+
+size_t Decoder::start(std::string_view data)
+{
+    started_ = true;
+    if (data.starts_with("\xEF\xBB\xBF") && (enc_ == Encoding::Auto || enc_ == Encoding::Utf8)) {
+        enc_ = Encoding::Utf8;
+        return 3;
+    }
+    if (data.starts_with("\xFF\xFE") && (enc_ == Encoding::Auto || enc_ == Encoding::Utf16le)) {
+        enc_ = Encoding::Utf16le;
+        return 2;
+    }
+    if (data.starts_with("\xFE\xFF") && (enc_ == Encoding::Auto || enc_ == Encoding::Utf16be)) {
+        enc_ = Encoding::Utf16be;
+        return 2;
+    }
+    if (enc_ == Encoding::Auto)
+        enc_ = guess(data);
+    return 0;
+}
+
+Decoded Decoder::feed(std::string_view chunk)
+{
+    std::string_view data = chunk;
+    if (!carry_.empty()) {
+        in_.assign(carry_);
+        in_.append(chunk);
+        carry_.clear();
+        data = in_;
+    }
+    const size_t c = data.size() - chunk.size();
+
+    size_t from = 0;
+    if (!started_) {
+        if (bom_prefix(data)) {
+            carry_.assign(data);
+            return {{}, chunk.size(), 0, {}};
+        }
+        from = start(data);
+    }
+    return decode(data, c, from, chunk.size(), false);
+}
+
+Decoded Decoder::flush()
+{
+    if (carry_.empty())
+        return {};
+    in_.swap(carry_);
+    carry_.clear();
+    const size_t from = started_ ? 0 : start(in_);
+    return decode(in_, in_.size(), from, 0, true);
+}
+
+Decoded Decoder::decode(std::string_view data, size_t c, size_t from, size_t raw_size, bool last)
+{
+    switch (enc_) {
+    case Encoding::Utf16le:
+    case Encoding::Utf16be:
+        return utf16(data, c, from, raw_size, last);
+    case Encoding::Latin1:
+        return latin1(data, c, from, raw_size);
+    default:
+        return utf8(data, c, from, raw_size, last);
+    }
+}
+
+Decoded Decoder::utf8(std::string_view data, size_t c, size_t from, size_t raw_size, bool last)
+{
+    if (c == 0) {
+        size_t i = from;
+        int n = 1;
+        while ((i = ascii_end(data, i)) < data.size() && (n = sequence(data, i)) > 0)
+            i += (size_t)n;
+        if (i == data.size())
+            return {data.substr(from), raw_size, from, {}};
+        if (n == 0 && !last) {
+            carry_.assign(data.substr(i));
+            return {data.substr(from, i - from), raw_size, from, {}};
+        }
+    }
+
+    out_.clear();
+    breaks_.clear();
+    size_t i = from;
+    while (i < data.size()) {
+        const size_t a = ascii_end(data, i);
+        append(data.substr(i, a - i), (int64_t)i - (int64_t)c);
+        i = a;
+        if (i == data.size())
+            break;
+        const int n = sequence(data, i);
+        if (n > 0) {
+            out_.append(data.substr(i, (size_t)n));
+            i += (size_t)n;
+        } else if (n == 0 && !last) {
+            carry_.assign(data.substr(i));
+            break;
+        } else {
+            put(0xFFFD);
+            ++replaced_;
+            i += n == 0 ? data.size() - i : (size_t)-n;
+        }
+    }
+    return copied(raw_size);
+}
+
+Decoded Decoder::utf16(std::string_view data, size_t c, size_t from, size_t raw_size, bool last)
+{
+    const bool le = enc_ == Encoding::Utf16le;
+    const auto unit = [&](size_t j) -> uint32_t {
+        const uint32_t a = (unsigned char)data[j], b = (unsigned char)data[j + 1];
+        return le ? a | b << 8 : a << 8 | b;
+    };
+
+    out_.clear();
+    breaks_.clear();
+    size_t i = from;
+    while (i + 2 <= data.size()) {
+        uint32_t u = unit(i);
+        size_t len = 2;
+        if (u >= 0xD800 && u <= 0xDFFF) {
+            if (u <= 0xDBFF && i + 4 > data.size() && !last)
+                break;
+            const uint32_t v = u <= 0xDBFF && i + 4 <= data.size() ? unit(i + 2) : 0;
+            if (v >= 0xDC00 && v <= 0xDFFF) {
+                u = 0x10000 + ((u - 0xD800) << 10) + (v - 0xDC00);
+                len = 4;
+            } else {
+                u = 0xFFFD;
+                ++replaced_;
+            }
+        }
+        put(u);
+        i += len;
+        if (u == '\n' || u == '\r')
+            breaks_.push_back((uint32_t)((int64_t)i - (int64_t)c));
+    }
+    if (i < data.size()) {
+        if (last) {
+            put(0xFFFD);
+            ++replaced_;
+        } else {
+            carry_.assign(data.substr(i));
+        }
+    }
+    return copied(raw_size);
+}
+
+Decoded Decoder::latin1(std::string_view data, size_t c, size_t from, size_t raw_size)
+{
+    if (c == 0 && ascii_end(data, from) == data.size())
+        return {data.substr(from), raw_size, from, {}};
+
+    out_.clear();
+    breaks_.clear();
+    size_t i = from;
+    while (i < data.size()) {
+        const size_t a = ascii_end(data, i);
+        append(data.substr(i, a - i), (int64_t)i - (int64_t)c);
+        if (a == data.size())
+            break;
+        put((unsigned char)data[a]);
+        i = a + 1;
+    }
+    return copied(raw_size);
+}
+
+// ASCII starting at input position raw, relative to the chunk.
+void Decoder::append(std::string_view ascii, int64_t raw)
+{
+    out_.append(ascii);
+    for (size_t k = ascii.find_first_of("\r\n"); k != std::string_view::npos; k = ascii.find_first_of("\r\n", k + 1))
+        breaks_.push_back((uint32_t)(raw + (int64_t)k + 1));
+}
+
+void Decoder::put(uint32_t cp)
+{
+    if (cp < 0x80) {
+        out_ += (char)cp;
+    } else if (cp < 0x800) {
+        out_ += (char)(0xC0 | cp >> 6);
+        out_ += (char)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out_ += (char)(0xE0 | cp >> 12);
+        out_ += (char)(0x80 | (cp >> 6 & 0x3F));
+        out_ += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out_ += (char)(0xF0 | cp >> 18);
+        out_ += (char)(0x80 | (cp >> 12 & 0x3F));
+        out_ += (char)(0x80 | (cp >> 6 & 0x3F));
+        out_ += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+} // namespace vanitas
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <csignal>
+#include <cstdint>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
+#include "vanitas/decoder.hpp"
+
 namespace vanitas {
 
 enum Mode {
@@ -12,8 +17,17 @@ enum Mode {
     Run,
     Pipe,
     ProfileList,
+    Serve,
+    Client,
+    Tui,
+    Replay,
+    Clean,
+    Grep,
 };
 
+// -A/-B/-C at most: context windows are preallocated.
+constexpr size_t max_context = 100000;
+
 struct Args
 {
         Mode mode = Mode::Help;
@@ -22,6 +36,72 @@ struct Args
         std::vector<std::string> cmd;
         bool dump_config = false;
         bool dump_profile = false;
+
+        std::optional<std::vector<std::string>> only;
+        std::optional<std::string> min_severity;
+        bool count = false;
+
+        size_t context_before = 0;
+        size_t context_after = 0;
+        bool context_lines = false;
+
+        bool watch = false;
+
+        // what the input bytes are; offsets keep counting them
+        Encoding encoding = Encoding::Auto;
+
+        // file: analyze a window instead of the whole file
+        uint64_t tail_bytes = 0;
+        uint64_t tail_blocks = 0;
+        std::optional<std::pair<uint64_t, uint64_t>> range; // [begin, end)
+
+        // file, pipe, run: compare with / record a .vfp fingerprint set
+        std::optional<std::string> baseline;
+        std::optional<std::string> save_baseline;
+
+        // file, pipe, run: stop after this many errors (0 = never); run signals its child
+        size_t fail_fast = 0;
+        int fail_signal = SIGTERM;
+        bool exit_on_error = false;
+
+        // pipe, run: shed classifier work when the input waiting would take this
+        // long (seconds) to get through; one value doubles for each further level
+        std::vector<double> shed_after;
+
+        // file, pipe, run: time window of the items, histogram bucket size
+        std::optional<std::string> since;
+        std::optional<std::string> until;
+        std::optional<std::string> histogram;
+        // file, pipe, run: follow gtest/pytest/ctest results and print a summary at the end
+        bool test_summary = false;
+        // file, pipe, run, replay: also write the input's clean text here
+        std::optional<std::string> tee_clean;
+
+        std::optional<std::string> format;
+        bool line_numbers = false;
+
+        // run: also write the child's raw output to a .vrec file
+        std::optional<std::string> record;
+        // replay: a multiple of the recorded pace, 0 = as fast as possible
+        double replay_speed = 0;
+        // clean: where the text goes instead of stdout; file is the input, stdin if empty or "-"
+        std::optional<std::string> clean_output;
+
+        // grep: a regex matched against whole cases; the index under ~/.vanitas/cache/grep
+        // is brought up to date first unless no_index, written anew with reindex
+        std::string pattern;
+        bool ignore_case = false;
+        bool no_index = false;
+        bool reindex = false;
+
+        // run -j: up to this many commands at once, from `--` groups or a file of shell lines
+        size_t jobs = 0;
+        std::optional<std::string> job_file; // "-" = stdin
+        std::vector<std::vector<std::string>> job_cmds;
+
+        std::string socket;
+        size_t workers = 0;
+        size_t bench = 0;
 };
 
 class ArgsParser
@@ -39,6 +119,12 @@ class ArgsParser
         Args parse_run(int start, Args out);
         Args parse_help();
         Args parse_profile(int start, Args out);
+        Args parse_serve(int start, Args out);
+        Args parse_client(int start, Args out);
+        Args parse_tui(int start, Args out);
+        Args parse_replay(int start, Args out);
+        Args parse_clean(int start, Args out);
+        Args parse_grep(int start, Args out);
 };
 
 } // namespace vanitas
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "vanitas/classifier.hpp"
+
+namespace vanitas {
+
+// Hash of an item's type and block text with the parts that change from run
+// to run (numbers, hex, timestamps, pids, spacing) collapsed, so the same
+// error in two runs gets the same fingerprint.
+uint64_t fingerprint(const Item &it);
+
+// Fingerprints of a previous run, read from a .vfp file: a 24 byte header,
+// with the item types the run reported, followed by the sorted, unique
+// fingerprints as native u64. The file is
+// mapped, not read; a radix table over the top 16 bits keeps a probe to a
+// few cache lines whatever the size, and only the probed pages are touched.
+class Baseline
+{
+    public:
+        explicit Baseline(const std::string &path);
+        ~Baseline();
+        Baseline(const Baseline &) = delete;
+        Baseline &operator=(const Baseline &) = delete;
+
+        // Marks a found fingerprint as seen.
+        bool contains(uint64_t fp);
+
+        size_t size() const { return n_; }
+        unsigned types() const { return types_; }
+        size_t unseen() const { return n_ - seen_count_; }
+
+        // Sorts and deduplicates fps in place; types: those fingerprinted (type_bit).
+        static void save(const std::string &path, std::vector<uint64_t> &fps, unsigned types);
+
+    private:
+        void *map_ = nullptr;
+        size_t map_size_ = 0;
+        const uint64_t *fps_ = nullptr;
+        size_t n_ = 0;
+        unsigned types_ = 0;
+
+        std::vector<uint32_t> radix_; // first index per top-16-bit prefix, plus n
+        std::vector<uint64_t> seen_;  // bit per fingerprint
+        size_t seen_count_ = 0;
+};
+
+} // namespace vanitas
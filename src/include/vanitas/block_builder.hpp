@@ -1,35 +1,153 @@
 #pragma once
 
+#include <cstdint>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "vanitas/profile.hpp"
+#include "vanitas/profile_slot.hpp"
 
 namespace vanitas {
 
 struct Event; // vanitas::Event
 
+// Lines of a block stored back to back in one buffer, separated by '\n',
+// with the start offset of every line alongside. offset is the input position
+// of the first line and first_line its physical line number, so the raw block
+// can be read back from the input later.
+// source names the stream the lines came from in demultiplexed input. time is
+// the timestamp of the first line (ms since the epoch, UTC), or that of the
+// block before when the first line has none; 0 if unknown. head_index is the
+// line that names the block, past the lead-in lines a Correlator joined to it.
 struct Block
 {
-        std::vector<std::string> lines;
+        std::pmr::string text;
+        std::pmr::vector<size_t> starts;
         bool has_status = false;
+        uint64_t offset = 0;
+        uint64_t first_line = 0;
+        int64_t time = 0;
+        size_t head_index = 0;
+        std::pmr::string source;
+
+        Block() = default;
+        explicit Block(std::pmr::memory_resource *mr) : text(mr), starts(mr), source(mr) {}
+        Block(const Block &other, std::pmr::memory_resource *mr)
+            : text(other.text, mr), starts(other.starts, mr), has_status(other.has_status), offset(other.offset),
+              first_line(other.first_line), time(other.time), head_index(other.head_index), source(other.source, mr)
+        {
+        }
+
+        size_t size() const { return starts.size(); }
+        bool empty() const { return starts.empty(); }
+
+        std::string_view line(size_t i) const
+        {
+            const size_t end = i + 1 < starts.size() ? starts[i + 1] - 1 : text.size();
+            return std::string_view(text).substr(starts[i], end - starts[i]);
+        }
+        std::string_view head() const { return line(head_index); }
+
+        void add_line(std::string_view s)
+        {
+            if (!starts.empty())
+                text.push_back('\n');
+            starts.push_back(text.size());
+            text.append(s);
+        }
+
+        // Lines of another block after these.
+        void append(const Block &other)
+        {
+            const size_t base = starts.empty() ? 0 : text.size() + 1;
+            if (!starts.empty())
+                text.push_back('\n');
+            for (size_t s : other.starts)
+                starts.push_back(base + s);
+            text.append(other.text);
+            has_status = has_status || other.has_status;
+        }
+
+        void clear()
+        {
+            text.clear();
+            starts.clear();
+            has_status = false;
+            offset = 0;
+            first_line = 0;
+            time = 0;
+            head_index = 0;
+        }
+};
+
+// Blocks produced by one push(), allocated from a monotonic arena. Items
+// point into this storage, so recycle() only once they have been written out.
+class BlockBatch
+{
+    public:
+        BlockBatch();
+        BlockBatch(const BlockBatch &) = delete;
+        BlockBatch &operator=(const BlockBatch &) = delete;
+
+        std::pmr::vector<Block> &blocks() { return blocks_; }
+        const std::pmr::vector<Block> &blocks() const { return blocks_; }
+
+        std::pmr::memory_resource *resource() { return &arena_; }
+        void recycle();
+
+    private:
+        std::vector<std::byte> initial_;
+        std::pmr::monotonic_buffer_resource arena_;
+        std::pmr::vector<Block> blocks_;
+};
+
+// Joins the blocks of one compiler diagnostic by the profile's [correlate]
+// rules (see Correlation) on their way from a BlockBuilder to the batch. At
+// most one chain is open, of at most max_lead + 1 + max_follow blocks, so an
+// endless stream is held in bounded memory.
+class Correlator
+{
+    public:
+        // b is complete; it, or the chain it closes, is added to out
+        void push(const Profile &p, const Block &b, BlockBatch &out);
+        void flush(BlockBatch &out);
+
+    private:
+        enum class State {
+            Empty,
+            Leads, // only lead-in blocks so far
+            Owner, // the diagnostic itself is in, follow blocks may come
+        };
+        State state_ = State::Empty;
+        Block chain_;
+        size_t leads_ = 0;
+        size_t follows_ = 0;
 };
 
 class BlockBuilder
 {
     public:
-        BlockBuilder(const Profile &p);
+        BlockBuilder(ProfilePtr p, std::string_view source = {});
+
+        void flush(BlockBatch &out);
+        void push(const std::vector<Event> &events, BlockBatch &out);
+        void push(const Event &ev, BlockBatch &out);
+
+        // Whether a line opens a new block rather than continuing the current one.
+        static bool starts_block(const Profile &p, std::string_view line);
 
-        std::vector<Block> flush();
-        std::vector<Block> push(const std::vector<Event> &events);
+        // Takes effect from the next line; the block being built is kept.
+        void set_profile(ProfilePtr p) { p_ = std::move(p); }
 
     private:
-        const Profile &p_;
+        ProfilePtr p_;
         Block current_;
         bool has_current_;
+        int64_t last_time_ = 0;
+        Correlator correlate_;
 
-        bool is_firstline(std::string_view s);
-        bool is_continuation(std::string_view s);
+        void finish_block(BlockBatch &out);
 };
 
 } // namespace vanitas
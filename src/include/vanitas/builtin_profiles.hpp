@@ -0,0 +1,44 @@
+#pragma once
+
+#include <span>
+#include <string_view>
+
+#include "vanitas/profile.hpp"
+
+namespace vanitas {
+
+// A rule of a built-in profile: its pattern, as a profile file would spell it,
+// and a matcher generated for exactly that pattern at compile time.
+struct BuiltinRule
+{
+        std::string_view pattern;
+        RuleMatcher match;
+};
+
+using BuiltinRules = std::span<const BuiltinRule>;
+
+// Profiles compiled into the binary. They resolve like file profiles, after
+// [profiles.*] in config.toml and ~/.vanitas/profiles/<name>.toml, so a file of
+// the same name replaces one, and they serve as `extends` bases without any
+// file existing. Lists left empty are inherited from default.
+struct BuiltinProfile
+{
+        std::string_view name;
+        std::string_view about; // one line for `vanitas profile list`
+
+        BuiltinRules firstline = {};
+        BuiltinRules continuation = {};
+        BuiltinRules err = {};
+        BuiltinRules wrn = {};
+        BuiltinRules tests = {};
+        BuiltinRules lead = {};   // [correlate]
+        BuiltinRules follow = {}; // [correlate]
+};
+
+std::span<const BuiltinProfile> builtin_profiles();
+const BuiltinProfile *find_builtin_profile(std::string_view name);
+
+// The compiled matcher of a built-in pattern, null for any other pattern.
+RuleMatcher builtin_matcher(std::string_view pattern);
+
+} // namespace vanitas
@@ -1,15 +1,22 @@
 #pragma once
 
-#include <iostream>
+#include <cstdint>
+#include <memory_resource>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
-#include "vanitas/profile.hpp"
+#include "vanitas/profile_slot.hpp"
+#include "vanitas/ring_buffer.hpp"
+#include "vanitas/rule_order.hpp"
 
 namespace vanitas {
 
-struct Event; // vanitas::Event
-struct Block; // vanitas::Block
+struct Event;      // vanitas::Event
+struct Block;      // vanitas::Block
+class BlockBatch; // vanitas::BlockBatch
+struct Record;     // vanitas::Record
 
 enum Type {
     Info,
@@ -18,42 +25,131 @@ enum Type {
     Tests,
 };
 
+constexpr unsigned type_bit(Type t) { return 1u << t; }
+constexpr unsigned all_types = type_bit(Info) | type_bit(Error) | type_bit(Warn) | type_bit(Tests);
+
+// Which item types the pipeline should produce. Types outside the mask are dropped
+// inside the classifier, before any copy of the block is made.
+struct Filter
+{
+        unsigned types = all_types;
+        bool count_only = false;
+
+        bool wants(Type t) const { return (types & type_bit(t)) != 0; }
+};
+
+// -B/-A context around Error/Warn items, counted in blocks or in lines.
+// Only blocks that are not reported themselves are captured as context.
+struct ContextOptions
+{
+        size_t before = 0;
+        size_t after = 0;
+        bool lines = false;
+
+        bool enabled() const { return before > 0 || after > 0; }
+};
+
+unsigned parse_type_names(const std::vector<std::string> &names);
+unsigned min_severity_types(const std::string &name);
+
+// Views into the BlockBatch the item was classified from (or into the
+// classifier when the item was held back for context). Valid until the batch
+// is recycled or the classifier is called again, whichever comes first.
 struct Item
 {
         Type type;
-        std::string text;
-        std::string details;
+        std::string_view text;
+        std::string_view details;
+        std::string_view before; // context lines preceding the block (Error/Warn only)
+        std::string_view after;  // context lines following the block (Error/Warn only)
+        uint64_t offset = 0;     // input position of the block
+        uint64_t line = 0;       // physical line of the block's first line, 0 if unknown
+        std::string_view source; // stream the block came from, empty unless demultiplexed
+        int64_t time = 0;        // of the block, ms since the epoch (UTC), 0 if unknown
+};
+
+// What the classifier leaves out under load, in the order the LoadGovernor
+// gives it up. Error detection is never shed.
+enum class Shed {
+    None,
+    Tests,    // tests rules are not run; such blocks count as info
+    Info,     // info blocks are counted, not turned into items
+    Sample,   // warn rules run on 1 in shed_sample_every blocks the err rules turn down
+    FastPath, // warn rules are not run, only the WRN tag is seen
 };
 
-static void print_items(const std::vector<vanitas::Item> &items)
+constexpr size_t shed_sample_every = 8;
+
+// Blocks that got less work than usual because of shedding.
+struct ShedCounts
+{
+        size_t tests = 0; // not tried as tests
+        size_t info = 0;  // info items not made
+        size_t warn = 0;  // not tried as warnings
+        Shed worst = Shed::None;
+
+        bool any() const { return worst != Shed::None; }
+};
+
+struct Counts
 {
-    for (auto &it : items) {
-        switch (it.type) {
-        case vanitas::Type::Error:
-            std::cout << "ERROR: " << it.text << "\n";
-            break;
-        case vanitas::Type::Warn:
-            std::cout << "WARN:  " << it.text << "\n";
-            break;
-        case vanitas::Type::Tests:
-            std::cout << "TESTS: " << it.text << "\n";
-            break;
-        default:
-            std::cout << "INFO:  " << it.text << "\n";
-            break;
-        }
-    }
-}
+        size_t errors = 0;
+        size_t warnings = 0;
+        size_t tests = 0;
+        size_t info = 0;
+        ShedCounts shed;
+};
 
 class Classifier
 {
     public:
-        Classifier(const Profile &p);
-        std::vector<Item> classify(const std::vector<Block> &blocks);
+        Classifier(ProfilePtr p, Filter f = {}, ContextOptions ctx = {});
+        std::vector<Item> classify(const BlockBatch &batch);
+        std::vector<Item> flush();
+
+        const Counts &counts() const { return counts_; }
+        void set_profile(ProfilePtr p);
+        void shed(Shed level);
 
     private:
-        const Profile &p_;
-        size_t errors_count;
-        size_t warn_count;
+        ProfilePtr p_;
+        Filter f_;
+        Counts counts_;
+
+        RuleOrder err_order_;
+        RuleOrder wrn_order_;
+        RuleOrder tests_order_;
+
+        Shed shed_ = Shed::None;
+        size_t sampled_ = 0;
+
+        ContextOptions ctx_;
+        RingBuffer<std::string> ring_;
+        std::vector<Item> held_; // items queued behind an Error/Warn still collecting trailing context
+        size_t owner_ = 0;       // index in held_ of that Error/Warn
+        size_t after_left_ = 0;
+        std::string before_buf_;
+        std::string after_buf_; // trailing context of held_[owner_] while it is collected
+        // copies of held items and of their context; two, so that what is
+        // still held moves to the other and the one behind is freed each batch
+        std::pmr::monotonic_buffer_resource kept_[2];
+        size_t cur_kept_ = 0;
+
+        std::string unescaped_;
+
+        void reset_rules();
+        void learn();
+        std::optional<Type> detect(const Block &bl);
+        bool try_warn();
+        std::optional<Type> detect(const Record &r) const;
+        std::string_view message(const Record &r, std::string_view head);
+        void count(Type t);
+        void emit(Item it, size_t units, std::vector<Item> &out);
+        void hold(Item it);
+        void close_owner();
+        std::string_view keep(std::string_view s);
+        void recycle_kept();
+        void keep_context(const Block &bl, std::vector<Item> &out);
+        void release_held(std::vector<Item> &out);
 };
 } // namespace vanitas
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <future>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vanitas/normalizer.hpp"
+
+namespace vanitas {
+
+// The text of a log with only the Normalizer's work done: escape sequences
+// gone, a line rewritten with '\r' reduced to what it showed last, one '\n'
+// per line. Lines are gathered into a large buffer; a full one is written a
+// megabyte at a time on another thread while the next fills, so the caller
+// only pays for the copy.
+class CleanWriter
+{
+    public:
+        // Creates or truncates path.
+        explicit CleanWriter(const std::string &path);
+        // Writes to fd, which stays open.
+        explicit CleanWriter(int fd) : fd_(fd) {}
+        ~CleanWriter();
+        CleanWriter(const CleanWriter &) = delete;
+        CleanWriter &operator=(const CleanWriter &) = delete;
+
+        void push(const std::vector<Event> &events);
+        // Writes what is buffered, and a last line that was left without a '\n'.
+        void finish();
+
+        uint64_t lines() const { return lines_; }
+
+    private:
+        static constexpr size_t buffer_bytes = 1024 * 1024;
+
+        std::string path_; // for messages, empty for a plain fd
+        int fd_ = -1;
+        bool owned_ = false;
+        std::string buf_;
+        std::string spare_; // being written by inflight_
+        std::future<void> inflight_;
+        std::string status_; // text of the last '\r' since the last line
+        bool has_status_ = false;
+        uint64_t lines_ = 0;
+
+        void line(std::string_view text);
+        void wait();
+        void write_all(const std::string &s);
+};
+
+} // namespace vanitas
@@ -3,6 +3,7 @@
 #include <optional>
 #include <string>
 #include <toml.hpp>
+#include <vector>
 
 namespace vanitas {
 
@@ -11,6 +12,9 @@ struct Config
         std::optional<std::string> profile;
         bool color = true;
         std::string format = "text";
+        std::vector<std::string> only;
+        std::optional<std::string> min_severity;
+        bool learn_rule_order = false; // keep classify rule statistics per profile under ~/.vanitas/cache
 };
 
 Config load_user_config();
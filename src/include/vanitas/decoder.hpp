@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace vanitas {
+
+enum class Encoding {
+    Auto,
+    Utf8,
+    Utf16le,
+    Utf16be,
+    Latin1,
+};
+
+Encoding parse_encoding(const std::string &name);
+const char *encoding_name(Encoding e);
+
+// Text decoded from an input chunk of raw_size bytes. Its line ends map back to
+// the input, so offsets keep counting input bytes: when text is a copy,
+// breaks[k] is the position in the chunk just past the k-th '\n' or '\r' of
+// it; when text is the chunk itself from lead on, breaks is empty.
+struct Decoded
+{
+        std::string_view text;
+        size_t raw_size = 0;
+        size_t lead = 0;
+        std::span<const uint32_t> breaks;
+};
+
+// Ahead of the Normalizer: turns the input into valid UTF-8. Auto reads a
+// UTF-8 or UTF-16 byte order mark, or UTF-16 without one from where the NULs
+// of its ASCII fall, and otherwise takes UTF-8; Latin-1 is only ever chosen.
+// Invalid UTF-8 and unpaired surrogates become U+FFFD, one per maximal
+// invalid subpart. Valid UTF-8 is checked 16 bytes at a time while it is ASCII
+// and handed on as the input itself, without a copy; a chunk is copied only
+// when something in it is replaced, or a character straddles its start.
+class Decoder
+{
+    public:
+        explicit Decoder(Encoding e = Encoding::Auto) : enc_(e) {}
+
+        // The views stay valid until the next call, like the chunk they may point into.
+        Decoded feed(std::string_view chunk);
+        // What is left of an incomplete character at the end, as U+FFFD.
+        Decoded flush();
+
+        // Auto until the first bytes decided it.
+        Encoding encoding() const { return enc_; }
+        size_t replaced() const { return replaced_; }
+
+    private:
+        Encoding enc_;
+        bool started_ = false;
+        std::string carry_; // start of a character the chunk ended in, or of a byte order mark
+        std::string in_;    // carry_ followed by the chunk
+        std::string out_;
+        std::vector<uint32_t> breaks_;
+        size_t replaced_ = 0;
+
+        // data: carry_ and then the chunk, c the length of carry_, decoded from
+        // from on; last: nothing follows, an incomplete character is replaced
+        size_t start(std::string_view data);
+        Decoded decode(std::string_view data, size_t c, size_t from, size_t raw_size, bool last);
+        Decoded utf8(std::string_view data, size_t c, size_t from, size_t raw_size, bool last);
+        Decoded utf16(std::string_view data, size_t c, size_t from, size_t raw_size, bool last);
+        Decoded latin1(std::string_view data, size_t c, size_t from, size_t raw_size);
+        Decoded copied(size_t raw_size) const { return {out_, raw_size, 0, breaks_}; }
+        void append(std::string_view ascii, int64_t raw);
+        void put(uint32_t cp);
+};
+
+} // namespace vanitas
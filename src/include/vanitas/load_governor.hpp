@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+#include "vanitas/classifier.hpp"
+
+namespace vanitas {
+
+// Lag, in seconds, at which each further Shed level starts: lag[0] turns on
+// Shed::Tests, lag[3] Shed::FastPath.
+struct ShedThresholds
+{
+        std::array<double, 4> lag{};
+
+        // t, 2t, 4t, 8t
+        static ShedThresholds doubling(double t) { return {{t, 2 * t, 4 * t, 8 * t}}; }
+};
+
+// Decides how much the classifier sheds (run and pipe --shed-after). The
+// caller brackets the analysis of each chunk with begin()/end() and says how
+// many input bytes are still waiting. Lag is how long input has been kept
+// waiting: since the begin() that followed the last end() with no more than
+// a chunk left, as till then input was taken as it came. A pipe holds at
+// most a second or so of input, and a full one stops the writer, so its fill
+// alone cannot tell minutes behind; what is waiting, at the rate analysis has
+// been going, is the lower bound. The level moves one step at a time and not
+// again for settle of clock time, up when lag passes the next threshold, down
+// when it is under half the current one. Time comes only from the clock given,
+// so a fake one makes every decision reproducible.
+class LoadGovernor
+{
+    public:
+        using Clock = std::chrono::steady_clock;
+        using Now = std::function<Clock::time_point()>;
+
+        static constexpr std::chrono::milliseconds settle{500};
+
+        explicit LoadGovernor(ShedThresholds t, Now now = Clock::now);
+
+        void begin();
+        // bytes: analyzed since begin(); backlog: input that is waiting
+        void end(size_t bytes, size_t backlog);
+
+        Shed level() const { return level_; }
+        // seconds, as of the last end()
+        double lag() const { return lag_; }
+
+    private:
+        ShedThresholds t_;
+        Now now_;
+        Shed level_ = Shed::None;
+        Clock::time_point started_{};
+        Clock::time_point changed_{};
+        Clock::time_point waiting_since_{};
+        bool caught_up_ = true; // the last end() left no more than a chunk waiting
+        double rate_ = 0; // bytes per second of analysis, smoothed
+        double lag_ = 0;
+};
+
+} // namespace vanitas
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "vanitas/decoder.hpp"
+
 namespace vanitas {
 
 enum EvKind {
@@ -10,18 +14,35 @@ enum EvKind {
     Status
 };
 
+// text points into the normalizer and stays valid until its next feed()/flush().
+// offset is where the raw line starts in the input, counted from the first feed();
+// line is its 1-based physical line ('\r' overwrites stay on the same line), or 0
+// when unknown because the input was entered in the middle.
 struct Event
 {
         EvKind kind;
-        std::string text;
+        std::string_view text;
+        uint64_t offset = 0;
+        uint64_t line = 1;
 };
 
 class Normalizer
 {
     public:
+        // Input that is UTF-8 already; offsets count its bytes.
         std::vector<Event> feed(std::string_view chunk);
+        // Decoder output; offsets count the bytes it was decoded from.
+        std::vector<Event> feed(const Decoded &in);
         std::vector<Event> flush();
 
+        // Position of the next byte fed, when the input does not start at the
+        // beginning of a file; line 0 = unknown. Only at a line boundary.
+        void seek(uint64_t offset, uint64_t line)
+        {
+            pos_ = line_start_ = offset;
+            line_no_ = line;
+        }
+
     private:
         enum class State {
             Text,
@@ -31,6 +52,13 @@ class Normalizer
         State state_ = State::Text;
         std::string line_;
         bool last_was_cr_ = false;
+        uint64_t pos_ = 0;        // input bytes consumed before the current chunk
+        uint64_t line_start_ = 0; // input offset of line_
+        uint64_t line_no_ = 1;    // physical line of line_
+
+        std::string out_; // text of the events returned by the last call
+
+        void emit(std::vector<Event> &out, EvKind kind, uint64_t next_start);
 };
 
 } // namespace vanitas
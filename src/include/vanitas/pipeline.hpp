@@ -0,0 +1,67 @@
+#pragma once
+
+#include <functional>
+#include <string_view>
+#include <vector>
+
+#include "vanitas/block_builder.hpp"
+#include "vanitas/classifier.hpp"
+#include "vanitas/clean_writer.hpp"
+#include "vanitas/decoder.hpp"
+#include "vanitas/normalizer.hpp"
+#include "vanitas/profile_slot.hpp"
+#include "vanitas/source_demux.hpp"
+#include "vanitas/test_tracker.hpp"
+
+namespace vanitas {
+
+// Incremental Normalizer -> BlockBuilder (per source) -> Classifier chain: push raw bytes
+// in any chunking with feed(), get items through the sink. The Item passed to
+// the sink (and the strings it views) is only valid during the call.
+class Pipeline
+{
+    public:
+        using Sink = std::function<void(const Item &)>;
+
+        Pipeline(ProfilePtr p, Sink sink, Filter f = {}, ContextOptions ctx = {});
+        // Follows the slot: a newly published profile applies from the next feed().
+        Pipeline(const ProfileSlot &slot, Sink sink, Filter f = {}, ContextOptions ctx = {});
+
+        // see Normalizer::seek; before the first feed()
+        void seek(uint64_t offset, uint64_t line) { norm_.seek(offset, line); }
+        // Input encoding (--encoding), auto-detected unless set; before the first feed()
+        void decode(Encoding e) { decoder_ = Decoder(e); }
+        // the one set, or the one the first bytes decided; Auto before them
+        Encoding encoding() const { return decoder_.encoding(); }
+        // see Classifier::shed; from the next feed() on
+        void shed(Shed level) { classifier_.shed(level); }
+
+        // Also hands every line to t (--test-summary); it must outlive the pipeline.
+        void track_tests(TestTracker *t) { tests_ = t; }
+        // Also writes every line to w (--tee-clean); it must outlive the pipeline.
+        void tee_clean(CleanWriter *w) { clean_ = w; }
+
+        void feed(std::string_view bytes);
+        void finish();
+
+        const Counts &counts() const { return classifier_.counts(); }
+
+    private:
+        const ProfileSlot *slot_ = nullptr;
+        uint64_t generation_ = 0;
+
+        Decoder decoder_;
+        Normalizer norm_;
+        SourceDemux builder_;
+        Classifier classifier_;
+        BlockBatch batch_;
+        Sink sink_;
+        TestTracker *tests_ = nullptr;
+        CleanWriter *clean_ = nullptr;
+
+        void push(const std::vector<Event> &events);
+        void deliver(const std::vector<Item> &items);
+        void refresh_profile();
+};
+
+} // namespace vanitas
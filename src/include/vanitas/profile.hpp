@@ -1,21 +1,110 @@
 #pragma once
 
+#include <memory>
+#include <optional>
 #include <regex>
+#include <string>
+#include <string_view>
 #include <vector>
 
+#include "vanitas/timestamp.hpp"
+
 namespace vanitas {
+
+using RuleMatcher = bool (*)(std::string_view);
+
+// A rule of a profile. A pattern of a built-in profile runs the matcher
+// compiled for it (vanitas/builtin_profiles.hpp) and never builds a regex. For
+// others, literal is text every match contains, read off the pattern when it
+// has some; a line without it is turned down by a plain find before the regex
+// runs. anchored: the literal starts every match at the start of the line.
+// exact: the pattern is the literal and nothing else, the regex never runs.
+struct Rule
+{
+        std::string pattern;
+        RuleMatcher match = nullptr;
+        std::regex re;
+        std::string literal;
+        bool anchored = false;
+        bool exact = false;
+
+        explicit Rule(const std::string &pat);
+        bool search(std::string_view s) const;
+};
+
+// Interleaved output of many sources ("svc-a  | line", as docker compose or
+// kubectl --prefix print it). The source is what precedes the first separator
+// (right-trimmed), or group 1 of pattern; the matched prefix is stripped.
+struct SourcePrefix
+{
+        std::string separator;
+        std::optional<std::regex> pattern;
+        size_t max_sources = 4096; // idle sources beyond this are flushed and forgotten
+
+        bool enabled() const { return !separator.empty() || pattern.has_value(); }
+
+        // false when the line carries no prefix
+        bool split(std::string_view line, std::string_view &source, std::string_view &rest) const;
+};
+
+// Logs that carry their severity in a field: JSON lines ({"level":"error",...})
+// or logfmt (level=warn msg=...). A record line opens a block and is classified
+// by its level field alone, without regexes; lines that are not records (stack
+// traces printed after one) continue its block unless a firstline rule matches.
+struct StructuredLog
+{
+        enum class Format {
+            None,
+            Json,
+            Logfmt,
+        };
+
+        Format format = Format::None;
+        std::vector<std::string> level = {"level", "lvl", "severity"}; // field names, first found wins
+        std::vector<std::string> message = {"msg", "message"};
+        std::vector<std::string> error = {"error", "err", "fatal", "critical", "crit", "panic", "alert", "emerg"};
+        std::vector<std::string> warn = {"warn", "warning"}; // level values, lower case; others are info
+
+        bool enabled() const { return format != Format::None; }
+};
+
+// Compilers print one diagnostic as several blocks. Lead-in blocks ("In file
+// included from", "In instantiation of", "required from") are joined to the
+// block after them, follow blocks (notes, source excerpts) to the block
+// before, so an error and its whole chain make one item. Both lists match the
+// head line of a block; the limits bound what is held while a chain is open.
+struct Correlation
+{
+        std::vector<Rule> lead;
+        std::vector<Rule> follow;
+        size_t max_lead = 64;    // lead-in blocks waiting for the block they introduce
+        size_t max_follow = 256; // blocks joined to one diagnostic
+
+        bool enabled() const { return !lead.empty() || !follow.empty(); }
+};
+
+class RuleLearner; // vanitas/rule_order.hpp
+
 struct Profile
 {
-        std::vector<std::regex> firstline;
-        std::vector<std::regex> continuation;
+        std::vector<Rule> firstline;
+        std::vector<Rule> continuation;
+
+        std::vector<Rule> err;
+        std::vector<Rule> wrn;
+        std::vector<Rule> tests;
+
+        SourcePrefix source;
+        StructuredLog structured;
+        TimestampFormat timestamp;
+        Correlation correlate;
 
-        std::vector<std::regex> err;
-        std::vector<std::regex> wrn;
-        std::vector<std::regex> tests;
+        // keeps the rule statistics of this profile between runs, null unless enabled
+        std::shared_ptr<RuleLearner> learner;
 };
 
-bool any_match(const std::vector<std::regex> &rs, std::string_view s);
-bool any_search(const std::vector<std::regex> &rs, const std::string &s);
+bool any_match(const std::vector<Rule> &rs, std::string_view s);
+bool any_search(const std::vector<Rule> &rs, std::string_view s);
 Profile default_profile();
 
 } // namespace vanitas
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas {
+
+struct ProfileCandidate
+{
+        std::string name;
+        ProfilePtr profile;
+};
+
+// How well a profile's rules explain a sample of the input.
+struct ProfileScore
+{
+        size_t lines = 0;
+        size_t explained = 0; // lines a firstline/continuation rule (or the structured format) recognizes
+        size_t blocks = 0;
+        size_t flagged = 0; // blocks classified as error, warning or tests
+        double score = 0;
+};
+
+ProfileScore score_profile(const Profile &p, const std::vector<std::string_view> &lines);
+
+// Scores every candidate on the sample, in parallel, and returns the index of
+// the best one. Ties and all-zero scores go to the earliest candidate, so the
+// fallback profile belongs first. scores, if given, receives one per candidate.
+size_t detect_profile(const std::vector<ProfileCandidate> &candidates, std::string_view sample,
+                      std::vector<ProfileScore> *scores = nullptr);
+
+} // namespace vanitas
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <filesystem>
+#include <string>
+#include <vector>
 #include <toml.hpp>
 
 #include "vanitas/profile.hpp"
@@ -10,10 +12,10 @@ namespace vanitas {
 class ProfileManager
 {
     public:
-        void ensure_default_profiles();
         Profile load(const std::string &name_or_path);
         Profile load_from_value(const Profile &base, const toml::value &v);
 
+        // nullopt if there is no such file; throws if there is one that does not parse
         std::optional<toml::value> try_load_file_value(const std::string &name_or_path);
 
         struct ProfileValueSource
@@ -26,6 +28,9 @@ class ProfileManager
         toml::value merge_profile_values(const toml::value &base, const toml::value &overlay);
         Profile load_effective(const std::string &name, const std::optional<toml::value> &cfgv);
 
+        // [profiles.*] from config, *.toml in profiles_dir() and the built-in ones, sorted, each once
+        std::vector<std::string> profile_names(const std::optional<toml::value> &cfgv) const;
+
         std::filesystem::path base_dir() const;
         std::filesystem::path profiles_dir() const;
 };
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "vanitas/profile.hpp"
+
+namespace vanitas {
+
+using ProfilePtr = std::shared_ptr<const Profile>;
+
+// Holds the current compiled profile as an immutable snapshot. Writers publish
+// a whole new Profile; readers poll generation() (a single acquire load) and
+// only take a new snapshot when it moved, so the hot path never waits on a lock
+// and in-flight batches keep the snapshot they started with.
+class ProfileSlot
+{
+    public:
+        explicit ProfileSlot(ProfilePtr p) : cur_(std::move(p)) {}
+
+        ProfilePtr load() const { return cur_.load(std::memory_order_acquire); }
+        uint64_t generation() const { return gen_.load(std::memory_order_acquire); }
+
+        void publish(ProfilePtr p)
+        {
+            cur_.store(std::move(p), std::memory_order_release);
+            gen_.fetch_add(1, std::memory_order_acq_rel);
+        }
+
+    private:
+        std::atomic<ProfilePtr> cur_;
+        std::atomic<uint64_t> gen_{0};
+};
+
+} // namespace vanitas
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "vanitas/profile_manager.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas {
+
+// Watches ~/.vanitas/config.toml and ~/.vanitas/profiles/ with inotify (a
+// directory not created yet through the nearest one above it that exists) and,
+// on change, recompiles every tracked profile (extends included) on its own
+// thread and publishes it into the slot, with the learner of the one it
+// replaces. A profile that fails to load or compile is reported and the
+// previous one stays active.
+class ProfileWatcher
+{
+    public:
+        explicit ProfileWatcher(ProfileManager &pm) : pm_(pm) {}
+        ~ProfileWatcher();
+
+        ProfileWatcher(const ProfileWatcher &) = delete;
+        ProfileWatcher &operator=(const ProfileWatcher &) = delete;
+
+        void track(const std::string &name, std::shared_ptr<ProfileSlot> slot);
+
+        // false when inotify is not available; profiles then simply stay as loaded
+        bool start();
+
+    private:
+        struct Tracked
+        {
+                std::string name;
+                std::shared_ptr<ProfileSlot> slot;
+        };
+
+        ProfileManager &pm_;
+        std::mutex m_;
+        std::vector<Tracked> tracked_;
+
+        std::vector<std::filesystem::path> watched_;
+        int inotify_fd_ = -1;
+        int stop_fd_ = -1;
+        std::thread thread_;
+
+        bool add_watches();
+        void run();
+        void reload_all();
+};
+
+} // namespace vanitas
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace vanitas {
+
+// Fixed-capacity FIFO: pushing into a full buffer overwrites the oldest slot.
+// Slots are reused in place, so strings keep their capacity between pushes.
+template <typename T> class RingBuffer
+{
+    public:
+        explicit RingBuffer(size_t capacity = 0) : slots_(capacity) {}
+
+        size_t capacity() const { return slots_.size(); }
+        size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+
+        // Slot for the next element; the caller overwrites its contents.
+        T &push_slot()
+        {
+            size_t idx = (head_ + size_) % slots_.size();
+            if (size_ == slots_.size())
+                head_ = (head_ + 1) % slots_.size();
+            else
+                ++size_;
+            return slots_[idx];
+        }
+
+        // Visits elements oldest to newest and empties the buffer.
+        template <typename F> void drain(F &&f)
+        {
+            for (size_t i = 0; i < size_; ++i)
+                f(slots_[(head_ + i) % slots_.size()]);
+            clear();
+        }
+
+        void clear()
+        {
+            head_ = 0;
+            size_ = 0;
+        }
+
+    private:
+        std::vector<T> slots_;
+        size_t head_ = 0;
+        size_t size_ = 0;
+};
+
+} // namespace vanitas
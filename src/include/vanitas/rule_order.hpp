@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vanitas/profile.hpp"
+
+namespace vanitas {
+
+enum class RuleGroup {
+    Err,
+    Wrn,
+    Tests,
+};
+
+struct RuleStat
+{
+        uint64_t tries = 0;
+        uint64_t hits = 0;
+        uint64_t samples = 0;   // tries that were timed
+        uint64_t sample_ns = 0; // their total time
+
+        void add(const RuleStat &o)
+        {
+            tries += o.tries;
+            hits += o.hits;
+            samples += o.samples;
+            sample_ns += o.sample_ns;
+        }
+};
+
+// The order one classifier tries the rules of one group in. Any hit in a group
+// gives the same type, so the order cannot change a result; rules are sorted
+// by hit rate over cost, which puts the ones that settle a block quickly, or
+// turn it down cheaply, in front. Every try is counted, one in sample_every is
+// timed, and the order is worked out again every reorder_every searches.
+class RuleOrder
+{
+    public:
+        static constexpr uint32_t sample_every = 64;
+        static constexpr uint32_t reorder_every = 1024;
+
+        // prior: earlier counts for the same rules, empty or one per rule
+        void reset(const std::vector<Rule> *rules, std::vector<RuleStat> prior = {});
+        bool search(std::string_view s);
+
+        // Counts since reset() or the last drain(); they go on weighing in the order.
+        std::vector<RuleStat> drain();
+
+    private:
+        const std::vector<Rule> *rules_ = nullptr;
+        std::vector<uint32_t> order_;
+        std::vector<RuleStat> stats_;
+        std::vector<RuleStat> prior_;
+        uint32_t searches_ = 0;
+
+        void reorder();
+};
+
+// Rule counts of one profile, summed over every classifier that used it and
+// kept between runs in a file under the cache directory, so a new run starts
+// with the order the last ones settled on. Rules are known by group and
+// pattern: editing one rule leaves what was learned about the others.
+class RuleLearner
+{
+    public:
+        explicit RuleLearner(std::filesystem::path file) : file_(std::move(file)) {}
+
+        // Earlier runs count half as much each time they are loaded, so the
+        // order follows logs that change over time. A missing or unreadable
+        // file is an empty start.
+        void load();
+        void save() const;
+
+        std::vector<RuleStat> prior(RuleGroup g, const std::vector<Rule> &rules) const;
+        void merge(RuleGroup g, const std::vector<Rule> &rules, const std::vector<RuleStat> &stats);
+
+        // ~/.vanitas/cache/rules/<hash of the profile name>
+        static std::filesystem::path file_for(const std::filesystem::path &base_dir, const std::string &profile);
+
+    private:
+        std::filesystem::path file_;
+        mutable std::mutex m_;
+        std::map<std::pair<RuleGroup, std::string>, RuleStat> stats_;
+};
+
+} // namespace vanitas
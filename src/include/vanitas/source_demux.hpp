@@ -0,0 +1,55 @@
+#pragma once
+
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "vanitas/block_builder.hpp"
+#include "vanitas/profile_slot.hpp"
+
+namespace vanitas {
+
+// Block building for input that interleaves lines of many sources. With the
+// profile's [source] prefix set, every line goes to the BlockBuilder of its
+// source, so continuations are not split by foreign lines; otherwise this is a
+// plain BlockBuilder. Line splitting and ANSI stripping stay shared (one
+// Normalizer in front), since sources interleave whole lines.
+class SourceDemux
+{
+    public:
+        explicit SourceDemux(ProfilePtr p);
+
+        void push(const std::vector<Event> &events, BlockBatch &out);
+        void flush(BlockBatch &out);
+        void set_profile(ProfilePtr p);
+
+        size_t sources() const { return map_.size(); }
+
+    private:
+        struct Source
+        {
+                std::string name;
+                BlockBuilder builder;
+        };
+
+        struct NameHash
+        {
+                using is_transparent = void;
+                size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+        };
+
+        ProfilePtr p_;
+        BlockBuilder single_;
+
+        // most recently used first; the map points into the list
+        std::list<Source> lru_;
+        std::unordered_map<std::string, std::list<Source>::iterator, NameHash, std::equal_to<>> map_;
+        Source *last_ = nullptr;
+
+        BlockBuilder &builder_for(std::string_view name, BlockBatch &out);
+        void flush_sources(BlockBatch &out);
+};
+
+} // namespace vanitas
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile.hpp"
+
+namespace vanitas {
+
+// The fields of a structured record the classifier needs, as views into the
+// line. String values are still escaped when escaped is set.
+struct Record
+{
+        std::string_view level;
+        std::string_view message;
+        bool escaped = false;
+
+        // Only scans up to the level and message fields; no DOM is built.
+        bool parse(const StructuredLog &s, std::string_view line);
+};
+
+// A line that the structured format could parse at all (cheap check).
+bool is_record(const StructuredLog &s, std::string_view line);
+
+// Named levels by the profile's lists, numeric ones as bunyan/pino use them
+// (50 and up error, 40 warn).
+Type level_type(const StructuredLog &s, std::string_view level);
+
+// JSON / logfmt string escapes (\n, \t, \", \\, \uXXXX) decoded into out.
+void unescape(std::string &out, std::string_view s);
+
+} // namespace vanitas
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "vanitas/normalizer.hpp"
+
+namespace vanitas {
+
+enum class TestStatus {
+    Passed,
+    Failed,
+    Skipped,
+};
+
+struct TestResult
+{
+        std::string name;      // Suite.Test, the pytest node id, or the ctest name
+        const char *framework; // "gtest", "pytest" or "ctest"
+        TestStatus status = TestStatus::Passed; // of the last run
+        int64_t duration_ms = -1;               // of the last run, -1 if not printed
+        size_t runs = 0;
+        size_t failures = 0;
+        std::string failure; // output of the last failed run, up to TestTracker::max_failure_bytes
+
+        // failed, then passed when run again
+        bool flaky() const { return failures > 0 && status == TestStatus::Passed; }
+};
+
+// Follows gtest, pytest and ctest output line by line and keeps one record per
+// test. Each framework is a small state machine driven by the lines it prints
+// itself; the first byte of a line decides whether it is looked at any
+// further, so other output costs a switch. pytest is only tracked after its
+// "test session starts" banner and ctest after "Test project", as their result
+// lines have no marker of their own.
+class TestTracker
+{
+    public:
+        static constexpr size_t max_failure_bytes = 8 * 1024;
+
+        void feed(const std::vector<Event> &events);
+        void line(std::string_view s);
+        // Attaches pytest failure sections printed after the results.
+        void finish();
+
+        const std::vector<TestResult> &tests() const { return tests_; }
+        bool empty() const { return tests_.empty(); }
+
+        // The n longest runs that took any time, longest first.
+        std::vector<const TestResult *> slowest(size_t n) const;
+
+    private:
+        enum class Mode {
+            None,
+            CtestOutput,     // --output-on-failure text after a failed result
+            PytestResults,   // after the session banner
+            PytestFailures,  // the FAILURES / ERRORS sections
+            PytestSummary,   // short test summary info
+            PytestDurations, // --durations
+        };
+        Mode mode_ = Mode::None;
+        bool ctest_ = false;
+
+        std::vector<TestResult> tests_;
+        std::unordered_map<std::string, size_t> index_;
+
+        // gtest: the test between [ RUN ] and its result, and what it printed;
+        // apart from mode_, as ctest may be showing a failed gtest binary
+        bool gtest_running_ = false;
+        std::string gtest_name_;
+        std::string gtest_output_;
+
+        std::string capture_; // ctest: output of the last failed test
+        size_t capture_test_ = 0;
+
+        // pytest prints failures after all results, headed by the test's short name
+        struct PytestFailure
+        {
+                std::string name;
+                std::string text;
+        };
+        std::vector<PytestFailure> pytest_failures_;
+
+        size_t record(std::string_view name, const char *framework, TestStatus status, int64_t duration_ms);
+        bool known(std::string_view name) const;
+        void end_capture();
+        void attach_pytest_failures();
+
+        bool gtest(std::string_view s);
+        bool ctest(std::string_view s);
+        bool pytest_section(std::string_view s);
+        void pytest_result(std::string_view s);
+        void pytest_duration(std::string_view s);
+};
+
+} // namespace vanitas
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace vanitas {
+
+// Where a block's time comes from: the first timestamp of the given format
+// within the first `search` bytes of its first line. Off unless the profile
+// names a format. Times are milliseconds since the epoch, UTC; ISO-8601 times
+// without an offset are taken as UTC, syslog times (no year) as this year.
+struct TimestampFormat
+{
+        enum class Kind {
+            None,
+            Iso8601,     // 2025-09-02T15:51:45.879Z, 2025-09-02 15:51:45,879+02:00
+            Syslog,      // Sep  2 15:51:45
+            EpochMillis, // 1756828305879
+            EpochSeconds // 1756828305 or 1756828305.879
+        };
+
+        Kind kind = Kind::None;
+        size_t search = 64;
+
+        bool enabled() const { return kind != Kind::None; }
+};
+
+std::optional<TimestampFormat::Kind> parse_timestamp_kind(const std::string &name);
+
+// Hand-written fixed-format parsers, no regex and no locale.
+std::optional<int64_t> find_timestamp(const TimestampFormat &f, std::string_view line);
+
+// A whole ISO-8601 date or date-time ("2025-09-02", "2025-09-02T15:51", ...).
+std::optional<int64_t> parse_iso8601(std::string_view s);
+
+// "2025-09-02T15:51:45.879Z"
+std::string format_iso8601(int64_t ms);
+
+} // namespace vanitas
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "vanitas/classifier.hpp"
+#include "vanitas/profile.hpp"
+
+namespace vanitas {
+
+// Three bytes of text, ASCII letters lowered, as one 24 bit key. Keys are
+// taken from lowered text so one index serves case-sensitive and -i queries;
+// the regex decides in the end.
+std::vector<uint32_t> trigrams(std::string_view text);
+
+// Hash of what decides blocks and their types (rules, correlation, structured
+// fields): an index built with another profile has other blocks.
+uint64_t profile_hash(const Profile &p);
+
+// The blocks of one stretch of a log, [begin, end) in input bytes, with the
+// posting list of every trigram in their text. Postings name groups of the
+// blocks that start within a few KiB of each other, not blocks: most blocks
+// are a line or two and share most of their trigrams with their neighbours,
+// so this keeps the index a fraction of the log, at the cost of reading a
+// group back for a hit in one of its blocks. Written as a segment:
+//
+//   header      magic, then u64 profile, identity, begin, end, line (of
+//               begin), lines (newlines in the stretch), blocks, groups,
+//               trigrams, postings (bytes)
+//   blocks      u64 per block: offset << 2 | type
+//   lines       u32 per block: its line less the segment's, padded to 8
+//   groups      u32 per group: its first block, padded to 8
+//   table       per trigram, by key: u32 key, u32 groups, u64 at
+//   postings    per trigram: group numbers as LEB128 deltas, padded to 8
+//
+// identity is a hash of the start of the log, to tell when the file behind a
+// name was replaced rather than appended to.
+class TrigramSegment
+{
+    public:
+        TrigramSegment();
+
+        // line: counted from 0 at the start of the stretch
+        void add(uint64_t offset, uint32_t line, Type t, std::string_view text);
+        size_t blocks() const { return blocks_.size(); }
+
+        // line: of begin, 0 if not known yet (see set_line)
+        void write(std::string &out, uint64_t profile, uint64_t identity, uint64_t begin, uint64_t end, uint64_t line,
+                   uint64_t lines) const;
+        // Segments of a log are built side by side, each before the lines
+        // ahead of it are counted.
+        static void set_line(std::string &segment, uint64_t line);
+
+    private:
+        std::vector<uint64_t> blocks_;
+        std::vector<uint32_t> lines_;
+        std::vector<uint32_t> groups_;
+        uint64_t group_offset_ = 0;
+        // by the key's first two bytes, then its last: 1 + index in lists_, 0 for none
+        std::vector<std::unique_ptr<uint32_t[]>> list_of_;
+        std::vector<uint32_t> keys_;               // of lists_
+        std::vector<std::vector<uint32_t>> lists_; // group numbers, ascending
+};
+
+// A block found in the index: where it is in the log and what it was.
+struct IndexedBlock
+{
+        uint64_t offset = 0;
+        uint64_t end = 0;
+        uint64_t line = 0;
+        Type type = Type::Info;
+};
+
+// The segments of an index file, mapped, not read. A segment cut short (by a
+// crash while it was appended) ends the index there.
+class TrigramIndex
+{
+    public:
+        // A missing or foreign file is an empty index.
+        explicit TrigramIndex(const std::filesystem::path &path);
+        ~TrigramIndex();
+        TrigramIndex(const TrigramIndex &) = delete;
+        TrigramIndex &operator=(const TrigramIndex &) = delete;
+
+        bool empty() const { return segments_.empty(); }
+        // Input covered, from 0; the index is usable only if it covers from 0.
+        uint64_t end() const { return segments_.empty() ? 0 : segments_.back().end; }
+        uint64_t end_line() const { return segments_.empty() ? 1 : segments_.back().line + segments_.back().lines; }
+        // Bytes of the file that hold whole segments.
+        uint64_t valid_bytes() const { return valid_; }
+        bool matches(uint64_t profile, uint64_t identity) const;
+        size_t segments() const { return segments_.size(); }
+
+        // Blocks of the groups that may contain every key, in input order. A
+        // list much longer than what is left is not decoded: checking the
+        // groups costs less than narrowing them further.
+        std::vector<IndexedBlock> candidates(const std::vector<uint32_t> &keys) const;
+        // Every block, for a pattern with no trigram to look up.
+        std::vector<IndexedBlock> all() const;
+
+        // ~/.vanitas/cache/grep/<hash of the log's path and the profile name>
+        static std::filesystem::path file_for(const std::filesystem::path &base_dir, const std::string &log,
+                                              const std::string &profile);
+
+    private:
+        struct Segment
+        {
+                uint64_t profile, identity, begin, end, line, lines;
+                const uint64_t *blocks;
+                const uint32_t *block_lines;
+                size_t n_blocks;
+                const uint32_t *groups;
+                size_t n_groups;
+                const char *table;
+                size_t n_keys;
+                const unsigned char *postings;
+        };
+
+        void *map_ = nullptr;
+        size_t map_size_ = 0;
+        uint64_t valid_ = 0;
+        std::vector<Segment> segments_;
+
+        static IndexedBlock block(const Segment &s, size_t i);
+};
+
+} // namespace vanitas
@@ -0,0 +1,43 @@
+#include "vanitas/load_governor.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace vanitas {
+
+static constexpr double rate_weight = 0.2; // of the newest chunk in the smoothed rate
+
+LoadGovernor::LoadGovernor(ShedThresholds t, Now now) : t_(t), now_(std::move(now)) { changed_ = now_(); }
+
+void LoadGovernor::begin()
+{
+    started_ = now_();
+    if (caught_up_)
+        waiting_since_ = started_;
+}
+
+void LoadGovernor::end(size_t bytes, size_t backlog)
+{
+    const auto at = now_();
+    const double busy = std::chrono::duration<double>(at - started_).count();
+    if (busy > 0 && bytes > 0) {
+        const double r = (double)bytes / busy;
+        rate_ = rate_ > 0 ? rate_ + rate_weight * (r - rate_) : r;
+    }
+    caught_up_ = backlog <= bytes;
+    const double waited = caught_up_ ? 0.0 : std::chrono::duration<double>(at - waiting_since_).count();
+    lag_ = std::max(waited, rate_ > 0 ? (double)backlog / rate_ : 0.0);
+
+    if (at - changed_ < settle)
+        return;
+    const int l = (int)level_;
+    if (l < 4 && lag_ >= t_.lag[(size_t)l]) {
+        level_ = (Shed)(l + 1);
+        changed_ = at;
+    } else if (l > 0 && lag_ < t_.lag[(size_t)l - 1] / 2) {
+        level_ = (Shed)(l - 1);
+        changed_ = at;
+    }
+}
+
+} // namespace vanitas
@@ -1,11 +1,73 @@
+#include <bit>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 #include "vanitas/normalizer.hpp"
 
 namespace vanitas {
 
+static bool special(unsigned char c) { return c <= 0x1B && (c == 0x1B || c == '\n' || c == '\r'); }
+
+// Index of the first ESC, '\n' or '\r' from i on, or s.size(): the text in
+// between is taken over in one piece, 16 bytes tested at a time.
+static size_t text_end(std::string_view s, size_t i)
+{
+    const char *p = s.data();
+    const size_t n = s.size();
+#if defined(__SSE2__)
+    const __m128i esc = _mm_set1_epi8(0x1B), lf = _mm_set1_epi8('\n'), cr = _mm_set1_epi8('\r');
+    for (; i + 16 <= n; i += 16) {
+        const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+        const __m128i hit =
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, esc), _mm_cmpeq_epi8(v, lf)), _mm_cmpeq_epi8(v, cr));
+        const int m = _mm_movemask_epi8(hit);
+        if (m != 0)
+            return i + (size_t)std::countr_zero((unsigned)m);
+    }
+#endif
+    while (i < n && !special((unsigned char)p[i]))
+        ++i;
+    return i;
+}
+
+// out_ is reserved up front for everything a call can emit, so it never
+// reallocates and the views handed out stay put.
+void Normalizer::emit(std::vector<Event> &out, EvKind kind, uint64_t next_start)
+{
+    const size_t start = out_.size();
+    out_.append(line_);
+    out.push_back({kind, std::string_view(out_).substr(start), line_start_, line_no_});
+    line_.clear();
+    line_start_ = next_start;
+}
+
 std::vector<Event> Normalizer::feed(std::string_view chunk)
 {
+    return feed(Decoded{chunk, chunk.size(), 0, {}});
+}
+
+std::vector<Event> Normalizer::feed(const Decoded &in)
+{
+    const std::string_view chunk = in.text;
     std::vector<Event> out;
-    for (unsigned char c : chunk) {
+    out_.clear();
+    out_.reserve(line_.size() + chunk.size());
+
+    size_t k = 0; // line ends seen, all of which have an entry in in.breaks
+    for (size_t i = 0; i < chunk.size(); ++i) {
+        if (state_ == State::Text) {
+            const size_t j = text_end(chunk, i);
+            line_.append(chunk.data() + i, j - i);
+            if (j == chunk.size())
+                break;
+            i = j;
+        }
+        const unsigned char c = (unsigned char)chunk[i];
+        uint64_t after = 0; // input position past c, when it ends a line
+        if (c == '\n' || c == '\r')
+            after = pos_ + (in.breaks.empty() ? in.lead + i + 1 : in.breaks[k++]);
         switch (state_) {
         case State::Text:
             if (c == 0x1B) {
@@ -13,14 +75,14 @@ std::vector<Event> Normalizer::feed(std::string_view chunk)
                 break;
             }
             if (c == '\n') {
-                out.push_back({EvKind::Line, line_});
-                line_.clear();
+                emit(out, EvKind::Line, after);
+                if (line_no_ != 0)
+                    ++line_no_;
                 last_was_cr_ = false;
                 break;
             }
             if (c == '\r') {
-                out.push_back({EvKind::Status, line_});
-                line_.clear();
+                emit(out, EvKind::Status, after);
                 last_was_cr_ = true;
                 break;
             }
@@ -41,18 +103,20 @@ std::vector<Event> Normalizer::feed(std::string_view chunk)
             break;
         }
     }
+    pos_ += in.raw_size;
     return out;
 }
 
 std::vector<Event> Normalizer::flush()
 {
     std::vector<Event> out;
+    out_.clear();
+    out_.reserve(line_.size());
 
     state_ = State::Text;
 
     if (!line_.empty()) {
-        out.push_back(Event{last_was_cr_ ? EvKind::Status : EvKind::Line, line_});
-        line_.clear();
+        emit(out, last_was_cr_ ? EvKind::Status : EvKind::Line, pos_);
         last_was_cr_ = false;
     }
 
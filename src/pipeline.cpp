@@ -0,0 +1,60 @@
+#include "vanitas/pipeline.hpp"
+
+namespace vanitas {
+
+Pipeline::Pipeline(ProfilePtr p, Sink sink, Filter f, ContextOptions ctx)
+    : builder_(p), classifier_(p, f, ctx), sink_(std::move(sink))
+{
+}
+
+Pipeline::Pipeline(const ProfileSlot &slot, Sink sink, Filter f, ContextOptions ctx)
+    : slot_(&slot), generation_(slot.generation()), builder_(slot.load()), classifier_(slot.load(), f, ctx), sink_(std::move(sink))
+{
+}
+
+void Pipeline::refresh_profile()
+{
+    if (!slot_ || slot_->generation() == generation_)
+        return;
+
+    generation_ = slot_->generation();
+    ProfilePtr p = slot_->load();
+    builder_.set_profile(p);
+    classifier_.set_profile(std::move(p));
+}
+
+void Pipeline::deliver(const std::vector<Item> &items)
+{
+    for (const auto &it : items)
+        sink_(it);
+}
+
+void Pipeline::push(const std::vector<Event> &events)
+{
+    if (tests_)
+        tests_->feed(events);
+    if (clean_)
+        clean_->push(events);
+    builder_.push(events, batch_);
+}
+
+void Pipeline::feed(std::string_view bytes)
+{
+    refresh_profile();
+    push(norm_.feed(decoder_.feed(bytes)));
+    deliver(classifier_.classify(batch_));
+    batch_.recycle();
+}
+
+void Pipeline::finish()
+{
+    refresh_profile();
+    push(norm_.feed(decoder_.flush()));
+    push(norm_.flush());
+    builder_.flush(batch_);
+    deliver(classifier_.classify(batch_));
+    deliver(classifier_.flush());
+    batch_.recycle();
+}
+
+} // namespace vanitas
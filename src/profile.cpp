@@ -1,34 +1,230 @@
+#include <cctype>
+
+#include "vanitas/builtin_profiles.hpp"
 #include "vanitas/profile.hpp"
 
 namespace vanitas {
 
-bool any_match(const std::vector<std::regex> &rs, std::string_view s)
+bool any_match(const std::vector<Rule> &rs, std::string_view s)
 {
-    return std::any_of(rs.begin(), rs.end(), [&](const std::regex &r) { return std::regex_search(s.begin(), s.end(), r); });
+    return std::any_of(rs.begin(), rs.end(), [&](const Rule &r) { return r.search(s); });
 }
 
-bool any_search(const std::vector<std::regex> &rs, const std::string &s)
+bool any_search(const std::vector<Rule> &rs, std::string_view s)
 {
     for (const auto &r : rs) {
-        if (std::regex_search(s, r))
+        if (r.search(s))
             return true;
     }
     return false;
 }
 
-Profile default_profile()
+// index past the ')' closing the group opened at i, or npos
+static size_t skip_group(std::string_view p, size_t i)
 {
-    Profile p;
+    int depth = 0;
+    bool in_class = false;
+    for (; i < p.size(); ++i) {
+        const char c = p[i];
+        if (c == '\\')
+            ++i;
+        else if (in_class)
+            in_class = c != ']';
+        else if (c == '[')
+            in_class = true;
+        else if (c == '(')
+            ++depth;
+        else if (c == ')' && --depth == 0)
+            return i + 1;
+    }
+    return std::string_view::npos;
+}
+
+// index past the ']' closing the class opened at i, or npos
+static size_t skip_class(std::string_view p, size_t i)
+{
+    for (++i; i < p.size(); ++i) {
+        if (p[i] == '\\')
+            ++i;
+        else if (p[i] == ']')
+            return i + 1;
+    }
+    return std::string_view::npos;
+}
 
-    p.firstline.emplace_back(R"(^ERR\b)");
-    p.firstline.emplace_back(R"(^WRN\b)");
-    p.firstline.emplace_back(R"(^.*:\d+:\d+:\s+(fatal\s+)?error:\s+)");
-    p.firstline.emplace_back(R"(^.*:\d+:\d+:\s+warning:\s+)");
+// Reads the longest run of plain characters off an ECMAScript pattern, one a
+// match cannot do without. Groups, classes, assertions and escapes other than
+// escaped punctuation end a run; a character made optional by its quantifier
+// is dropped, one that may repeat ends the run after it. A top-level '|' means
+// no text is shared by every match.
+static void read_literal(Rule &r)
+{
+    const std::string_view p = r.pattern;
+    std::string run;
+    bool run_anchored = false;
+    bool plain = true; // nothing seen but the leading '^' and the run
+
+    auto end_run = [&] {
+        if (run.size() > r.literal.size()) {
+            r.literal = run;
+            r.anchored = run_anchored;
+        }
+        run.clear();
+        run_anchored = false;
+    };
+    // after an atom, i at the character following it; true if a quantifier was skipped
+    auto quantifier = [&](size_t &i, bool atom_in_run) {
+        if (i >= p.size() || (p[i] != '*' && p[i] != '+' && p[i] != '?' && p[i] != '{'))
+            return false;
+        bool optional = p[i] != '+';
+        if (p[i] == '{') {
+            const size_t close = p.find('}', i);
+            optional = i + 1 < p.size() && p[i + 1] == '0';
+            i = close == std::string_view::npos ? p.size() : close + 1;
+        } else {
+            ++i;
+        }
+        if (i < p.size() && p[i] == '?')
+            ++i;
+        if (atom_in_run && optional)
+            run.pop_back();
+        return true;
+    };
 
-    p.continuation.emplace_back(R"(^\s+)");
-    p.continuation.emplace_back(R"(^stack traceback:)");
-    p.continuation.emplace_back(R"(^Error executing )");
+    size_t i = 0;
+    if (!p.empty() && p[0] == '^') {
+        i = 1;
+        run_anchored = true;
+    }
+    while (i < p.size()) {
+        const char c = p[i];
+        if (c == '|') {
+            r.literal.clear();
+            r.anchored = false;
+            return;
+        }
+        if (c == '(' || c == '[') {
+            const size_t next = c == '(' ? skip_group(p, i) : skip_class(p, i);
+            if (next == std::string_view::npos) {
+                plain = false;
+                break;
+            }
+            i = next;
+            quantifier(i, false);
+            end_run();
+            plain = false;
+            continue;
+        }
+        if (c == '\\' && i + 1 < p.size()) {
+            const char e = p[i + 1];
+            i += 2;
+            if (!std::isalnum((unsigned char)e)) {
+                run += e;
+                if (quantifier(i, true)) {
+                    end_run();
+                    plain = false;
+                }
+                continue;
+            }
+            if (e == 'x')
+                i += 2;
+            else if (e == 'u')
+                i += 4;
+            else if (e == 'c')
+                i += 1;
+            else if (std::isdigit((unsigned char)e))
+                while (i < p.size() && std::isdigit((unsigned char)p[i]))
+                    ++i;
+            quantifier(i, false);
+            end_run();
+            plain = false;
+            continue;
+        }
+        if (c == '.' || c == '^' || c == '$' || c == '*' || c == '+' || c == '?' || c == '{' || c == ')' ||
+            c == ']' || c == '}') {
+            ++i;
+            quantifier(i, false);
+            end_run();
+            plain = false;
+            continue;
+        }
+        run += c;
+        ++i;
+        if (quantifier(i, true)) {
+            end_run();
+            plain = false;
+        }
+    }
+    const bool whole = plain && !run.empty();
+    end_run();
+    r.exact = whole;
+}
 
+Rule::Rule(const std::string &pat) : pattern(pat), match(builtin_matcher(pat))
+{
+    if (match)
+        return;
+    re.assign(pat);
+    read_literal(*this);
+}
+
+bool Rule::search(std::string_view s) const
+{
+    if (match)
+        return match(s);
+    if (!literal.empty()) {
+        if (anchored ? !s.starts_with(literal) : s.find(literal) == std::string_view::npos)
+            return false;
+        if (exact)
+            return true;
+    }
+    return std::regex_search(s.begin(), s.end(), re);
+}
+
+// prefixes longer than this are taken to be part of the line
+static constexpr size_t max_prefix = 128;
+
+bool SourcePrefix::split(std::string_view line, std::string_view &source, std::string_view &rest) const
+{
+    if (!separator.empty()) {
+        const size_t at = line.substr(0, max_prefix + separator.size()).find(separator);
+        if (at == std::string_view::npos)
+            return false;
+        source = line.substr(0, at);
+        while (!source.empty() && (source.back() == ' ' || source.back() == '\t'))
+            source.remove_suffix(1);
+        rest = line.substr(at + separator.size());
+        return true;
+    }
+
+    std::match_results<std::string_view::const_iterator> m;
+    if (!std::regex_search(line.begin(), line.end(), m, *pattern, std::regex_constants::match_continuous) || m.size() < 2)
+        return false;
+    source = std::string_view(line.data() + m.position(1), (size_t)m.length(1));
+    rest = line.substr((size_t)m.length(0));
+    return true;
+}
+
+static std::vector<Rule> to_rules(BuiltinRules rs)
+{
+    std::vector<Rule> out;
+    out.reserve(rs.size());
+    for (const auto &r : rs)
+        out.emplace_back(std::string(r.pattern));
+    return out;
+}
+
+// the built-in "default", without going through toml
+Profile default_profile()
+{
+    const BuiltinProfile &b = *find_builtin_profile("default");
+
+    Profile p;
+    p.firstline = to_rules(b.firstline);
+    p.continuation = to_rules(b.continuation);
+    p.err = to_rules(b.err);
+    p.wrn = to_rules(b.wrn);
+    p.tests = to_rules(b.tests);
     return p;
 }
 
@@ -0,0 +1,138 @@
+#include "vanitas/profile_detect.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+
+#include "vanitas/normalizer.hpp"
+#include "vanitas/structured.hpp"
+
+namespace vanitas {
+
+// std::regex costs about a microsecond per rule and line, so only this much
+// of the sample is scored: a few runs of consecutive lines spread over it
+// (blocks need their neighbours), each line cut short.
+static constexpr size_t sample_runs = 4;
+static constexpr size_t run_lines = 32;
+static constexpr size_t max_line_bytes = 160;
+
+// A continuation rule that matches nearly every line folds the input into a
+// single block; it does not explain anything.
+static constexpr double fold_ratio = 0.95;
+
+static std::vector<std::string> sample_lines(std::string_view sample)
+{
+    Decoder dec;
+    Normalizer norm;
+    std::vector<std::string> all;
+    auto take = [&](const std::vector<Event> &evs) {
+        for (const auto &ev : evs) {
+            if (ev.kind == EvKind::Line && !ev.text.empty())
+                all.emplace_back(ev.text.substr(0, max_line_bytes));
+        }
+    };
+    take(norm.feed(dec.feed(sample)));
+    take(norm.feed(dec.flush()));
+    take(norm.flush());
+
+    if (all.size() <= sample_runs * run_lines)
+        return all;
+
+    std::vector<std::string> out;
+    out.reserve(sample_runs * run_lines);
+    const size_t stride = (all.size() - run_lines) / (sample_runs - 1);
+    for (size_t r = 0; r < sample_runs; ++r) {
+        const auto first = all.begin() + (std::ptrdiff_t)(r * stride);
+        out.insert(out.end(), std::make_move_iterator(first), std::make_move_iterator(first + run_lines));
+    }
+    return out;
+}
+
+static bool flags_block(const Profile &p, std::string_view head)
+{
+    Record rec;
+    if (p.structured.enabled() && rec.parse(p.structured, head))
+        return level_type(p.structured, rec.level) != Type::Info;
+    return any_search(p.err, head) || any_search(p.wrn, head) || any_search(p.tests, head);
+}
+
+// Mostly the share of lines the block rules recognize, plus a little for
+// blocks the classify rules pick out. That bonus shrinks again past half the
+// blocks: a log that is mostly errors is rarer than rules that match anything.
+ProfileScore score_profile(const Profile &p, const std::vector<std::string_view> &lines)
+{
+    ProfileScore s;
+    size_t folded = 0;
+    for (std::string_view line : lines) {
+        std::string_view source;
+        std::string_view rest;
+        if (p.source.enabled() && p.source.split(line, source, rest))
+            line = rest;
+
+        // the same decision as BlockBuilder::starts_block, each rule run once
+        ++s.lines;
+        bool starts = true;
+        if (p.structured.enabled() && is_record(p.structured, line)) {
+            ++s.explained;
+        } else if (any_match(p.firstline, line)) {
+            ++s.explained;
+        } else {
+            const bool cont = any_match(p.continuation, line);
+            starts = !cont && !p.structured.enabled();
+            if (cont) {
+                ++s.explained;
+                ++folded;
+            }
+        }
+
+        if (starts || s.lines == 1) {
+            ++s.blocks;
+            if (flags_block(p, line))
+                ++s.flagged;
+        }
+    }
+    if (s.lines == 0)
+        return s;
+
+    if ((double)folded >= fold_ratio * (double)s.lines)
+        s.explained -= folded;
+
+    double signal = (double)s.flagged / (double)s.blocks;
+    if (signal > 0.5)
+        signal = 1.0 - signal;
+    s.score = (double)s.explained / (double)s.lines + 0.25 * signal;
+    return s;
+}
+
+size_t detect_profile(const std::vector<ProfileCandidate> &candidates, std::string_view sample,
+                      std::vector<ProfileScore> *scores)
+{
+    const std::vector<std::string> owned = sample_lines(sample);
+    const std::vector<std::string_view> lines(owned.begin(), owned.end());
+
+    std::vector<ProfileScore> out(candidates.size());
+    std::atomic<size_t> next{0};
+    auto work = [&] {
+        for (size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < candidates.size();)
+            out[i] = score_profile(*candidates[i].profile, lines);
+    };
+
+    const size_t n = std::min<size_t>(candidates.size(), std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < n; ++t)
+        threads.emplace_back(work);
+    work();
+    for (auto &t : threads)
+        t.join();
+
+    size_t best = 0;
+    for (size_t i = 1; i < out.size(); ++i) {
+        if (out[i].score > out[best].score)
+            best = i;
+    }
+    if (scores)
+        *scores = std::move(out);
+    return best;
+}
+
+} // namespace vanitas
@@ -1,11 +1,13 @@
 #include "vanitas/profile_manager.hpp"
+#include <algorithm>
+#include <cctype>
 #include <cstdlib>
-#include <fstream>
 #include <iostream>
 #include <stdexcept>
 #include <toml.hpp>
 #include <unordered_set>
 
+#include "vanitas/builtin_profiles.hpp"
 #include "vanitas/profile.hpp"
 
 namespace vanitas {
@@ -17,6 +19,14 @@ struct RawProfile
         std::vector<std::string> err;
         std::vector<std::string> wrn;
         std::vector<std::string> tests;
+
+        std::string source_separator;
+        std::string source_pattern;
+        size_t max_sources = 4096;
+
+        std::optional<toml::value> structured;
+        std::optional<toml::value> timestamp;
+        std::optional<toml::value> correlate;
 };
 
 static std::filesystem::path get_home_dir()
@@ -44,31 +54,6 @@ static std::vector<std::string> get_patterns_or_empty(const toml::value &root, c
     return toml::find_or(root, table, key, std::vector<std::string>{});
 }
 
-void ProfileManager::ensure_default_profiles()
-{
-    std::filesystem::create_directories(profiles_dir());
-    auto def = profiles_dir() / "default.toml";
-
-    if (std::filesystem::exists(def)) {
-        return;
-    }
-
-    toml::value root(toml::table{
-        {   "firstline",                                  toml::table{{"patterns", toml::array{"^ERR\\b", "^WRN\\b", "^ERROR:", "^WARN:"}}}},
-        {"continuation",                                               toml::table{{"patterns", toml::array{"^\\s+", "^stack traceback:"}}}},
-        {    "classify", toml::table{{"err", toml::array{"^ERR\\b", "\\berror\\b"}},
- {"wrn", toml::array{"^WRN\\b", "\\bwarning\\b"}},
- {"tests", toml::array{"\\bPASSED\\b", "\\bFAILED\\b", "short test summary info"}}}                                },
-    });
-
-    std::ofstream f(def);
-    if (!f)
-        throw std::runtime_error("Cannot create default profile file");
-
-    f << "# default vanitas profile\n";
-    f << toml::format(root);
-}
-
 static RawProfile parse_profile_value(const toml::value &v)
 {
     RawProfile out;
@@ -77,12 +62,21 @@ static RawProfile parse_profile_value(const toml::value &v)
     out.err = toml::find_or(v, "classify", "err", std::vector<std::string>{});
     out.wrn = toml::find_or(v, "classify", "wrn", std::vector<std::string>{});
     out.tests = toml::find_or(v, "classify", "tests", std::vector<std::string>{});
+    out.source_separator = toml::find_or(v, "source", "separator", std::string{});
+    out.source_pattern = toml::find_or(v, "source", "pattern", std::string{});
+    out.max_sources = toml::find_or(v, "source", "max_sources", out.max_sources);
+    if (v.contains("structured"))
+        out.structured = v.at("structured");
+    if (v.contains("timestamp"))
+        out.timestamp = v.at("timestamp");
+    if (v.contains("correlate"))
+        out.correlate = v.at("correlate");
     return out;
 }
 
-static std::vector<std::regex> compile_regex_list(const std::vector<std::string> &patterns, const char *field_name)
+static std::vector<Rule> compile_rule_list(const std::vector<std::string> &patterns, const char *field_name)
 {
-    std::vector<std::regex> out;
+    std::vector<Rule> out;
     out.reserve(patterns.size());
     for (const auto &pat : patterns) {
         try {
@@ -94,20 +88,100 @@ static std::vector<std::regex> compile_regex_list(const std::vector<std::string>
     return out;
 }
 
+static SourcePrefix compile_source(const std::string &separator, const std::string &pattern, size_t max_sources)
+{
+    SourcePrefix out;
+    out.separator = separator;
+    out.max_sources = std::max<size_t>(max_sources, 1);
+    if (!pattern.empty()) {
+        try {
+            out.pattern.emplace(pattern);
+        } catch (const std::regex_error &e) {
+            throw std::runtime_error("Invalid regex in source.pattern: '" + pattern + "': " + e.what());
+        }
+        if (out.pattern->mark_count() < 1)
+            throw std::runtime_error("source.pattern needs a capture group for the source: '" + pattern + "'");
+    }
+    return out;
+}
+
+static std::vector<std::string> lower_all(std::vector<std::string> v)
+{
+    for (auto &s : v)
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+    return v;
+}
+
+// [structured] format = "json" | "logfmt", level/message = field names,
+// error/warn = level values; fields not given keep their defaults.
+static StructuredLog compile_structured(StructuredLog out, const toml::value &v)
+{
+    const std::string format = toml::find_or(v, "format", std::string{});
+    if (format == "json")
+        out.format = StructuredLog::Format::Json;
+    else if (format == "logfmt")
+        out.format = StructuredLog::Format::Logfmt;
+    else if (format.empty() || format == "none")
+        out.format = StructuredLog::Format::None;
+    else
+        throw std::runtime_error("Unknown structured.format: '" + format + "' (expected json, logfmt)");
+
+    out.level = toml::find_or(v, "level", out.level);
+    out.message = toml::find_or(v, "message", out.message);
+    out.error = lower_all(toml::find_or(v, "error", out.error));
+    out.warn = lower_all(toml::find_or(v, "warn", out.warn));
+    return out;
+}
+
+// [timestamp] format = "iso8601" | "syslog" | "epoch_ms" | "epoch" | "none", search = bytes
+static TimestampFormat compile_timestamp(TimestampFormat out, const toml::value &v)
+{
+    if (v.contains("format")) {
+        const std::string format = toml::find<std::string>(v, "format");
+        const auto kind = parse_timestamp_kind(format);
+        if (!kind)
+            throw std::runtime_error("Unknown timestamp.format: '" + format +
+                                     "' (expected iso8601, syslog, epoch_ms, epoch, none)");
+        out.kind = *kind;
+    }
+    out.search = toml::find_or(v, "search", out.search);
+    return out;
+}
+
+// [correlate] lead/follow = patterns on block heads, max_lead/max_follow = blocks
+static Correlation compile_correlate(Correlation out, const toml::value &v)
+{
+    if (const auto lead = toml::find<std::optional<std::vector<std::string>>>(v, "lead"))
+        out.lead = compile_rule_list(*lead, "correlate.lead");
+    if (const auto follow = toml::find<std::optional<std::vector<std::string>>>(v, "follow"))
+        out.follow = compile_rule_list(*follow, "correlate.follow");
+    out.max_lead = std::max<size_t>(toml::find_or(v, "max_lead", out.max_lead), 1);
+    out.max_follow = toml::find_or(v, "max_follow", out.max_follow);
+    return out;
+}
+
 static Profile compile_profile(const RawProfile &raw)
 {
     Profile p;
-    p.firstline = compile_regex_list(raw.firstline, "firstline.patterns");
-    p.continuation = compile_regex_list(raw.continuation, "continuation.patterns");
-    p.err = compile_regex_list(raw.err, "classify.err");
-    p.wrn = compile_regex_list(raw.wrn, "classify.wrn");
-    p.tests = compile_regex_list(raw.tests, "classify.tests");
+    p.firstline = compile_rule_list(raw.firstline, "firstline.patterns");
+    p.continuation = compile_rule_list(raw.continuation, "continuation.patterns");
+    p.err = compile_rule_list(raw.err, "classify.err");
+    p.wrn = compile_rule_list(raw.wrn, "classify.wrn");
+    p.tests = compile_rule_list(raw.tests, "classify.tests");
+    p.source = compile_source(raw.source_separator, raw.source_pattern, raw.max_sources);
+    if (raw.structured)
+        p.structured = compile_structured(p.structured, *raw.structured);
+    if (raw.timestamp)
+        p.timestamp = compile_timestamp(p.timestamp, *raw.timestamp);
+    if (raw.correlate)
+        p.correlate = compile_correlate(p.correlate, *raw.correlate);
     return p;
 }
 
 static bool is_effectively_empty(const Profile &p)
 {
-    return p.firstline.empty() && p.continuation.empty() && p.err.empty() && p.wrn.empty() && p.tests.empty();
+    return p.firstline.empty() && p.continuation.empty() && p.err.empty() && p.wrn.empty() && p.tests.empty() &&
+           !p.structured.enabled();
 }
 
 static std::optional<std::string> try_get_extends(const toml::value &v)
@@ -121,6 +195,32 @@ static std::optional<std::string> try_get_extends(const toml::value &v)
 
 static RawProfile parse_raw_profile(const toml::value &v) { return parse_profile_value(v); }
 
+// a built-in profile as the document a file profile would hold
+static toml::value builtin_value(const BuiltinProfile &b)
+{
+    toml::value out = toml::table{};
+
+    auto put = [&](const char *table, const char *key, BuiltinRules rules) {
+        if (rules.empty())
+            return;
+        toml::array patterns;
+        for (const auto &r : rules)
+            patterns.push_back(std::string(r.pattern));
+        if (!out.contains(table))
+            out[table] = toml::table{};
+        out[table][key] = patterns;
+    };
+
+    put("firstline", "patterns", b.firstline);
+    put("continuation", "patterns", b.continuation);
+    put("classify", "err", b.err);
+    put("classify", "wrn", b.wrn);
+    put("classify", "tests", b.tests);
+    put("correlate", "lead", b.lead);
+    put("correlate", "follow", b.follow);
+    return out;
+}
+
 std::optional<toml::value> ProfileManager::try_load_file_value(const std::string &name_or_path)
 {
     std::filesystem::path p(name_or_path);
@@ -132,10 +232,11 @@ std::optional<toml::value> ProfileManager::try_load_file_value(const std::string
         return std::nullopt;
     }
 
+    // a broken file is an error, not a reason to run the built-in of that name
     const auto r = toml::try_parse(p.string());
-    if (r.is_err()) {
-        return std::nullopt;
-    }
+    if (r.is_err())
+        throw std::runtime_error("Failed to parse profile '" + p.string() + "': " +
+                                 toml::format_error(r.unwrap_err().at(0)));
     return r.unwrap();
 }
 
@@ -155,6 +256,9 @@ std::optional<ProfileManager::ProfileValueSource> ProfileManager::try_load_profi
         return ProfileValueSource{*v, p.string()};
     }
 
+    if (const BuiltinProfile *b = find_builtin_profile(name))
+        return ProfileValueSource{builtin_value(*b), "built-in"};
+
     return std::nullopt;
 }
 
@@ -182,6 +286,15 @@ toml::value ProfileManager::merge_profile_values(const toml::value &base, const
     apply("classify", "wrn");
     apply("classify", "tests");
 
+    for (const char *table : {"source", "structured", "timestamp", "correlate"}) {
+        if (!overlay.contains(table) || !overlay.at(table).is_table())
+            continue;
+        if (!out.contains(table) || !out.at(table).is_table())
+            out[table] = toml::table{};
+        for (const auto &[k, v] : overlay.at(table).as_table())
+            out[table][k] = v;
+    }
+
     return out;
 }
 
@@ -268,10 +381,10 @@ Profile ProfileManager::load_from_value(const Profile &base, const toml::value &
 {
     Profile out = base;
 
-    auto apply = [&](std::vector<std::regex> &dst, const std::optional<std::vector<std::string>> &pats, const char *field_name) {
+    auto apply = [&](std::vector<Rule> &dst, const std::optional<std::vector<std::string>> &pats, const char *field_name) {
         if (!pats)
             return;
-        dst = compile_regex_list(*pats, field_name);
+        dst = compile_rule_list(*pats, field_name);
     };
 
     const auto firstline = toml::find<std::optional<std::vector<std::string>>>(v, "firstline", "patterns");
@@ -286,7 +399,42 @@ Profile ProfileManager::load_from_value(const Profile &base, const toml::value &
     apply(out.wrn, wrn, "classify.wrn");
     apply(out.tests, tests, "classify.tests");
 
+    if (v.contains("source")) {
+        out.source = compile_source(toml::find_or(v, "source", "separator", out.source.separator),
+                                    toml::find_or(v, "source", "pattern", std::string{}),
+                                    toml::find_or(v, "source", "max_sources", out.source.max_sources));
+    }
+    if (v.contains("structured"))
+        out.structured = compile_structured(out.structured, v.at("structured"));
+    if (v.contains("timestamp"))
+        out.timestamp = compile_timestamp(out.timestamp, v.at("timestamp"));
+    if (v.contains("correlate"))
+        out.correlate = compile_correlate(out.correlate, v.at("correlate"));
+
     return out;
 }
 
+std::vector<std::string> ProfileManager::profile_names(const std::optional<toml::value> &cfgv) const
+{
+    std::vector<std::string> names;
+    if (cfgv) {
+        const toml::table inline_profiles = toml::find_or(*cfgv, "profiles", toml::table{});
+        for (const auto &kv : inline_profiles)
+            names.push_back(kv.first);
+    }
+
+    for (const auto &b : builtin_profiles())
+        names.emplace_back(b.name);
+
+    std::error_code ec;
+    for (const auto &entry : std::filesystem::directory_iterator(profiles_dir(), ec)) {
+        if (entry.is_regular_file(ec) && entry.path().extension() == ".toml")
+            names.push_back(entry.path().stem().string());
+    }
+
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    return names;
+}
+
 } // namespace vanitas
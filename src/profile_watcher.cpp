@@ -0,0 +1,156 @@
+#include "vanitas/profile_watcher.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include "vanitas/config.hpp"
+
+namespace vanitas {
+
+// editors write in bursts (temp file, rename, chmod); settle before reloading
+static constexpr int settle_ms = 100;
+
+static constexpr uint32_t watch_mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE;
+
+ProfileWatcher::~ProfileWatcher()
+{
+    if (thread_.joinable()) {
+        uint64_t one = 1;
+        (void)!write(stop_fd_, &one, sizeof(one));
+        thread_.join();
+    }
+    if (inotify_fd_ >= 0)
+        close(inotify_fd_);
+    if (stop_fd_ >= 0)
+        close(stop_fd_);
+}
+
+void ProfileWatcher::track(const std::string &name, std::shared_ptr<ProfileSlot> slot)
+{
+    std::lock_guard lk(m_);
+    tracked_.push_back({name, std::move(slot)});
+}
+
+bool ProfileWatcher::start()
+{
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    stop_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd_ < 0 || stop_fd_ < 0) {
+        std::cerr << "WARN: profile watching unavailable: " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    if (!add_watches()) {
+        std::cerr << "WARN: cannot watch " << pm_.base_dir().string() << ": " << std::strerror(errno) << "\n";
+        return false;
+    }
+
+    // the thread must not take process signals meant for the caller's handlers
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    thread_ = std::thread([this] { run(); });
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+    return true;
+}
+
+// The directories, or for one that does not exist yet the nearest one above
+// it, so that its creation is seen. Run again whenever a directory appears;
+// true if that brought a directory closer to the profiles under watch.
+bool ProfileWatcher::add_watches()
+{
+    bool added = false;
+    for (auto dir : {pm_.base_dir(), pm_.profiles_dir()}) {
+        std::error_code ec;
+        while (!std::filesystem::is_directory(dir, ec) && dir.has_relative_path())
+            dir = dir.parent_path();
+        if (std::find(watched_.begin(), watched_.end(), dir) != watched_.end())
+            continue;
+        if (inotify_add_watch(inotify_fd_, dir.c_str(), watch_mask) >= 0) {
+            watched_.push_back(dir);
+            added = true;
+        }
+    }
+    return added;
+}
+
+struct WatchEvents
+{
+        bool relevant = false;
+        bool dirs = false; // a directory was created or moved in
+};
+
+static void drain_events(int fd, WatchEvents &out)
+{
+    alignas(inotify_event) char buf[4096];
+    while (true) {
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n <= 0)
+            return;
+        for (char *p = buf; p < buf + n;) {
+            auto *ev = reinterpret_cast<inotify_event *>(p);
+            if ((ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)))
+                out.dirs = true;
+            else if (ev->len > 0 && std::string_view(ev->name).ends_with(".toml"))
+                out.relevant = true;
+            p += sizeof(inotify_event) + ev->len;
+        }
+    }
+}
+
+void ProfileWatcher::run()
+{
+    while (true) {
+        pollfd fds[2] = {{stop_fd_, POLLIN, 0}, {inotify_fd_, POLLIN, 0}};
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        if (fds[0].revents)
+            return;
+
+        WatchEvents ev;
+        drain_events(inotify_fd_, ev);
+        while (poll(&fds[1], 1, settle_ms) > 0)
+            drain_events(inotify_fd_, ev);
+
+        // a new directory may already hold profiles written before its watch
+        if (ev.dirs && add_watches())
+            ev.relevant = true;
+        if (ev.relevant)
+            reload_all();
+    }
+}
+
+void ProfileWatcher::reload_all()
+{
+    std::vector<Tracked> tracked;
+    {
+        std::lock_guard lk(m_);
+        tracked = tracked_;
+    }
+
+    const auto cfgv = load_user_config_value();
+    for (const auto &t : tracked) {
+        try {
+            Profile p = pm_.load_effective(t.name, cfgv);
+            p.learner = t.slot->load()->learner;
+            t.slot->publish(std::make_shared<const Profile>(std::move(p)));
+            std::cerr << "vanitas: reloaded profile '" << t.name << "'\n";
+        } catch (const std::exception &e) {
+            std::cerr << "WARN: reload of profile '" << t.name << "' rejected: " << e.what()
+                      << "\nWARN: keeping the previous profile.\n";
+        }
+    }
+}
+
+} // namespace vanitas
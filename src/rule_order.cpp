@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <utility>
+
+#include "vanitas/rule_order.hpp"
+
+namespace vanitas {
+
+void RuleOrder::reset(const std::vector<Rule> *rules, std::vector<RuleStat> prior)
+{
+    rules_ = rules;
+    const size_t n = rules ? rules->size() : 0;
+    order_.resize(n);
+    for (size_t i = 0; i < n; ++i)
+        order_[i] = (uint32_t)i;
+    stats_.assign(n, RuleStat{});
+    prior_ = std::move(prior);
+    if (prior_.size() != n)
+        prior_.assign(n, RuleStat{});
+    searches_ = 0;
+    reorder();
+}
+
+bool RuleOrder::search(std::string_view s)
+{
+    if (++searches_ % reorder_every == 0)
+        reorder();
+
+    const auto &rules = *rules_;
+    if (searches_ % sample_every != 0) {
+        for (const uint32_t i : order_) {
+            ++stats_[i].tries;
+            if (rules[i].search(s)) {
+                ++stats_[i].hits;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    for (const uint32_t i : order_) {
+        const auto t0 = std::chrono::steady_clock::now();
+        const bool hit = rules[i].search(s);
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0);
+        auto &st = stats_[i];
+        ++st.tries;
+        ++st.samples;
+        st.sample_ns += (uint64_t)ns.count();
+        if (hit) {
+            ++st.hits;
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<RuleStat> RuleOrder::drain()
+{
+    for (size_t i = 0; i < stats_.size(); ++i)
+        prior_[i].add(stats_[i]);
+    return std::exchange(stats_, std::vector<RuleStat>(stats_.size()));
+}
+
+// Trying rules with hit chance p and cost c until one hits costs least in
+// decreasing p / c. Rates are smoothed so a rule tried a few times is not
+// judged on them; a rule never timed is taken to cost as much as the others.
+void RuleOrder::reorder()
+{
+    const size_t n = order_.size();
+    if (n < 2)
+        return;
+
+    std::vector<double> cost(n, 0.0);
+    double known = 0.0;
+    size_t timed = 0;
+    for (size_t i = 0; i < n; ++i) {
+        RuleStat st = prior_[i];
+        st.add(stats_[i]);
+        if (st.samples > 0) {
+            cost[i] = std::max(1.0, (double)st.sample_ns / (double)st.samples);
+            known += cost[i];
+            ++timed;
+        }
+    }
+    const double fallback = timed ? known / (double)timed : 1.0;
+
+    std::vector<double> score(n);
+    for (size_t i = 0; i < n; ++i) {
+        RuleStat st = prior_[i];
+        st.add(stats_[i]);
+        const double rate = ((double)st.hits + 1.0) / ((double)st.tries + 2.0);
+        score[i] = rate / (cost[i] > 0.0 ? cost[i] : fallback);
+    }
+    std::stable_sort(order_.begin(), order_.end(), [&](uint32_t a, uint32_t b) { return score[a] > score[b]; });
+}
+
+static const char *group_name(RuleGroup g)
+{
+    switch (g) {
+    case RuleGroup::Err:
+        return "err";
+    case RuleGroup::Wrn:
+        return "wrn";
+    case RuleGroup::Tests:
+        return "tests";
+    }
+    return "";
+}
+
+static bool parse_group(std::string_view s, RuleGroup &g)
+{
+    for (const RuleGroup c : {RuleGroup::Err, RuleGroup::Wrn, RuleGroup::Tests}) {
+        if (s == group_name(c)) {
+            g = c;
+            return true;
+        }
+    }
+    return false;
+}
+
+// one rule per line: group tries hits samples sample_ns pattern
+void RuleLearner::load()
+{
+    std::ifstream in(file_);
+    if (!in)
+        return;
+
+    std::lock_guard lk(m_);
+    std::string line;
+    while (std::getline(in, line)) {
+        std::istringstream ls(line);
+        std::string group;
+        RuleStat st;
+        RuleGroup g;
+        if (!(ls >> group >> st.tries >> st.hits >> st.samples >> st.sample_ns) || !parse_group(group, g))
+            continue;
+        std::string pattern;
+        if (ls.get() != ' ' || !std::getline(ls, pattern))
+            continue;
+        st.tries /= 2;
+        st.hits = std::min(st.hits / 2, st.tries);
+        st.samples /= 2;
+        st.sample_ns /= 2;
+        stats_[{g, pattern}] = st;
+    }
+}
+
+void RuleLearner::save() const
+{
+    std::error_code ec;
+    std::filesystem::create_directories(file_.parent_path(), ec);
+
+    const auto tmp = std::filesystem::path(file_.string() + ".tmp");
+    {
+        std::ofstream out(tmp, std::ios::trunc);
+        if (!out) {
+            std::cerr << "WARN: cannot write " << tmp.string() << "\n";
+            return;
+        }
+        std::lock_guard lk(m_);
+        for (const auto &[key, st] : stats_) {
+            if (key.second.find('\n') != std::string::npos)
+                continue;
+            out << group_name(key.first) << ' ' << st.tries << ' ' << st.hits << ' ' << st.samples << ' '
+                << st.sample_ns << ' ' << key.second << '\n';
+        }
+    }
+    std::filesystem::rename(tmp, file_, ec);
+    if (ec)
+        std::cerr << "WARN: cannot write " << file_.string() << ": " << ec.message() << "\n";
+}
+
+std::vector<RuleStat> RuleLearner::prior(RuleGroup g, const std::vector<Rule> &rules) const
+{
+    std::lock_guard lk(m_);
+    std::vector<RuleStat> out(rules.size());
+    for (size_t i = 0; i < rules.size(); ++i) {
+        const auto it = stats_.find({g, rules[i].pattern});
+        if (it != stats_.end())
+            out[i] = it->second;
+    }
+    return out;
+}
+
+void RuleLearner::merge(RuleGroup g, const std::vector<Rule> &rules, const std::vector<RuleStat> &stats)
+{
+    std::lock_guard lk(m_);
+    for (size_t i = 0; i < rules.size() && i < stats.size(); ++i) {
+        if (stats[i].tries > 0)
+            stats_[{g, rules[i].pattern}].add(stats[i]);
+    }
+}
+
+std::filesystem::path RuleLearner::file_for(const std::filesystem::path &base_dir, const std::string &profile)
+{
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (const unsigned char c : profile) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    char name[17];
+    std::snprintf(name, sizeof(name), "%016llx", (unsigned long long)h);
+    return base_dir / "cache" / "rules" / name;
+}
+
+} // namespace vanitas
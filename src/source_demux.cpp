@@ -0,0 +1,79 @@
+#include "vanitas/source_demux.hpp"
+
+#include "vanitas/normalizer.hpp"
+#include "vanitas/profile.hpp"
+
+namespace vanitas {
+
+SourceDemux::SourceDemux(ProfilePtr p) : p_(p), single_(std::move(p)) {}
+
+void SourceDemux::set_profile(ProfilePtr p)
+{
+    p_ = p;
+    single_.set_profile(p);
+    for (auto &s : lru_)
+        s.builder.set_profile(p);
+}
+
+BlockBuilder &SourceDemux::builder_for(std::string_view name, BlockBatch &out)
+{
+    // consecutive lines mostly come from the same source
+    if (last_ && last_->name == name)
+        return last_->builder;
+
+    auto it = map_.find(name);
+    if (it != map_.end()) {
+        lru_.splice(lru_.begin(), lru_, it->second);
+    } else {
+        if (map_.size() >= p_->source.max_sources) {
+            Source &idle = lru_.back();
+            idle.builder.flush(out);
+            map_.erase(idle.name);
+            lru_.pop_back();
+        }
+        lru_.push_front(Source{std::string(name), BlockBuilder(p_, name)});
+        map_.emplace(lru_.front().name, lru_.begin());
+    }
+    last_ = &lru_.front();
+    return last_->builder;
+}
+
+void SourceDemux::flush_sources(BlockBatch &out)
+{
+    // least recently used first, which roughly keeps input order
+    for (auto it = lru_.rbegin(); it != lru_.rend(); ++it)
+        it->builder.flush(out);
+    lru_.clear();
+    map_.clear();
+    last_ = nullptr;
+}
+
+void SourceDemux::push(const std::vector<Event> &events, BlockBatch &out)
+{
+    const SourcePrefix &prefix = p_->source;
+    if (!prefix.enabled()) {
+        if (!lru_.empty())
+            flush_sources(out);
+        single_.push(events, out);
+        return;
+    }
+
+    // lines without a prefix (the tool's own messages) form a source of their own
+    single_.flush(out);
+    for (const auto &ev : events) {
+        std::string_view name, rest;
+        if (!prefix.split(ev.text, name, rest)) {
+            name = {};
+            rest = ev.text;
+        }
+        builder_for(name, out).push(Event{ev.kind, rest, ev.offset, ev.line}, out);
+    }
+}
+
+void SourceDemux::flush(BlockBatch &out)
+{
+    single_.flush(out);
+    flush_sources(out);
+}
+
+} // namespace vanitas
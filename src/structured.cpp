@@ -0,0 +1,303 @@
+#include "vanitas/structured.hpp"
+
+#include <cstring>
+
+namespace vanitas {
+
+static size_t skip_blanks(std::string_view s, size_t i)
+{
+    while (i < s.size() && (s[i] == ' ' || s[i] == '\t'))
+        ++i;
+    return i;
+}
+
+static bool is_one_of(const std::vector<std::string> &names, std::string_view key)
+{
+    for (const auto &n : names)
+        if (n == key)
+            return true;
+    return false;
+}
+
+// s[i] is the opening quote. Returns the index of the closing quote, or npos.
+// memchr finds the quotes; only a quote preceded by backslashes needs a look back.
+static size_t string_end(std::string_view s, size_t i, bool &escaped)
+{
+    const char *base = s.data();
+    size_t at = i + 1;
+    while (at < s.size()) {
+        const void *q = std::memchr(base + at, '"', s.size() - at);
+        if (!q)
+            return std::string_view::npos;
+        const size_t end = (size_t)(static_cast<const char *>(q) - base);
+        size_t bs = 0;
+        while (end - bs > i + 1 && base[end - bs - 1] == '\\')
+            ++bs;
+        if (bs % 2 == 0) {
+            escaped = escaped || std::memchr(base + i + 1, '\\', end - i - 1) != nullptr;
+            return end;
+        }
+        at = end + 1;
+    }
+    return std::string_view::npos;
+}
+
+// Skips a nested object or array starting at s[i]; returns the index after it.
+static size_t skip_nested(std::string_view s, size_t i)
+{
+    size_t depth = 0;
+    bool escaped = false;
+    while (i < s.size()) {
+        const char c = s[i];
+        if (c == '"') {
+            i = string_end(s, i, escaped);
+            if (i == std::string_view::npos)
+                return s.size();
+        } else if (c == '{' || c == '[') {
+            ++depth;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0)
+                return i + 1;
+        }
+        ++i;
+    }
+    return i;
+}
+
+// Walks the top-level members of {"k": v, ...}; values are skipped unless
+// their key is a level or message field.
+static bool parse_json(const StructuredLog &st, std::string_view s, Record &r)
+{
+    size_t i = skip_blanks(s, 0);
+    if (i >= s.size() || s[i] != '{')
+        return false;
+    ++i;
+
+    bool level_found = false;
+    bool message_found = false;
+    while (i < s.size() && !(level_found && message_found)) {
+        i = skip_blanks(s, i);
+        if (i < s.size() && s[i] == ',')
+            i = skip_blanks(s, i + 1);
+        if (i >= s.size() || s[i] != '"')
+            break;
+
+        bool key_escaped = false;
+        const size_t key_end = string_end(s, i, key_escaped);
+        if (key_end == std::string_view::npos)
+            break;
+        const std::string_view key = s.substr(i + 1, key_end - i - 1);
+
+        i = skip_blanks(s, key_end + 1);
+        if (i >= s.size() || s[i] != ':')
+            break;
+        i = skip_blanks(s, i + 1);
+        if (i >= s.size())
+            break;
+
+        std::string_view value;
+        bool value_escaped = false;
+        if (s[i] == '"') {
+            const size_t end = string_end(s, i, value_escaped);
+            if (end == std::string_view::npos)
+                break;
+            value = s.substr(i + 1, end - i - 1);
+            i = end + 1;
+        } else if (s[i] == '{' || s[i] == '[') {
+            i = skip_nested(s, i);
+            continue;
+        } else {
+            const size_t start = i;
+            while (i < s.size() && s[i] != ',' && s[i] != '}' && s[i] != ' ' && s[i] != '\t')
+                ++i;
+            value = s.substr(start, i - start);
+        }
+
+        if (!level_found && is_one_of(st.level, key)) {
+            r.level = value;
+            level_found = true;
+        } else if (!message_found && is_one_of(st.message, key)) {
+            r.message = value;
+            r.escaped = value_escaped;
+            message_found = true;
+        }
+    }
+    return true;
+}
+
+// key=value key="quoted value" ...; a bare word without '=' is skipped.
+static bool parse_logfmt(const StructuredLog &st, std::string_view s, Record &r)
+{
+    bool level_found = false;
+    bool message_found = false;
+    size_t i = 0;
+    while (i < s.size() && !(level_found && message_found)) {
+        i = skip_blanks(s, i);
+        const size_t key_start = i;
+        while (i < s.size() && s[i] != '=' && s[i] != ' ' && s[i] != '\t')
+            ++i;
+        const std::string_view key = s.substr(key_start, i - key_start);
+        if (i >= s.size() || s[i] != '=')
+            continue;
+        ++i;
+
+        std::string_view value;
+        bool value_escaped = false;
+        if (i < s.size() && s[i] == '"') {
+            size_t end = string_end(s, i, value_escaped);
+            if (end == std::string_view::npos)
+                end = s.size();
+            value = s.substr(i + 1, end - i - 1);
+            i = end + 1;
+        } else {
+            const size_t start = i;
+            while (i < s.size() && s[i] != ' ' && s[i] != '\t')
+                ++i;
+            value = s.substr(start, i - start);
+        }
+
+        if (!level_found && is_one_of(st.level, key)) {
+            r.level = value;
+            level_found = true;
+        } else if (!message_found && is_one_of(st.message, key)) {
+            r.message = value;
+            r.escaped = value_escaped;
+            message_found = true;
+        }
+    }
+    return level_found;
+}
+
+bool Record::parse(const StructuredLog &s, std::string_view line)
+{
+    *this = Record{};
+    switch (s.format) {
+    case StructuredLog::Format::Json:
+        return parse_json(s, line, *this);
+    case StructuredLog::Format::Logfmt:
+        return parse_logfmt(s, line, *this);
+    default:
+        return false;
+    }
+}
+
+// A logfmt record has one of the level keys right at the start of a token.
+bool is_record(const StructuredLog &s, std::string_view line)
+{
+    if (s.format == StructuredLog::Format::Json) {
+        const size_t i = skip_blanks(line, 0);
+        return i < line.size() && line[i] == '{';
+    }
+    if (s.format != StructuredLog::Format::Logfmt)
+        return false;
+
+    for (const auto &key : s.level) {
+        size_t at = 0;
+        while ((at = line.find(key, at)) != std::string_view::npos) {
+            const size_t end = at + key.size();
+            if ((at == 0 || line[at - 1] == ' ' || line[at - 1] == '\t') && end < line.size() && line[end] == '=')
+                return true;
+            at = end;
+        }
+    }
+    return false;
+}
+
+static bool equals_lower(std::string_view a, const std::string &lower)
+{
+    if (a.size() != lower.size())
+        return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        char c = a[i];
+        if (c >= 'A' && c <= 'Z')
+            c = (char)(c - 'A' + 'a');
+        if (c != lower[i])
+            return false;
+    }
+    return true;
+}
+
+Type level_type(const StructuredLog &s, std::string_view level)
+{
+    if (!level.empty() && level[0] >= '0' && level[0] <= '9') {
+        unsigned n = 0;
+        for (char c : level) {
+            if (c < '0' || c > '9')
+                break;
+            n = n * 10 + (unsigned)(c - '0');
+        }
+        return n >= 50 ? Type::Error : n >= 40 ? Type::Warn : Type::Info;
+    }
+
+    for (const auto &e : s.error)
+        if (equals_lower(level, e))
+            return Type::Error;
+    for (const auto &w : s.warn)
+        if (equals_lower(level, w))
+            return Type::Warn;
+    return Type::Info;
+}
+
+static void append_utf8(std::string &out, unsigned cp)
+{
+    if (cp < 0x80) {
+        out += (char)cp;
+    } else if (cp < 0x800) {
+        out += (char)(0xC0 | (cp >> 6));
+        out += (char)(0x80 | (cp & 0x3F));
+    } else {
+        out += (char)(0xE0 | (cp >> 12));
+        out += (char)(0x80 | ((cp >> 6) & 0x3F));
+        out += (char)(0x80 | (cp & 0x3F));
+    }
+}
+
+void unescape(std::string &out, std::string_view s)
+{
+    for (size_t i = 0; i < s.size(); ++i) {
+        if (s[i] != '\\' || i + 1 == s.size()) {
+            out += s[i];
+            continue;
+        }
+        const char c = s[++i];
+        switch (c) {
+        case 'n':
+            out += '\n';
+            break;
+        case 't':
+            out += '\t';
+            break;
+        case 'r':
+            break;
+        case 'u':
+            if (i + 4 < s.size()) {
+                unsigned cp = 0;
+                bool ok = true;
+                for (size_t k = 1; k <= 4; ++k) {
+                    const char h = s[i + k];
+                    cp <<= 4;
+                    if (h >= '0' && h <= '9')
+                        cp |= (unsigned)(h - '0');
+                    else if (h >= 'a' && h <= 'f')
+                        cp |= (unsigned)(h - 'a' + 10);
+                    else if (h >= 'A' && h <= 'F')
+                        cp |= (unsigned)(h - 'A' + 10);
+                    else
+                        ok = false;
+                }
+                if (ok) {
+                    append_utf8(out, cp);
+                    i += 4;
+                    break;
+                }
+            }
+            out += "\\u";
+            break;
+        default:
+            out += c; // \" \\ \/
+            break;
+        }
+    }
+}
+
+} // namespace vanitas
@@ -0,0 +1,394 @@
+#include "vanitas/test_tracker.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+namespace vanitas {
+
+static std::string_view trim(std::string_view s, std::string_view chars = " \t")
+{
+    const size_t b = s.find_first_not_of(chars);
+    if (b == std::string_view::npos)
+        return {};
+    return s.substr(b, s.find_last_not_of(chars) + 1 - b);
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// "12", "0.51" counted in units of unit_ms, as whole milliseconds; -1 if s is not a number
+static int64_t parse_duration(std::string_view s, double unit_ms)
+{
+    if (s.empty() || !is_digit(s[0]))
+        return -1;
+    double v = 0, scale = 0;
+    for (char c : s) {
+        if (c == '.' && scale == 0) {
+            scale = 1;
+        } else if (is_digit(c)) {
+            v = v * 10 + (c - '0');
+            scale *= 10;
+        } else {
+            return -1;
+        }
+    }
+    if (scale > 1)
+        v /= scale;
+    return (int64_t)(v * unit_ms + 0.5);
+}
+
+static void append_capped(std::string &dst, std::string_view line)
+{
+    if (dst.size() >= TestTracker::max_failure_bytes)
+        return;
+    if (!dst.empty())
+        dst += '\n';
+    dst.append(line.substr(0, TestTracker::max_failure_bytes - std::min(dst.size(), TestTracker::max_failure_bytes)));
+}
+
+static void trim_trailing_lines(std::string &s)
+{
+    while (!s.empty() && (s.back() == '\n' || s.back() == ' ' || s.back() == '\t'))
+        s.pop_back();
+}
+
+size_t TestTracker::record(std::string_view name, const char *framework, TestStatus status, int64_t duration_ms)
+{
+    auto [it, added] = index_.try_emplace(std::string(name), tests_.size());
+    if (added) {
+        TestResult &t = tests_.emplace_back();
+        t.name = it->first;
+        t.framework = framework;
+    }
+    TestResult &t = tests_[it->second];
+    ++t.runs;
+    if (status == TestStatus::Failed)
+        ++t.failures;
+    t.status = status;
+    t.duration_ms = duration_ms;
+    return it->second;
+}
+
+bool TestTracker::known(std::string_view name) const { return index_.contains(std::string(name)); }
+
+void TestTracker::end_capture()
+{
+    if (mode_ != Mode::CtestOutput)
+        return;
+    trim_trailing_lines(capture_);
+    tests_[capture_test_].failure = std::move(capture_);
+    capture_.clear();
+    mode_ = Mode::None;
+}
+
+void TestTracker::feed(const std::vector<Event> &events)
+{
+    for (const Event &ev : events)
+        if (ev.kind == EvKind::Line)
+            line(ev.text);
+}
+
+void TestTracker::line(std::string_view s)
+{
+    const char c = s.empty() ? '\0' : s[0];
+    if (c == '[' && gtest(s)) {
+        if (mode_ == Mode::CtestOutput)
+            append_capped(capture_, s);
+        return;
+    }
+    if (gtest_running_)
+        append_capped(gtest_output_, s);
+
+    if (ctest_ && (c == ' ' || c == 'T' || is_digit(c)) && ctest(s))
+        return;
+    if (c == '=' && pytest_section(s))
+        return;
+
+    switch (mode_) {
+    case Mode::CtestOutput:
+        append_capped(capture_, s);
+        break;
+    case Mode::PytestResults:
+    case Mode::PytestSummary:
+        pytest_result(s);
+        break;
+    case Mode::PytestFailures:
+        if (c == '_' && s.back() == '_') {
+            std::string_view name = trim(s, "_ ");
+            for (std::string_view when : {"ERROR at setup of ", "ERROR at teardown of ", "ERROR collecting "})
+                if (name.starts_with(when))
+                    name.remove_prefix(when.size());
+            pytest_failures_.push_back({std::string(name), {}});
+        } else if (!pytest_failures_.empty()) {
+            append_capped(pytest_failures_.back().text, s);
+        }
+        break;
+    case Mode::PytestDurations:
+        pytest_duration(s);
+        break;
+    case Mode::None:
+        if (c == 'T' && s.starts_with("Test project "))
+            ctest_ = true;
+        break;
+    }
+}
+
+// "[ RUN      ] Suite.Test", "[  FAILED  ] Suite.Test (12 ms)"; the summary at
+// the end lists failed and skipped tests again, without a time.
+bool TestTracker::gtest(std::string_view s)
+{
+    if (s.size() < 12 || s[11] != ']')
+        return false;
+    const std::string_view tag = s.substr(1, 10);
+    if (tag == "==========" || tag == "----------" || tag == "  PASSED  " || tag == " DISABLED ") {
+        return true;
+    }
+
+    enum { Run, Ok, Failed, Skipped } kind;
+    if (tag == " RUN      ")
+        kind = Run;
+    else if (tag == "       OK ")
+        kind = Ok;
+    else if (tag == "  FAILED  ")
+        kind = Failed;
+    else if (tag == "  SKIPPED ")
+        kind = Skipped;
+    else
+        return false;
+
+    std::string_view rest = s.substr(std::min<size_t>(s.size(), 13));
+    std::string_view name = rest.substr(0, std::min(rest.find(" ("), rest.find(", where")));
+    int64_t ms = -1;
+    if (const size_t p = rest.rfind(" ("); p != std::string_view::npos && rest.ends_with(" ms)"))
+        ms = parse_duration(rest.substr(p + 2, rest.size() - p - 6), 1);
+    if (name.empty() || name.find(' ') != std::string_view::npos) // "1 test, listed below:"
+        return true;
+
+    if (kind == Run) {
+        gtest_running_ = true;
+        gtest_name_ = name;
+        gtest_output_.clear();
+        return true;
+    }
+
+    const bool current = gtest_running_ && gtest_name_ == name;
+    if (!current && ms < 0 && known(name))
+        return true;
+    const TestStatus st = kind == Ok ? TestStatus::Passed : kind == Failed ? TestStatus::Failed : TestStatus::Skipped;
+    const size_t i = record(name, "gtest", st, ms);
+    if (current) {
+        if (st == TestStatus::Failed) {
+            trim_trailing_lines(gtest_output_);
+            tests_[i].failure = std::move(gtest_output_);
+        }
+        gtest_running_ = false;
+        gtest_output_.clear();
+    }
+    return true;
+}
+
+// "  3/10 Test  #3: name .......***Failed    0.02 sec"; with --repeat the
+// count in front is left out. "Start" lines and the closing percentage end
+// the output of a failed test.
+bool TestTracker::ctest(std::string_view s)
+{
+    std::string_view t = trim(s, " ");
+    if (t.starts_with("Start ")) {
+        end_capture();
+        return true;
+    }
+    if (!t.empty() && is_digit(t[0])) {
+        size_t i = 0;
+        while (i < t.size() && is_digit(t[i]))
+            ++i;
+        if (t.substr(i).starts_with("% tests passed")) {
+            end_capture();
+            return true;
+        }
+        if (i >= t.size() || t[i] != '/')
+            return false;
+        ++i;
+        while (i < t.size() && is_digit(t[i]))
+            ++i;
+        t = trim(t.substr(i), " ");
+    }
+    if (!t.starts_with("Test "))
+        return false;
+    t = trim(t.substr(5), " ");
+    const size_t colon = t.find(": ");
+    if (t.empty() || t[0] != '#' || colon == std::string_view::npos)
+        return false;
+    t.remove_prefix(colon + 2);
+
+    size_t at = t.find("***");
+    const bool passed = at == std::string_view::npos;
+    if (passed && (at = t.find(" Passed")) == std::string_view::npos)
+        return false;
+    const std::string_view name = trim(t.substr(0, at), " .");
+    const std::string_view verdict = t.substr(at);
+
+    int64_t ms = -1;
+    if (verdict.ends_with(" sec")) {
+        const std::string_view num = verdict.substr(0, verdict.size() - 4);
+        ms = parse_duration(num.substr(num.find_last_of(' ') + 1), 1000);
+    }
+    TestStatus st = TestStatus::Failed;
+    if (passed)
+        st = TestStatus::Passed;
+    else if (verdict.starts_with("***Skipped"))
+        st = TestStatus::Skipped;
+
+    end_capture();
+    const size_t i = record(name, "ctest", st, ms);
+    if (st == TestStatus::Failed) {
+        capture_test_ = i;
+        capture_.clear();
+        mode_ = Mode::CtestOutput;
+    }
+    return true;
+}
+
+// "===== title =====" lines: pytest's session banner and the sections after the results.
+bool TestTracker::pytest_section(std::string_view s)
+{
+    if (!s.ends_with('='))
+        return false;
+    const std::string_view title = trim(s, "= ");
+    if (title == "test session starts") {
+        mode_ = Mode::PytestResults;
+        return true;
+    }
+    if (mode_ < Mode::PytestResults)
+        return false;
+
+    if (title == "FAILURES" || title == "ERRORS") {
+        mode_ = Mode::PytestFailures;
+    } else if (title == "short test summary info") {
+        mode_ = Mode::PytestSummary;
+    } else if (title.starts_with("slowest ") && title.find("durations") != std::string_view::npos) {
+        mode_ = Mode::PytestDurations;
+    } else if (title.find(" in ") != std::string_view::npos &&
+               (title.ends_with('s') || title.ends_with(')'))) { // "2 failed, 10 passed in 0.52s"
+        attach_pytest_failures();
+        mode_ = Mode::None;
+    } else {
+        mode_ = Mode::PytestResults; // warnings summary and the like
+    }
+    return true;
+}
+
+static bool pytest_status(std::string_view word, TestStatus &st)
+{
+    if (word == "PASSED" || word == "XPASS")
+        st = TestStatus::Passed;
+    else if (word == "FAILED" || word == "ERROR" || word == "RERUN") // RERUN: pytest-rerunfailures
+        st = TestStatus::Failed;
+    else if (word == "SKIPPED" || word == "XFAIL")
+        st = TestStatus::Skipped;
+    else
+        return false;
+    return true;
+}
+
+// -v: "tests/a.py::test_x PASSED  [ 50%]"; xdist: "[gw0] [ 50%] PASSED tests/a.py::test_x";
+// the short summary: "FAILED tests/a.py::test_x - assert 1 == 2".
+void TestTracker::pytest_result(std::string_view s)
+{
+    bool xdist = false;
+    if (s.starts_with("[gw")) {
+        for (int k = 0; k < 2; ++k) {
+            const size_t close = s.find("] ");
+            if (close == std::string_view::npos)
+                return;
+            s = trim(s.substr(close + 2), " ");
+        }
+        xdist = true;
+    }
+
+    const size_t sp = s.find(' ');
+    if (sp == std::string_view::npos)
+        return;
+    const std::string_view first = s.substr(0, sp);
+    std::string_view second = trim(s.substr(sp + 1), " ");
+    second = second.substr(0, second.find(' '));
+
+    TestStatus st;
+    if (first.find("::") != std::string_view::npos && pytest_status(second, st)) {
+        record(first, "pytest", st, -1);
+    } else if ((xdist || mode_ == Mode::PytestSummary) && pytest_status(first, st) &&
+               second.find("::") != std::string_view::npos) {
+        // the summary repeats what -v already showed
+        if (xdist || !known(second))
+            record(second, "pytest", st, -1);
+    }
+}
+
+// "0.51s call     tests/a.py::test_x": setup, call and teardown add up.
+void TestTracker::pytest_duration(std::string_view s)
+{
+    const size_t sp = s.find(' ');
+    if (sp == std::string_view::npos || sp == 0 || s[sp - 1] != 's')
+        return;
+    const int64_t ms = parse_duration(s.substr(0, sp - 1), 1000);
+    const std::string_view rest = trim(s.substr(sp + 1), " ");
+    const size_t id = rest.find(' ');
+    if (ms < 0 || id == std::string_view::npos)
+        return;
+    const auto it = index_.find(std::string(trim(rest.substr(id + 1), " ")));
+    if (it == index_.end())
+        return;
+    TestResult &t = tests_[it->second];
+    t.duration_ms = std::max<int64_t>(t.duration_ms, 0) + ms;
+}
+
+// A section is headed by the short name: "test_x", "TestK.test_x", "test_p[1-2]".
+void TestTracker::attach_pytest_failures()
+{
+    for (auto &f : pytest_failures_) {
+        trim_trailing_lines(f.text);
+        TestResult *owner = nullptr;
+        for (TestResult &t : tests_) {
+            if (t.framework != std::string_view("pytest") || t.failures == 0 || !t.failure.empty())
+                continue;
+            const size_t sep = t.name.find("::");
+            std::string short_name = t.name.substr(sep + 2);
+            for (size_t p; (p = short_name.find("::")) != std::string::npos;)
+                short_name.replace(p, 2, ".");
+            if (short_name == f.name || t.name == f.name) {
+                owner = &t;
+                break;
+            }
+        }
+        if (!owner)
+            owner = &tests_[record(f.name, "pytest", TestStatus::Failed, -1)];
+        owner->failure = std::move(f.text);
+    }
+    pytest_failures_.clear();
+}
+
+void TestTracker::finish()
+{
+    end_capture();
+    if (gtest_running_) { // crashed before its result
+        const size_t i = record(gtest_name_, "gtest", TestStatus::Failed, -1);
+        trim_trailing_lines(gtest_output_);
+        tests_[i].failure = std::move(gtest_output_);
+        gtest_running_ = false;
+    }
+    attach_pytest_failures();
+    mode_ = Mode::None;
+}
+
+std::vector<const TestResult *> TestTracker::slowest(size_t n) const
+{
+    std::vector<const TestResult *> out;
+    for (const TestResult &t : tests_)
+        if (t.duration_ms > 0)
+            out.push_back(&t);
+    n = std::min(n, out.size());
+    std::partial_sort(out.begin(), out.begin() + (std::ptrdiff_t)n, out.end(),
+                      [](const TestResult *a, const TestResult *b) { return a->duration_ms > b->duration_ms; });
+    out.resize(n);
+    return out;
+}
+
+} // namespace vanitas
@@ -0,0 +1,238 @@
+#include "vanitas/timestamp.hpp"
+
+#include <algorithm>
+#include <ctime>
+
+namespace vanitas {
+
+std::optional<TimestampFormat::Kind> parse_timestamp_kind(const std::string &name)
+{
+    if (name == "iso8601" || name == "iso")
+        return TimestampFormat::Kind::Iso8601;
+    if (name == "syslog")
+        return TimestampFormat::Kind::Syslog;
+    if (name == "epoch_ms" || name == "epoch_millis")
+        return TimestampFormat::Kind::EpochMillis;
+    if (name == "epoch" || name == "epoch_s")
+        return TimestampFormat::Kind::EpochSeconds;
+    if (name == "none")
+        return TimestampFormat::Kind::None;
+    return std::nullopt;
+}
+
+// Days since 1970-01-01 of a proleptic Gregorian date (H. Hinnant's days_from_civil).
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = (unsigned)(y - era * 400);
+    const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t)doe - 719468;
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+// n digits at s[i..] into v
+static bool digits(std::string_view s, size_t i, size_t n, unsigned &v)
+{
+    if (i + n > s.size())
+        return false;
+    v = 0;
+    for (size_t k = 0; k < n; ++k) {
+        if (!is_digit(s[i + k]))
+            return false;
+        v = v * 10 + (unsigned)(s[i + k] - '0');
+    }
+    return true;
+}
+
+static int64_t to_ms(int64_t days, unsigned h, unsigned mi, unsigned sec, unsigned ms)
+{
+    return ((days * 24 + h) * 60 + mi) * 60000 + (int64_t)sec * 1000 + ms;
+}
+
+// [.,]fraction at s[i]: milliseconds of up to the first three digits
+static size_t fraction(std::string_view s, size_t i, unsigned &ms)
+{
+    ms = 0;
+    if (i >= s.size() || (s[i] != '.' && s[i] != ',') || i + 1 >= s.size() || !is_digit(s[i + 1]))
+        return i;
+    ++i;
+    unsigned scale = 100;
+    while (i < s.size() && is_digit(s[i])) {
+        ms += (unsigned)(s[i] - '0') * scale;
+        scale /= 10;
+        ++i;
+    }
+    return i;
+}
+
+// YYYY-MM-DD[T ]hh:mm[:ss[.fff]][Z|+hh[:mm]|-hh[:mm]] at s[i]; date_only allows a bare date.
+static bool iso_at(std::string_view s, size_t i, bool date_only, int64_t &out, size_t &end)
+{
+    unsigned y, mo, d, h = 0, mi = 0, sec = 0, ms = 0;
+    if (!digits(s, i, 4, y) || i + 4 >= s.size() || s[i + 4] != '-' || !digits(s, i + 5, 2, mo) || i + 7 >= s.size() ||
+        s[i + 7] != '-' || !digits(s, i + 8, 2, d))
+        return false;
+    if (mo < 1 || mo > 12 || d < 1 || d > 31)
+        return false;
+    i += 10;
+
+    const bool has_time = i < s.size() && (s[i] == 'T' || s[i] == ' ') && digits(s, i + 1, 2, h) &&
+                          i + 3 < s.size() && s[i + 3] == ':' && digits(s, i + 4, 2, mi);
+    if (!has_time) {
+        if (!date_only)
+            return false;
+        out = to_ms(days_from_civil(y, mo, d), 0, 0, 0, 0);
+        end = i;
+        return true;
+    }
+    i += 6;
+    if (i < s.size() && s[i] == ':' && digits(s, i + 1, 2, sec)) {
+        i += 3;
+        i = fraction(s, i, ms);
+    }
+    if (h > 23 || mi > 59 || sec > 60)
+        return false;
+
+    int64_t offset_min = 0;
+    if (i < s.size() && s[i] == 'Z') {
+        ++i;
+    } else if (i < s.size() && (s[i] == '+' || s[i] == '-')) {
+        unsigned oh, om = 0;
+        const int sign = s[i] == '-' ? -1 : 1;
+        if (digits(s, i + 1, 2, oh)) {
+            size_t j = i + 3;
+            if (j < s.size() && s[j] == ':')
+                ++j;
+            if (digits(s, j, 2, om))
+                j += 2;
+            offset_min = sign * (int64_t)(oh * 60 + om);
+            i = j;
+        }
+    }
+
+    out = to_ms(days_from_civil(y, mo, d), h, mi, sec, ms) - offset_min * 60000;
+    end = i;
+    return true;
+}
+
+static int current_year()
+{
+    const std::time_t now = std::time(nullptr);
+    std::tm tm{};
+    gmtime_r(&now, &tm);
+    return tm.tm_year + 1900;
+}
+
+// Mmm dd hh:mm:ss, day space or zero padded
+static bool syslog_at(std::string_view s, size_t i, int64_t &out)
+{
+    static constexpr const char *months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                             "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+    if (i + 15 > s.size() || s[i + 3] != ' ')
+        return false;
+    unsigned mo = 0;
+    while (mo < 12 && s.compare(i, 3, months[mo]) != 0)
+        ++mo;
+    if (mo == 12)
+        return false;
+
+    unsigned d, h, mi, sec;
+    const char d0 = s[i + 4];
+    if (d0 == ' ') {
+        if (!digits(s, i + 5, 1, d))
+            return false;
+    } else if (!digits(s, i + 4, 2, d)) {
+        return false;
+    }
+    if (s[i + 6] != ' ' || !digits(s, i + 7, 2, h) || s[i + 9] != ':' || !digits(s, i + 10, 2, mi) ||
+        s[i + 12] != ':' || !digits(s, i + 13, 2, sec))
+        return false;
+
+    static const int year = current_year();
+    out = to_ms(days_from_civil(year, mo + 1, d), h, mi, sec, 0);
+    return true;
+}
+
+// a run of exactly n digits starting at s[i], as a number
+static bool epoch_at(std::string_view s, size_t i, size_t n, int64_t &out, size_t &end)
+{
+    size_t j = i;
+    int64_t v = 0;
+    while (j < s.size() && is_digit(s[j]) && j - i <= n) {
+        v = v * 10 + (s[j] - '0');
+        ++j;
+    }
+    if (j - i != n)
+        return false;
+    out = v;
+    end = j;
+    return true;
+}
+
+std::optional<int64_t> find_timestamp(const TimestampFormat &f, std::string_view line)
+{
+    const size_t limit = std::min(line.size(), f.search);
+    int64_t t = 0;
+    size_t end = 0;
+
+    for (size_t i = 0; i < limit; ++i) {
+        const char c = line[i];
+        const bool token_start = i == 0 || !is_digit(line[i - 1]);
+
+        switch (f.kind) {
+        case TimestampFormat::Kind::Iso8601:
+            if (is_digit(c) && token_start && iso_at(line, i, false, t, end))
+                return t;
+            break;
+        case TimestampFormat::Kind::Syslog:
+            if (c >= 'A' && c <= 'S' && syslog_at(line, i, t))
+                return t;
+            break;
+        case TimestampFormat::Kind::EpochMillis:
+            if (is_digit(c) && token_start && epoch_at(line, i, 13, t, end))
+                return t;
+            break;
+        case TimestampFormat::Kind::EpochSeconds:
+            if (is_digit(c) && token_start && epoch_at(line, i, 10, t, end)) {
+                unsigned ms = 0;
+                fraction(line, end, ms);
+                return t * 1000 + ms;
+            }
+            break;
+        default:
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<int64_t> parse_iso8601(std::string_view s)
+{
+    int64_t t = 0;
+    size_t end = 0;
+    if (!iso_at(s, 0, true, t, end) || end != s.size())
+        return std::nullopt;
+    return t;
+}
+
+std::string format_iso8601(int64_t ms)
+{
+    const std::time_t secs = (std::time_t)(ms >= 0 ? ms / 1000 : (ms - 999) / 1000);
+    std::tm tm{};
+    gmtime_r(&secs, &tm);
+    char buf[32];
+    const size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+    std::string out(buf, n);
+    const int frac = (int)(ms - (int64_t)secs * 1000);
+    out += '.';
+    out += (char)('0' + frac / 100);
+    out += (char)('0' + frac / 10 % 10);
+    out += (char)('0' + frac % 10);
+    out += 'Z';
+    return out;
+}
+
+} // namespace vanitas
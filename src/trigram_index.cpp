@@ -0,0 +1,313 @@
+#include "vanitas/trigram_index.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace vanitas {
+
+static constexpr char vgi_magic[8] = {'V', 'A', 'N', 'G', 'I', '0', '1', '\n'};
+static constexpr size_t vgi_header = 8 + 10 * sizeof(uint64_t);
+static constexpr size_t vgi_line_at = 8 + 4 * sizeof(uint64_t);
+static constexpr size_t table_entry = 16;
+static constexpr uint64_t group_bytes = 4096;
+
+// decoding a list this many times longer than the candidates left costs more than checking them
+static constexpr size_t narrow_ratio = 32;
+
+static unsigned char lower(unsigned char c) { return c >= 'A' && c <= 'Z' ? (unsigned char)(c | 0x20) : c; }
+
+std::vector<uint32_t> trigrams(std::string_view text)
+{
+    std::vector<uint32_t> out;
+    for (size_t i = 0; i + 3 <= text.size(); ++i)
+        out.push_back((uint32_t)lower((unsigned char)text[i]) << 16 | (uint32_t)lower((unsigned char)text[i + 1]) << 8 |
+                      lower((unsigned char)text[i + 2]));
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+static void fnv(uint64_t &h, std::string_view s)
+{
+    for (const unsigned char c : s) {
+        h ^= c;
+        h *= 1099511628211ull;
+    }
+    h ^= 0xFF; // ends the string: {"ab","c"} and {"a","bc"} differ
+    h *= 1099511628211ull;
+}
+
+uint64_t profile_hash(const Profile &p)
+{
+    uint64_t h = 14695981039346656037ull; // FNV-1a
+    for (const auto *rules : {&p.firstline, &p.continuation, &p.err, &p.wrn, &p.tests, &p.correlate.lead,
+                              &p.correlate.follow}) {
+        for (const auto &r : *rules)
+            fnv(h, r.pattern);
+        fnv(h, "|");
+    }
+    fnv(h, std::to_string(p.correlate.max_lead) + "," + std::to_string(p.correlate.max_follow));
+    fnv(h, std::to_string((int)p.structured.format));
+    for (const auto *names : {&p.structured.level, &p.structured.message, &p.structured.error, &p.structured.warn}) {
+        for (const auto &n : *names)
+            fnv(h, n);
+        fnv(h, "|");
+    }
+    return h;
+}
+
+TrigramSegment::TrigramSegment() : list_of_(size_t(1) << 16) {}
+
+// Blocks come in order, so a group is already on a list when it is its last entry.
+void TrigramSegment::add(uint64_t offset, uint32_t line, Type t, std::string_view text)
+{
+    if (groups_.empty() || offset - group_offset_ >= group_bytes) {
+        groups_.push_back((uint32_t)blocks_.size());
+        group_offset_ = offset;
+    }
+    const uint32_t g = (uint32_t)groups_.size() - 1;
+    blocks_.push_back(offset << 2 | (uint64_t)t);
+    lines_.push_back(line);
+
+    if (text.size() < 3)
+        return;
+    uint32_t key = (uint32_t)lower((unsigned char)text[0]) << 8 | lower((unsigned char)text[1]);
+    for (size_t i = 2; i < text.size(); ++i) {
+        key = (key << 8 | lower((unsigned char)text[i])) & 0xFFFFFF;
+        auto &page = list_of_[key >> 8];
+        if (!page)
+            page = std::make_unique<uint32_t[]>(256);
+        uint32_t &l = page[key & 0xFF];
+        if (l == 0) {
+            keys_.push_back(key);
+            lists_.emplace_back();
+            l = (uint32_t)lists_.size();
+        }
+        auto &list = lists_[l - 1];
+        if (list.empty() || list.back() != g)
+            list.push_back(g);
+    }
+}
+
+static void put_u64(std::string &out, uint64_t v) { out.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+
+static void put_u32(std::string &out, uint32_t v) { out.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+
+static void put_varint(std::string &out, uint32_t v)
+{
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+static size_t padded(size_t n) { return (n + 7) / 8 * 8; }
+
+void TrigramSegment::write(std::string &out, uint64_t profile, uint64_t identity, uint64_t begin, uint64_t end,
+                           uint64_t line, uint64_t lines) const
+{
+    std::vector<uint32_t> order(keys_.size());
+    for (size_t i = 0; i < order.size(); ++i)
+        order[i] = (uint32_t)i;
+    std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return keys_[a] < keys_[b]; });
+
+    std::string postings;
+    std::vector<uint64_t> at(order.size());
+    for (size_t k = 0; k < order.size(); ++k) {
+        at[k] = postings.size();
+        uint32_t prev = 0;
+        for (const uint32_t g : lists_[order[k]]) {
+            put_varint(postings, g - prev);
+            prev = g;
+        }
+    }
+    postings.resize(padded(postings.size()), '\0');
+
+    out.append(vgi_magic, sizeof(vgi_magic));
+    for (const uint64_t v : {profile, identity, begin, end, line, lines, (uint64_t)blocks_.size(),
+                             (uint64_t)groups_.size(), (uint64_t)order.size(), (uint64_t)postings.size()})
+        put_u64(out, v);
+    out.append(reinterpret_cast<const char *>(blocks_.data()), blocks_.size() * sizeof(uint64_t));
+    out.append(reinterpret_cast<const char *>(lines_.data()), lines_.size() * sizeof(uint32_t));
+    out.resize(out.size() + padded(lines_.size() * 4) - lines_.size() * 4, '\0');
+    out.append(reinterpret_cast<const char *>(groups_.data()), groups_.size() * sizeof(uint32_t));
+    out.resize(out.size() + padded(groups_.size() * 4) - groups_.size() * 4, '\0');
+    for (size_t k = 0; k < order.size(); ++k) {
+        put_u32(out, keys_[order[k]]);
+        put_u32(out, (uint32_t)lists_[order[k]].size());
+        put_u64(out, at[k]);
+    }
+    out.append(postings);
+}
+
+void TrigramSegment::set_line(std::string &segment, uint64_t line)
+{
+    std::memcpy(segment.data() + vgi_line_at, &line, sizeof(line));
+}
+
+TrigramIndex::TrigramIndex(const std::filesystem::path &path)
+{
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    map_size_ = (size_t)st.st_size;
+    map_ = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map_ == MAP_FAILED) {
+        map_ = nullptr;
+        return;
+    }
+    madvise(map_, map_size_, MADV_RANDOM);
+
+    const char *base = static_cast<const char *>(map_);
+    size_t pos = 0;
+    while (map_size_ - pos >= vgi_header && std::memcmp(base + pos, vgi_magic, sizeof(vgi_magic)) == 0) {
+        uint64_t h[10];
+        std::memcpy(h, base + pos + sizeof(vgi_magic), sizeof(h));
+        const uint64_t n_blocks = h[6], n_groups = h[7], n_keys = h[8], postings = h[9];
+        const uint64_t left = map_size_ - pos - vgi_header;
+        if (n_blocks > left / 12 || n_groups > n_blocks || n_keys > left / table_entry || postings > left ||
+            n_blocks * 8 + padded(n_blocks * 4) + padded(n_groups * 4) + n_keys * table_entry + postings > left ||
+            h[2] != end())
+            break;
+
+        const char *p = base + pos + vgi_header;
+        const char *groups = p + n_blocks * 8 + padded(n_blocks * 4);
+        const char *table = groups + padded(n_groups * 4);
+        Segment s{h[0], h[1], h[2], h[3], h[4], h[5], reinterpret_cast<const uint64_t *>(p),
+                  reinterpret_cast<const uint32_t *>(p + n_blocks * 8), (size_t)n_blocks,
+                  reinterpret_cast<const uint32_t *>(groups), (size_t)n_groups, table, (size_t)n_keys,
+                  reinterpret_cast<const unsigned char *>(table + n_keys * table_entry)};
+        segments_.push_back(s);
+        pos = (size_t)(reinterpret_cast<const char *>(s.postings) - base) + postings;
+    }
+    valid_ = pos;
+}
+
+TrigramIndex::~TrigramIndex()
+{
+    if (map_)
+        munmap(map_, map_size_);
+}
+
+bool TrigramIndex::matches(uint64_t profile, uint64_t identity) const
+{
+    return std::all_of(segments_.begin(), segments_.end(),
+                       [&](const Segment &s) { return s.profile == profile && s.identity == identity; });
+}
+
+IndexedBlock TrigramIndex::block(const Segment &s, size_t i)
+{
+    const uint64_t e = s.blocks[i];
+    return {e >> 2, i + 1 < s.n_blocks ? s.blocks[i + 1] >> 2 : s.end, s.line ? s.line + s.block_lines[i] : 0,
+            (Type)(e & 3)};
+}
+
+std::vector<IndexedBlock> TrigramIndex::all() const
+{
+    std::vector<IndexedBlock> out;
+    for (const auto &s : segments_)
+        for (size_t i = 0; i < s.n_blocks; ++i)
+            out.push_back(block(s, i));
+    return out;
+}
+
+static std::vector<uint32_t> decode(const unsigned char *p, uint32_t n)
+{
+    std::vector<uint32_t> out(n);
+    uint32_t prev = 0;
+    for (uint32_t k = 0; k < n; ++k) {
+        uint32_t v = 0;
+        for (unsigned shift = 0;; shift += 7) {
+            const unsigned char c = *p++;
+            v |= (uint32_t)(c & 0x7F) << shift;
+            if (!(c & 0x80))
+                break;
+        }
+        prev += v;
+        out[k] = prev;
+    }
+    return out;
+}
+
+std::vector<IndexedBlock> TrigramIndex::candidates(const std::vector<uint32_t> &keys) const
+{
+    struct List
+    {
+            uint32_t count;
+            uint64_t at;
+    };
+
+    std::vector<IndexedBlock> out;
+    for (const auto &s : segments_) {
+        std::vector<List> lists;
+        for (const uint32_t key : keys) {
+            size_t lo = 0, hi = s.n_keys;
+            while (lo < hi) {
+                const size_t mid = (lo + hi) / 2;
+                uint32_t k;
+                std::memcpy(&k, s.table + mid * table_entry, 4);
+                if (k < key)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            uint32_t k = 0;
+            if (lo < s.n_keys)
+                std::memcpy(&k, s.table + lo * table_entry, 4);
+            if (lo == s.n_keys || k != key) {
+                lists.clear();
+                break;
+            }
+            List l;
+            std::memcpy(&l.count, s.table + lo * table_entry + 4, 4);
+            std::memcpy(&l.at, s.table + lo * table_entry + 8, 8);
+            lists.push_back(l);
+        }
+        if (lists.empty())
+            continue;
+
+        std::sort(lists.begin(), lists.end(), [](const List &a, const List &b) { return a.count < b.count; });
+        std::vector<uint32_t> have = decode(s.postings + lists[0].at, lists[0].count);
+        for (size_t k = 1; k < lists.size() && !have.empty(); ++k) {
+            if (lists[k].count > have.size() * narrow_ratio)
+                break;
+            const std::vector<uint32_t> next = decode(s.postings + lists[k].at, lists[k].count);
+            std::vector<uint32_t> both;
+            std::set_intersection(have.begin(), have.end(), next.begin(), next.end(), std::back_inserter(both));
+            have.swap(both);
+        }
+        for (const uint32_t g : have) {
+            if (g >= s.n_groups)
+                break;
+            const size_t last = std::min<size_t>(g + 1 < s.n_groups ? s.groups[g + 1] : s.n_blocks, s.n_blocks);
+            for (size_t b = s.groups[g]; b < last; ++b)
+                out.push_back(block(s, b));
+        }
+    }
+    return out;
+}
+
+std::filesystem::path TrigramIndex::file_for(const std::filesystem::path &base_dir, const std::string &log,
+                                             const std::string &profile)
+{
+    uint64_t h = 14695981039346656037ull;
+    fnv(h, log);
+    fnv(h, profile);
+    char name[21];
+    std::snprintf(name, sizeof(name), "%016llx.vgi", (unsigned long long)h);
+    return base_dir / "cache" / "grep" / name;
+}
+
+} // namespace vanitas
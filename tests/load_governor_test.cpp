@@ -0,0 +1,78 @@
+// Walks LoadGovernor up through every Shed level and back down, on a fake
+// clock, so each step lands at a known time.
+
+#include "vanitas/load_governor.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+
+using namespace vanitas;
+using namespace std::chrono_literals;
+
+static int failures = 0;
+
+static void expect(bool ok, const char *what, int step)
+{
+    if (!ok) {
+        std::fprintf(stderr, "FAIL: %s (step %d)\n", what, step);
+        ++failures;
+    }
+}
+
+int main()
+{
+    LoadGovernor::Clock::time_point now{};
+    LoadGovernor gov(ShedThresholds::doubling(1), [&] { return now; });
+
+    // One chunk at a time, with a megabyte always waiting: lag grows by the
+    // time taken, so each settle period brings the next level.
+    const Shed up[] = {Shed::Tests, Shed::Info, Shed::Sample, Shed::FastPath};
+    int step = 0;
+    for (Shed want : up) {
+        while (gov.level() != want) {
+            expect(gov.level() == (Shed)((int)want - 1), "one level at a time", step);
+            if (++step > 1000)
+                return EXIT_FAILURE;
+            gov.begin();
+            now += 100ms;
+            gov.end(4096, 1 << 20);
+        }
+        expect(gov.lag() >= ShedThresholds::doubling(1).lag[(size_t)want - 1], "lag at threshold", step);
+    }
+
+    // Stays at the top however far behind.
+    for (int i = 0; i < 20; ++i) {
+        gov.begin();
+        now += 100ms;
+        gov.end(4096, 1 << 20);
+    }
+    expect(gov.level() == Shed::FastPath, "stays at FastPath", step);
+
+    // Caught up: back down one level per settle period, not faster.
+    const Shed down[] = {Shed::Sample, Shed::Info, Shed::Tests, Shed::None};
+    for (Shed want : down) {
+        now += LoadGovernor::settle;
+        gov.begin();
+        now += 10ms;
+        gov.end(4096, 0);
+        ++step;
+        expect(gov.lag() == 0, "no lag once caught up", step);
+        expect(gov.level() == want, "level down", step);
+        gov.begin();
+        now += 10ms;
+        gov.end(4096, 0);
+        expect(gov.level() == want, "holds for settle", step);
+    }
+
+    // Idle time between bursts is not lag.
+    now += 60s;
+    gov.begin();
+    now += 10ms;
+    gov.end(4096, 64 * 1024);
+    expect(gov.lag() < 1, "idle is not lag", step);
+    expect(gov.level() == Shed::None, "idle sheds nothing", step);
+
+    if (failures == 0)
+        std::puts("load_governor: ok");
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}